@@ -0,0 +1,124 @@
+#include "AdaptiveWait.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	using clock = std::chrono::steady_clock;
+
+	double microsBetween(clock::time_point from, clock::time_point to) {
+		return std::chrono::duration<double, std::micro>(to - from).count();
+	}
+
+	clock::duration micros(double us) {
+		return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::micro>(us));
+	}
+
+	uint32_t wholeMicros(clock::duration d) {
+		return static_cast<uint32_t>(std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count(), 0));
+	}
+}; // namespace
+
+namespace Procon {
+
+	int AdaptiveWait::read(HidTransport &device, uchar *data, size_t size, bool periodic, clock::duration limit) {
+		++counters.reads;
+		const clock::time_point start = clock::now();
+		const clock::time_point giveUp = start + limit;
+		int read = device.readTimeout(data, size, 0);
+		if (read != 0) {
+			++counters.queued; // Not a sample, it didn't have to be waited for
+			return read;
+		}
+
+		// Polled replies are due a round trip from now. Streamed reports are
+		// due a period after the last one, counting periods that went by
+		// unread.
+		clock::time_point base = start;
+		if (periodic && lastArrival == clock::time_point{}) {
+			// Nothing to time the first one from
+			while ((read = device.readTimeout(data, size, 0)) == 0 && clock::now() < giveUp) {
+			}
+			if (read > 0) lastArrival = clock::now();
+			return read;
+		}
+		if (periodic) {
+			base = lastArrival;
+			const double behindUs = microsBetween(base, start) - windowUs();
+			if (samples > 0 && intervalUs > 0 && behindUs > intervalUs) {
+				base += micros(std::floor(behindUs / intervalUs) * intervalUs);
+			}
+		}
+
+		if (samples < warmup) {
+			while ((read = device.readTimeout(data, size, 0)) == 0 && clock::now() < giveUp) {
+			}
+			if (read > 0) learn(base, clock::now());
+			return read;
+		}
+
+		// A wait shorter than the transport's timeouts can be is spun through
+		const clock::duration granularity = std::chrono::microseconds(device.timeoutGranularityUs());
+		const clock::time_point due = base + micros(intervalUs);
+		const clock::time_point spinFrom = due - micros(windowUs());
+		const clock::time_point spinUntil = std::min(due + micros(windowUs()), giveUp);
+		if (spinFrom - start >= granularity) {
+			read = device.readTimeout(data, size, wholeMicros(spinFrom - start));
+			const clock::time_point woke = clock::now();
+			if (read != 0) {
+				++counters.early;
+				if (read > 0) learn(base, woke);
+				return read;
+			}
+			wakeLateUs += (std::max(microsBetween(spinFrom, woke), 0.0) - wakeLateUs) / 8;
+		}
+		while ((read = device.readTimeout(data, size, 0)) == 0 && clock::now() < spinUntil) {
+		}
+		if (read != 0) {
+			++counters.inWindow;
+			if (read > 0) learn(base, clock::now());
+			return read;
+		}
+
+		++counters.late;
+		const clock::time_point now = clock::now();
+		if (now >= giveUp) return 0;
+		if (giveUp - now >= granularity) {
+			read = device.readTimeout(data, size, wholeMicros(giveUp - now));
+		}
+		while (read == 0 && clock::now() < giveUp) {
+			read = device.readTimeout(data, size, 0);
+		}
+		if (read > 0) learn(base, clock::now());
+		return read;
+	}
+
+	// About three mean deviations covers nearly every arrival, plus the
+	// time a blocking read takes to wake up, so spinning starts in time
+	double AdaptiveWait::windowUs() const {
+		return std::max(3 * jitterUs, static_cast<double>(minWindowUs)) + wakeLateUs;
+	}
+
+	// Averages over about 8 packets
+	void AdaptiveWait::learn(clock::time_point base, clock::time_point arrival) {
+		const double interval = microsBetween(base, arrival);
+		lastArrival = arrival;
+		if (samples++ == 0) {
+			intervalUs = interval;
+			return;
+		}
+		const double error = interval - intervalUs;
+		intervalUs += error / 8;
+		jitterUs += (std::abs(error) - jitterUs) / 8;
+	}
+
+	AdaptiveWait::Stats AdaptiveWait::stats() const {
+		Stats s = counters;
+		s.intervalUs = intervalUs;
+		s.jitterUs = jitterUs;
+		s.wakeLateUs = wakeLateUs;
+		s.windowUs = windowUs();
+		return s;
+	}
+
+};
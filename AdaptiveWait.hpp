@@ -0,0 +1,61 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "Common.hpp"
+#include "HidTransport.hpp"
+
+namespace Procon {
+
+	// Waits for a controller's next packet by blocking until shortly before
+	// it's due, then spinning until it comes. Learns when packets are due
+	// from when they came: every report period when streaming, a round trip
+	// after the request when polling. The spin window is tuned from the
+	// arrival jitter and from how late blocking reads wake up, so a steady
+	// controller costs a few microseconds of spinning per packet instead of
+	// a core. A packet that comes outside the window is still read at once,
+	// only with a blocking read's wake-up delay. Blocking reads go through
+	// readTimeout(), so a wait shorter than the transport's timeout
+	// granularity (a millisecond with hidapi) is spun through instead: at a
+	// 1000 Hz report rate or a round trip under about a millisecond it
+	// spins like sReadWait = spin.
+	// One thread at a time, like the transport.
+	class AdaptiveWait {
+	public:
+		using clock = std::chrono::steady_clock;
+
+		struct Stats {
+			uint64_t reads;
+			uint64_t queued;     // Already waiting when the read started
+			uint64_t early;      // Came while blocked, before the window
+			uint64_t inWindow;   // Came while spinning
+			uint64_t late;       // Came after the window, blocked again
+			double intervalUs;   // Learned time from the anchor to the packet
+			double jitterUs;     // Mean deviation from that
+			double wakeLateUs;   // How late blocking reads return when nothing comes
+			double windowUs;     // Spun through either side of the due time
+		};
+
+		static constexpr size_t warmup{ 8 };          // Packets timed by spinning before blocking at all
+		static constexpr uint32_t minWindowUs{ 20 };  // Spin at least this long either side
+
+		// Reads one packet like readTimeout(limit). 'periodic' is true if
+		// packets come on their own every period (streamed reports), false
+		// if each answers a request made just before the call (polling).
+		int read(HidTransport &device, uchar *data, size_t size, bool periodic, clock::duration limit);
+		Stats stats() const;
+
+	private:
+		size_t samples{ 0 };
+		double intervalUs{ 0 };
+		double jitterUs{ 0 };
+		double wakeLateUs{ 0 };
+		clock::time_point lastArrival{};
+		Stats counters{};
+
+		double windowUs() const;
+		void learn(clock::time_point base, clock::time_point arrival);
+	};
+
+};
@@ -0,0 +1,134 @@
+// Cost of raw HID capture on the polling threads, and a round trip check of
+// the capture file. Each producer thread stands in for a controller and
+// records what one poll exchanges (a getInput command and a 64 byte report),
+// then the file is read back with CaptureReader.
+//
+// Usage: CaptureBench [controllers] [polls_per_sec] [path]
+// polls_per_sec is per controller (default 1000), 0 for as fast as possible.
+// Reports the p50/p99/max cost of recording one poll, records written and
+// dropped, and the read back check: every payload intact, sequence gaps equal
+// to the drops (unless the very last records were dropped), and records in
+// time order per port.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../CaptureReader.hpp"
+#include "../CaptureWriter.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+	constexpr double seconds{ 2.0 };
+	constexpr size_t reportSize{ 64 };
+
+	// Payload derived from port and sequence so the reader can check it
+	void fillReport(uint8_t *out, uchar port, uint32_t seq) {
+		for (size_t i = 0; i < reportSize; ++i) {
+			out[i] = static_cast<uint8_t>(port * 31 + seq * 7 + i);
+		}
+	}
+
+	double percentile(std::vector<double> &v, double p) {
+		if (v.empty()) return 0;
+		const size_t i = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+		std::nth_element(v.begin(), v.begin() + i, v.end());
+		return v[i];
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	const size_t controllers = argc > 1 ? std::stoul(argv[1]) : 4;
+	const double rate = argc > 2 ? std::stod(argv[2]) : 1000;
+	const std::string path = argc > 3 ? argv[3] : "CaptureBench.pxcap";
+
+	try {
+		std::vector<std::vector<double>> costs(controllers);
+		CaptureWriter::Stats stats;
+		{
+			CaptureWriter writer{ path };
+			std::vector<std::thread> threads;
+			for (size_t c = 0; c < controllers; ++c) {
+				CaptureChannel &channel = writer.channel(static_cast<uchar>(c));
+				threads.emplace_back([&, c] {
+					static const std::array<uint8_t, 9> command{ 0x80, 0x92, 0x00, 0x31, 0x00, 0x00, 0x00, 0x00, 0x1f };
+					std::array<uint8_t, reportSize> report;
+					const uchar port = static_cast<uchar>(c);
+					const auto begin = clock::now();
+					const auto end = begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+					uint32_t seq = 0;
+					for (uint64_t poll = 1; clock::now() < end; ++poll) {
+						fillReport(report.data(), port, seq + 1); // The report is the second record of the poll
+						const auto t0 = clock::now();
+						channel.record(CaptureKind::Command, channel.now(), command.data(), command.size());
+						channel.record(CaptureKind::Report, channel.now(), report.data(), report.size());
+						costs[c].push_back(std::chrono::duration<double, std::nano>(clock::now() - t0).count());
+						seq += 2;
+						if (rate > 0) {
+							const auto next = begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(poll / rate));
+							while (clock::now() < next) std::this_thread::yield();
+						}
+					}
+				});
+			}
+			for (std::thread &t : threads) {
+				t.join();
+			}
+			stats = writer.stats(); // Drops are final once the producers are done
+		} // Writer flushes everything on destruction
+
+		std::vector<double> all;
+		for (auto &c : costs) {
+			all.insert(all.end(), c.begin(), c.end());
+		}
+		uint64_t records = 0, bytes = 0, corrupt = 0, gaps = 0, outOfOrder = 0;
+		std::vector<int64_t> lastSeq(controllers, -1);
+		std::vector<uint64_t> lastTime(controllers, 0);
+		std::array<uint8_t, reportSize> expected;
+		CaptureReader reader{ path };
+		for (const CaptureEntry e : reader) {
+			++records;
+			bytes += captureRecordSpan(e.record->size);
+			const uchar port = e.record->port;
+			if (port >= controllers) {
+				++corrupt;
+				continue;
+			}
+			if (e.record->sequence != lastSeq[port] + 1) {
+				gaps += e.record->sequence - (lastSeq[port] + 1);
+			}
+			lastSeq[port] = e.record->sequence;
+			if (e.record->time < lastTime[port]) ++outOfOrder;
+			lastTime[port] = e.record->time;
+			if (e.record->kind == CaptureKind::Report) {
+				fillReport(expected.data(), port, e.record->sequence);
+				if (e.record->size != reportSize || !std::equal(expected.begin(), expected.end(), e.data)) ++corrupt;
+			}
+		}
+		cout << "polls " << all.size() << '\n';
+		cout << "record_poll_p50_ns " << percentile(all, 0.5) << '\n';
+		cout << "record_poll_p99_ns " << percentile(all, 0.99) << '\n';
+		cout << "record_poll_max_ns " << percentile(all, 1.0) << '\n';
+		cout << "records " << records << '\n';
+		cout << "bytes_per_second " << bytes / seconds << '\n';
+		cout << "dropped " << stats.dropped << '\n';
+		cout << "sequence_gaps " << gaps << '\n';
+		cout << "corrupt " << corrupt << '\n';
+		cout << "out_of_order " << outOfOrder << '\n';
+	}
+	catch (const std::exception &e) {
+		cout << "Error: " << e.what() << '\n';
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,359 @@
+// Microbenchmarks of the input decode path: each step a poll takes from
+// the reply being read to the pad state being ready, timed one report at a
+// time over corpora of input reports, plus the config lookups profiles use.
+//
+// Usage: DecodeBench [--baseline results.txt] [--threshold percent] [--capture file.pxcap] [config.txt]
+// Prints "name ns_per_call" per line, so the output can be saved and passed
+// back as --baseline after a change. With a baseline each line also gets the
+// baseline's value and the change in percent, changes past the threshold
+// (default 10) are marked, and the exit code is 1 if anything got slower.
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../CaptureReader.hpp"
+#include "../Combos.hpp"
+#include "../Config.hpp"
+#include "../Controller.hpp"
+#include "../InputDecode.hpp"
+#include "../OutputSink.hpp"
+#include "../Profile.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+	constexpr size_t corpusSize{ 4096 };
+	constexpr size_t repeats{ 7 };
+	constexpr size_t packetSize{ 64 };
+	using Packet = std::array<uchar, packetSize>;
+
+	// Keeps the compiler from dropping work whose result isn't used
+	volatile uint64_t blackhole;
+
+	struct Lcg {
+		uint32_t state{ 12345 };
+		uint32_t next() {
+			state = state * 1664525u + 1013904223u;
+			return state >> 8;
+		}
+		int noise(int amplitude) {
+			return static_cast<int>(next() % (2 * amplitude + 1)) - amplitude;
+		}
+	};
+
+	uchar toAxis(int v) {
+		return static_cast<uchar>(std::clamp(v, 0, 255));
+	}
+
+	void packStick(uchar x, uchar y, uchar *out) {
+		const uint16_t x12 = static_cast<uint16_t>(x << 4 | 0x8);
+		const uint16_t y12 = static_cast<uint16_t>(y << 4 | 0x8);
+		out[0] = static_cast<uchar>(x12 & 0xFF);
+		out[1] = static_cast<uchar>((x12 >> 8) | ((y12 & 0x0F) << 4));
+		out[2] = static_cast<uchar>(y12 >> 4);
+	}
+
+	// A reply to getInput as the driver reads it over USB
+	Packet makePacket(uchar timer, uint32_t buttons, StickPoint left, StickPoint right) {
+		Packet p{};
+		p[0] = 0x81;
+		p[1] = 0x92;
+		p[3] = 0x31;
+		InputPacket &in = *reinterpret_cast<InputPacket*>(p.data());
+		in.reportId = 0x30;
+		in.timer = timer;
+		in.battery = 0x90;
+		in.leftButtons = static_cast<uchar>(buttons);
+		in.rightButtons = static_cast<uchar>(buttons >> 8);
+		in.middleButtons = static_cast<uchar>(buttons >> 16);
+		packStick(left.x, left.y, in.sticks);
+		packStick(right.x, right.y, in.sticks + 3);
+		in.vibrator = 0x0C;
+		for (int sample = 0; sample < 3; ++sample) {
+			in.imu[sample * 12 + 5] = 0x10; // 1 g on z
+		}
+		return p;
+	}
+
+	// Resting sticks with a little noise and no buttons, most of what a
+	// controller sends
+	std::vector<Packet> idleCorpus() {
+		Lcg rng;
+		std::vector<Packet> corpus;
+		for (size_t i = 0; i < corpusSize; ++i) {
+			corpus.push_back(makePacket(static_cast<uchar>(i * 3), 0,
+				{ toAxis(128 + rng.noise(2)), toAxis(128 + rng.noise(2)) },
+				{ toAxis(128 + rng.noise(2)), toAxis(128 + rng.noise(2)) }));
+		}
+		return corpus;
+	}
+
+	// Left stick circling, right stick flicking, buttons held for 20 to
+	// 100 reports at a time
+	std::vector<Packet> playCorpus() {
+		Lcg rng;
+		std::vector<Packet> corpus;
+		uint32_t buttons = 0;
+		size_t hold = 0;
+		for (size_t i = 0; i < corpusSize; ++i) {
+			if (hold-- == 0) {
+				buttons = rng.next() & rng.next() & 0x03FFFF; // A few at a time
+				hold = 20 + rng.next() % 80;
+			}
+			const double angle = i * 0.02;
+			const int flick = (i / 60) % 4 == 0 ? 120 : 0;
+			corpus.push_back(makePacket(static_cast<uchar>(i * 3), buttons,
+				{ toAxis(128 + static_cast<int>(100 * std::cos(angle))), toAxis(128 + static_cast<int>(100 * std::sin(angle))) },
+				{ toAxis(128 + flick + rng.noise(2)), toAxis(128 + rng.noise(2)) }));
+		}
+		return corpus;
+	}
+
+	// Every report different: random buttons and sticks anywhere
+	std::vector<Packet> mashCorpus() {
+		Lcg rng;
+		std::vector<Packet> corpus;
+		for (size_t i = 0; i < corpusSize; ++i) {
+			corpus.push_back(makePacket(static_cast<uchar>(i * 3), rng.next() & 0x03FFFF,
+				{ static_cast<uchar>(rng.next()), static_cast<uchar>(rng.next()) },
+				{ static_cast<uchar>(rng.next()), static_cast<uchar>(rng.next()) }));
+		}
+		return corpus;
+	}
+
+	// The input reports recorded with bCapture
+	std::vector<Packet> captureCorpus(const std::string &path) {
+		std::vector<Packet> corpus;
+		CaptureReader reader{ path };
+		for (const CaptureEntry e : reader) {
+			if (e.record->kind != CaptureKind::Report || e.record->size < sizeof(InputPacket)) continue;
+			Packet p{};
+			std::memcpy(p.data(), e.data, std::min<size_t>(e.record->size, packetSize));
+			corpus.push_back(p);
+		}
+		if (corpus.empty()) throw std::runtime_error("No input reports in " + path);
+		return corpus;
+	}
+
+	const InputPacket& packetAt(const std::vector<Packet> &corpus, size_t i) {
+		return *reinterpret_cast<const InputPacket*>(corpus[i].data());
+	}
+
+	// Median over 'repeats' runs of ns per call, each run calling 'body'
+	// over the corpus for at least 20 ms. body(i) handles report i.
+	template<class F>
+	double timePerCall(size_t count, F body) {
+		size_t passes = 1;
+		for (;;) {
+			const auto start = clock::now();
+			for (size_t p = 0; p < passes; ++p) {
+				for (size_t i = 0; i < count; ++i) body(i);
+			}
+			if (clock::now() - start >= std::chrono::milliseconds(20)) break;
+			passes *= 2;
+		}
+		std::array<double, repeats> runs;
+		for (double &r : runs) {
+			const auto start = clock::now();
+			for (size_t p = 0; p < passes; ++p) {
+				for (size_t i = 0; i < count; ++i) body(i);
+			}
+			r = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (passes * count);
+		}
+		std::nth_element(runs.begin(), runs.begin() + repeats / 2, runs.end());
+		return runs[repeats / 2];
+	}
+
+	// Replies with the corpus in order, and with nothing else for commands
+	// other than getInput, so the driver's whole poll runs without a device
+	class CorpusTransport : public HidTransport {
+		const std::vector<Packet> &corpus;
+		size_t next{ 0 };
+		bool polled{ false };
+	public:
+		explicit CorpusTransport(const std::vector<Packet> &corpus) :corpus(corpus) {}
+		int write(const uchar *data, size_t size) override {
+			polled = size > 8 && data[0] == 0x80 && data[8] == 0x1f;
+			return static_cast<int>(size);
+		}
+		int read(uchar *data, size_t size) override {
+			if (!polled) return 0;
+			const Packet &p = corpus[next];
+			next = next + 1 == corpus.size() ? 0 : next + 1;
+			std::memcpy(data, p.data(), std::min(size, packetSize));
+			return static_cast<int>(std::min(size, packetSize));
+		}
+		uint32_t readTime() const override {
+			return static_cast<uint32_t>(next);
+		}
+	};
+
+	using Results = std::vector<std::pair<std::string, double>>;
+
+	void decodeBenchmarks(const std::string &name, const std::vector<Packet> &corpus, const ProfileSet &profiles, const ComboAutomaton &combos, Results &results) {
+		const Profile &profile = profiles.defaultProfile();
+		const size_t n = corpus.size();
+		uint64_t sum = 0;
+
+		results.emplace_back("pack_buttons_" + name + "_ns", timePerCall(n, [&](size_t i) {
+			const InputPacket &p = packetAt(corpus, i);
+			sum += packButtons(p.leftButtons, p.rightButtons, p.middleButtons);
+		}));
+		results.emplace_back("button_map_lookup_" + name + "_ns", timePerCall(n, [&](size_t i) {
+			const InputPacket &p = packetAt(corpus, i);
+			sum += profile.buttons.lookup(p.leftButtons, p.rightButtons, p.middleButtons).wButtons;
+		}));
+
+		// The sticks as mapInputToState unpacks them
+		std::vector<ExpandedPadState> sticks(n);
+		for (size_t i = 0; i < n; ++i) {
+			const InputPacket &p = packetAt(corpus, i);
+			sticks[i].leftStick = { static_cast<uchar>(((p.sticks[1] & 0x0F) << 4) | ((p.sticks[0] & 0xF0) >> 4)), p.sticks[2] };
+			sticks[i].rightStick = { static_cast<uchar>(((p.sticks[4] & 0x0F) << 4) | ((p.sticks[3] & 0xF0) >> 4)), p.sticks[5] };
+		}
+		CalibrationData cal;
+		SetDefaultCalibration(cal);
+		results.emplace_back("update_calibration_range_" + name + "_ns", timePerCall(n, [&](size_t i) {
+			updateCalibrationRange(sticks[i], cal);
+		}));
+		sum += cal.left.x.min + cal.right.y.max;
+		results.emplace_back("calibrate_to_range_" + name + "_ns", timePerCall(n, [&](size_t i) {
+			short x, y;
+			calibrateToRange(sticks[i].leftStick, cal.left, cal.leftCenter, x, y);
+			sum += static_cast<uint16_t>(x) + static_cast<uint16_t>(y);
+		}));
+
+		TimerWheel wheel{ TimerWheel::clockNow() };
+		StickFilter filter;
+		MacroPlayer macros{ wheel };
+		ExpandedPadState state{};
+		SetDefaultCalibration(cal);
+		results.emplace_back("map_input_to_state_" + name + "_ns", timePerCall(n, [&](size_t i) {
+			zeroPadState(state);
+			mapInputToState(packetAt(corpus, i), profile, cal, filter, macros, state);
+			sum += state.xinState.wButtons + static_cast<uint16_t>(state.xinState.sThumbLX);
+		}));
+
+		// Everything a poll does on the driver's side: building the command,
+		// the exchange and its copies, decode, button events and the sink
+		NullSink sink;
+		TimerWheel pollWheel{ TimerWheel::clockNow() };
+		Controller controller{ 0, pollWheel, profiles, combos, sink };
+		controller.openDevice(std::make_unique<CorpusTransport>(corpus));
+		results.emplace_back("poll_input_" + name + "_ns", timePerCall(n, [&](size_t) {
+			controller.pollInput();
+		}));
+		sum += controller.getState().xinState.wButtons;
+		blackhole = sum;
+	}
+
+	// A poll whose reply is a streamed 0x30 report, which the driver skips
+	// right after the exchange: the command, the exchange and its copies only
+	double exchangeBenchmark(const ProfileSet &profiles, const ComboAutomaton &combos) {
+		std::vector<Packet> streamed(1);
+		streamed[0][0] = 0x30;
+		NullSink sink;
+		TimerWheel wheel{ TimerWheel::clockNow() };
+		Controller controller{ 0, wheel, profiles, combos, sink };
+		controller.openDevice(std::make_unique<CorpusTransport>(streamed));
+		return timePerCall(corpusSize, [&](size_t) {
+			controller.pollInput();
+		});
+	}
+
+	void configBenchmarks(Results &results) {
+		int64_t sum = 0;
+		results.emplace_back("config_get_ns", timePerCall(corpusSize, [&](size_t) {
+			sum += Config::get<int32_t>("iFilterRateHz").value_or(0);
+		}));
+		results.emplace_back("config_get_scoped_ns", timePerCall(corpusSize, [&](size_t) {
+			sum += Config::get<int32_t>("iFilterRateHz", "Racing").value_or(0);
+		}));
+		results.emplace_back("config_get_missing_ns", timePerCall(corpusSize, [&](size_t) {
+			sum += Config::get<int32_t>("iNotASetting").value_or(0);
+		}));
+		blackhole = static_cast<uint64_t>(sum);
+	}
+
+	std::map<std::string, double> readBaseline(const std::string &path) {
+		std::ifstream file{ path };
+		if (!file) throw std::runtime_error("Can't read baseline " + path);
+		std::map<std::string, double> baseline;
+		std::string line;
+		while (std::getline(file, line)) {
+			std::istringstream fields{ line };
+			std::string name;
+			double value;
+			if (fields >> name >> value) baseline[name] = value;
+		}
+		return baseline;
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	std::string baselinePath;
+	std::string capturePath;
+	std::string configPath = "config.txt";
+	double threshold = 10.0;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--baseline" && i + 1 < argc) baselinePath = argv[++i];
+		else if (arg == "--threshold" && i + 1 < argc) threshold = std::stod(argv[++i]);
+		else if (arg == "--capture" && i + 1 < argc) capturePath = argv[++i];
+		else configPath = arg;
+	}
+
+	try {
+		Config::readConfigFile(configPath);
+		const ProfileSet profiles = ProfileSet::fromConfig();
+		const ComboAutomaton combos = ComboAutomaton::fromConfig();
+		const std::map<std::string, double> baseline = baselinePath.empty() ? std::map<std::string, double>{} : readBaseline(baselinePath);
+
+		Results results;
+		decodeBenchmarks("idle", idleCorpus(), profiles, combos, results);
+		decodeBenchmarks("play", playCorpus(), profiles, combos, results);
+		decodeBenchmarks("mash", mashCorpus(), profiles, combos, results);
+		if (!capturePath.empty()) {
+			decodeBenchmarks("capture", captureCorpus(capturePath), profiles, combos, results);
+		}
+		results.emplace_back("exchange_ns", exchangeBenchmark(profiles, combos));
+		configBenchmarks(results);
+
+		bool slower = false;
+		for (const auto &r : results) {
+			cout << r.first << ' ' << r.second;
+			auto it = baseline.find(r.first);
+			if (it != baseline.end() && it->second > 0) {
+				const double change = 100.0 * (r.second - it->second) / it->second;
+				cout << ' ' << it->second << ' ' << (change >= 0 ? "+" : "") << change << '%';
+				if (change > threshold) {
+					cout << " slower";
+					slower = true;
+				}
+				else if (change < -threshold) {
+					cout << " faster";
+				}
+			}
+			cout << '\n';
+		}
+		return slower ? 1 : 0;
+	}
+	catch (const std::exception &e) {
+		cout << "Error: " << e.what() << '\n';
+		return -1;
+	}
+}
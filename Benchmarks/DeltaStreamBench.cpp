@@ -0,0 +1,156 @@
+// Loopback throughput of the delta stream with 1 to N subscribers. A
+// producer publishes synthetic reports for several ports into a DeltaServer
+// while subscriber threads receive them through DeltaClient and check every
+// decoded state against what was published. At the end, every other port
+// is disconnected and each subscriber must be left with the last state of
+// the others and the disconnects, however much was dropped on the way.
+//
+// Usage: DeltaStreamBench [max_subscribers] [states_per_sec]
+// states_per_sec is the producer's total rate over 8 ports (default 8000,
+// 8 controllers at 1000 Hz), 0 for as fast as possible.
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../DeltaClient.hpp"
+#include "../DeltaServer.hpp"
+#include "../LocalSocket.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+	constexpr size_t ports{ 8 };
+	constexpr double seconds{ 1.0 };
+
+	// Slowly moving sticks, noisy IMU, a button every 50 reports
+	PublishedState stateFor(uchar port, uint64_t frame) {
+		PublishedState s{};
+		s.frame = frame;
+		s.time = static_cast<uint32_t>(frame * 1000 + port);
+		s.buttons = (frame / 50) % 2 == 0 ? 0 : 1u << (port % 24);
+		s.xinState.wButtons = static_cast<uint16_t>(s.buttons);
+		s.xinState.sThumbLX = static_cast<int16_t>(20000 * std::sin(frame * 0.01));
+		s.xinState.sThumbLY = static_cast<int16_t>(20000 * std::cos(frame * 0.01));
+		s.leftStick.x = static_cast<uchar>(128 + s.xinState.sThumbLX / 256);
+		s.leftStick.y = static_cast<uchar>(128 + s.xinState.sThumbLY / 256);
+		s.rightStick = { 128, 128 };
+		for (int i = 0; i < 3; ++i) {
+			s.accel[i] = static_cast<int16_t>((frame * 7 + i * 13) % 9 - 4);
+			s.gyro[i] = static_cast<int16_t>((frame * 11 + i * 5) % 7 - 3);
+		}
+		s.accel[2] += 4096;
+		s.timer = static_cast<uchar>(frame * 3);
+		return s;
+	}
+
+	bool sameState(const PublishedState &a, const PublishedState &b) {
+		return a.frame == b.frame && a.time == b.time && a.buttons == b.buttons
+			&& a.xinState.wButtons == b.xinState.wButtons
+			&& a.xinState.sThumbLX == b.xinState.sThumbLX && a.xinState.sThumbLY == b.xinState.sThumbLY
+			&& a.leftStick.x == b.leftStick.x && a.leftStick.y == b.leftStick.y
+			&& a.accel[0] == b.accel[0] && a.accel[2] == b.accel[2] && a.gyro[1] == b.gyro[1]
+			&& a.timer == b.timer;
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	const size_t maxSubscribers = argc > 1 ? std::stoul(argv[1]) : 64;
+	const double rate = argc > 2 ? std::stod(argv[2]) : 8000;
+	const std::string path = defaultLocalSocketPath("proconxinput-bench.sock");
+
+	try {
+		for (size_t subscribers = 1; subscribers <= maxSubscribers; subscribers *= 2) {
+			DeltaServer server{ path };
+			std::atomic<bool> done{ false };
+			std::atomic<uint64_t> received{ 0 };
+			std::atomic<uint64_t> mismatches{ 0 };
+			std::atomic<uint64_t> lastFrame{ 0 };
+			std::atomic<uint64_t> wrongEnd{ 0 }; // Subscribers not left with the final states
+			std::vector<std::thread> threads;
+			for (size_t i = 0; i < subscribers; ++i) {
+				threads.emplace_back([&] {
+					DeltaClient client{ path };
+					uint64_t count{ 0 };
+					uint64_t bad{ 0 };
+					// Once done, until nothing more comes
+					for (bool more = true; more;) {
+						const bool finishing = done.load(std::memory_order_relaxed);
+						const uint64_t before = count;
+						const bool open = client.receive(10, [&](const DeltaDecoder::Message &m) {
+							++count;
+							const PublishedState &s = client.state(m.port);
+							if (!m.disconnected && !sameState(s, stateFor(m.port, s.frame))) ++bad;
+						});
+						if (!open) break;
+						more = !finishing || count != before;
+					}
+					for (size_t p = 0; p < ports; ++p) {
+						const bool connected = client.isConnected(static_cast<uchar>(p));
+						if (p % 2 == 0 ? connected : !connected || client.state(static_cast<uchar>(p)).frame != lastFrame) {
+							++wrongEnd;
+							break;
+						}
+					}
+					received += count;
+					mismatches += bad;
+				});
+			}
+			while (server.stats().subscribers < subscribers) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+
+			const auto begin = clock::now();
+			const auto end = begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+			uint64_t frame{ 0 };
+			double publishNs{ 0 };
+			for (auto now = begin; now < end; now = clock::now()) {
+				++frame;
+				const auto t0 = clock::now();
+				for (size_t p = 0; p < ports; ++p) {
+					server.publish(static_cast<uchar>(p), stateFor(static_cast<uchar>(p), frame));
+				}
+				publishNs += std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+				if (rate > 0) {
+					const auto next = begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(frame * ports / rate));
+					while (clock::now() < next) std::this_thread::yield();
+				}
+			}
+			lastFrame = frame;
+			for (size_t p = 0; p < ports; p += 2) {
+				server.setConnected(static_cast<uchar>(p), false);
+			}
+			// Let the server and subscribers catch up before stopping
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			done = true;
+			for (std::thread &t : threads) {
+				t.join();
+			}
+			const DeltaServer::Stats st = server.stats();
+			const double elapsed = std::chrono::duration<double>(end - begin).count();
+			const std::string prefix = "subscribers_" + std::to_string(subscribers) + '_';
+			cout << prefix << "published_per_sec " << st.published / elapsed << '\n';
+			cout << prefix << "delivered_per_sec " << received / elapsed << '\n';
+			cout << prefix << "delivered_fraction " << static_cast<double>(received) / (static_cast<double>(st.published) * subscribers) << '\n';
+			cout << prefix << "bytes_per_message " << (st.messagesSent == 0 ? 0.0 : static_cast<double>(st.bytesSent) / st.messagesSent) << '\n';
+			cout << prefix << "publish_ns " << publishNs / (frame * ports) << '\n';
+			cout << prefix << "input_dropped " << st.inputDropped << '\n';
+			cout << prefix << "queue_dropped " << st.queueDropped << '\n';
+			cout << prefix << "mismatches " << mismatches << '\n';
+			cout << prefix << "wrong_final_state " << wrongEnd << '\n';
+		}
+	}
+	catch (const std::exception &e) {
+		cout << "Error: " << e.what() << '\n';
+		return -1;
+	}
+	return 0;
+}
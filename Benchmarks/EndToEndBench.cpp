@@ -0,0 +1,253 @@
+// Input-to-output latency of each way the driver can read reports: polled
+// with getInput (optionally phase locked) or streamed, with reads that
+// block, spin or adapt. Simulated
+// controllers are read through the transport by the driver's PollWorkers,
+// and the sink times every state from the moment the report it came from
+// became readable to the moment the sink got it, so the latency covers
+// waking up for the report, decoding it and the output call.
+//
+// Usage: EndToEndBench [rate_hz] [latency_us] [seconds] [controllers] [load_threads] [tunings]
+// rate_hz is the controllers' sample rate and streamed report rate (default
+// 1000), latency_us the round trip of a getInput (default 1000, one USB
+// frame), controllers how many to read at once (default 1), on one polling
+// thread each. Read timeouts are whole milliseconds, like hidapi's.
+// load_threads busy threads stand in for a game's (default 0). tunings is
+// a comma separated list of polling thread settings to run every mode with
+// (default "default"): a priority (normal, above, high, realtime),
+// optionally prefixed "pinned_" to pin polling thread n to core n, or
+// "pinned" or "default" alone; modes run with anything but "default" are
+// reported with the tuning after the mode's name. Reports, per mode, p50/p99/p99.9/max latency, reports per
+// second per controller, getInput requests per second per controller, the
+// age of the input when it reached the sink (from when the controller
+// sampled it) and CPU use. Adaptive modes also report, for the first
+// controller, where reads caught their packet (spinning in the window,
+// early while blocked, or late) and the window they learned; phase locked
+// ones how many replies repeated a sample and the period they learned.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../Combos.hpp"
+#include "../Controller.hpp"
+#include "../OutputSink.hpp"
+#include "../PollLoop.hpp"
+#include "../PollWorkers.hpp"
+#include "../Profile.hpp"
+#include "../SimulatedProcon.hpp"
+#include "../ThreadTuning.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+	struct Mode {
+		const char *name;
+		ReadSettings reading;
+	};
+
+	const Mode modes[] = {
+		{ "poll_block", { ReportMode::Poll, ReadWait::Block } },
+		{ "poll_spin", { ReportMode::Poll, ReadWait::Spin } },
+		{ "poll_adaptive", { ReportMode::Poll, ReadWait::Adaptive } },
+		{ "poll_block_phaselock", { ReportMode::Poll, ReadWait::Block, true } },
+		{ "poll_adaptive_phaselock", { ReportMode::Poll, ReadWait::Adaptive, true } },
+		{ "stream_block", { ReportMode::Stream, ReadWait::Block } },
+		{ "stream_spin", { ReportMode::Stream, ReadWait::Spin } },
+		{ "stream_adaptive", { ReportMode::Stream, ReadWait::Adaptive } },
+	};
+
+	// Times each state from its report becoming readable. submit() runs on
+	// the thread that read the report, right after the read, so the
+	// controller's last arrival is that report's. Reports streamed before
+	// 'from', queued up during the handshake, aren't counted.
+	class ArrivalSink : public OutputSink {
+		std::vector<SimulatedProcon*> &sims;
+	public:
+		std::vector<std::vector<double>> latencies; // Microseconds, by port
+		std::vector<std::vector<double>> ages;      // Since the input was sampled
+		clock::time_point from{ clock::time_point::max() };
+
+		ArrivalSink(std::vector<SimulatedProcon*> &sims, size_t controllers) :sims(sims), latencies(controllers), ages(controllers) {
+			for (size_t i = 0; i < controllers; ++i) {
+				latencies[i].reserve(1 << 16);
+				ages[i].reserve(1 << 16);
+			}
+		}
+		void plugIn(uchar) override {}
+		void unplug(uchar) override {}
+		void submit(const PadUpdate *updates, size_t count) override {
+			const clock::time_point now = clock::now();
+			for (size_t i = 0; i < count; ++i) {
+				const uchar port = updates[i].port;
+				if (sims[port]->lastArrival() < from) continue;
+				latencies[port].push_back(std::chrono::duration<double, std::micro>(now - sims[port]->lastArrival()).count());
+				ages[port].push_back(std::chrono::duration<double, std::micro>(now - sims[port]->lastSampleTime()).count());
+			}
+		}
+	};
+
+	ThreadTuning parseTuning(const std::string &name, size_t threads) {
+		ThreadTuning t;
+		std::string priority = name;
+		if (name.rfind("pinned", 0) == 0) {
+			const unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+			for (size_t i = 0; i < threads; ++i) {
+				t.cores.push_back(static_cast<uint32_t>(i % cores));
+			}
+			priority = name.size() > 7 ? name.substr(7) : "normal";
+		}
+		t.priority = parseThreadPriority(priority == "default" ? "normal" : priority);
+		return t;
+	}
+
+	// Keeps a core busy like a game's render or worker thread
+	class LoadThreads {
+		std::atomic<bool> stopping{ false };
+		std::vector<std::thread> threads;
+	public:
+		explicit LoadThreads(size_t count) {
+			for (size_t i = 0; i < count; ++i) {
+				threads.emplace_back([this] {
+					volatile uint64_t x = 0;
+					while (!stopping.load(std::memory_order_relaxed)) {
+						for (int j = 0; j < 1000; ++j) x = x + j;
+					}
+				});
+			}
+		}
+		~LoadThreads() {
+			stopping = true;
+			for (auto &t : threads) t.join();
+		}
+	};
+
+	double percentile(std::vector<double> &v, double p) {
+		if (v.empty()) return 0;
+		const size_t i = std::min(static_cast<size_t>(p * v.size()), v.size() - 1);
+		std::nth_element(v.begin(), v.begin() + i, v.end());
+		return v[i];
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	const uint32_t rate = argc > 1 ? std::stoul(argv[1]) : 1000;
+	const uint32_t latencyUs = argc > 2 ? std::stoul(argv[2]) : 1000;
+	const double seconds = argc > 3 ? std::stod(argv[3]) : 2.0;
+	const size_t controllers = argc > 4 ? std::max<size_t>(std::stoul(argv[4]), 1) : 1;
+	const size_t loadThreads = argc > 5 ? std::stoul(argv[5]) : 0;
+	// Every mode with each tuning
+	std::vector<std::pair<std::string, const Mode*>> runs;
+	std::stringstream tunings{ argc > 6 ? argv[6] : "default" };
+	for (std::string t; std::getline(tunings, t, ',');) {
+		for (const Mode &mode : modes) {
+			runs.emplace_back(t, &mode);
+		}
+	}
+
+	try {
+		const ProfileSet profiles = ProfileSet::fromConfig();
+		const ComboAutomaton combos = ComboAutomaton::fromConfig();
+		for (const auto &[tuningName, run] : runs) {
+			const Mode &mode = *run;
+			const ThreadTuning tuning = parseTuning(tuningName, controllers);
+			const std::string prefix = std::string{ mode.name } + (tuningName == "default" ? "" : '_' + tuningName) + '_';
+			std::vector<SimulatedProcon*> sims;
+			std::vector<std::unique_ptr<PollSlot>> slots;
+			ArrivalSink sink{ sims, controllers };
+			for (size_t i = 0; i < controllers; ++i) {
+				SimulatedProconSettings settings;
+				settings.reportPeriodUs = 1000000 / std::max<uint32_t>(rate, 1);
+				settings.latencyUs = latencyUs;
+				settings.timeoutGranularityUs = 1000; // Like hidapi, what the driver runs on
+				settings.seed = static_cast<uint32_t>(i + 1);
+				auto sim = std::make_unique<SimulatedProcon>(settings);
+				sims.push_back(sim.get());
+				slots.push_back(std::make_unique<PollSlot>());
+				slots.back()->controller = std::make_unique<Controller>(static_cast<uchar>(i), slots.back()->wheel, profiles, combos, sink);
+				slots.back()->controller->setReadSettings(mode.reading);
+				slots.back()->controller->openDevice(std::move(sim));
+			}
+
+			PollWorkers workers{ controllers, nullptr, nullptr };
+			for (auto &s : slots) {
+				workers.add(*s);
+			}
+			workers.tune(tuning);
+			LoadThreads load{ loadThreads };
+			std::vector<uint64_t> commands;
+			for (const SimulatedProcon *sim : sims) {
+				commands.push_back(sim->stats().commands);
+			}
+			const std::clock_t cpuStart = std::clock();
+			const auto begin = clock::now();
+			sink.from = begin;
+			workers.start();
+			std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+			workers.stop();
+			try {
+				workers.check();
+			}
+			catch (const ThreadTuningError &e) {
+				cout << prefix << "error " << e.what() << '\n';
+				continue;
+			}
+			const double elapsed = std::chrono::duration<double>(clock::now() - begin).count();
+			const double cpu = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+			std::vector<double> all;
+			for (const auto &l : sink.latencies) {
+				all.insert(all.end(), l.begin(), l.end());
+			}
+			std::vector<double> ages;
+			double ageSum = 0;
+			for (const auto &a : sink.ages) {
+				ages.insert(ages.end(), a.begin(), a.end());
+			}
+			for (double a : ages) {
+				ageSum += a;
+			}
+			uint64_t requests = 0;
+			for (size_t i = 0; i < sims.size(); ++i) {
+				requests += sims[i]->stats().commands - commands[i];
+			}
+			cout << prefix << "latency_p50_us " << percentile(all, 0.5) << '\n';
+			cout << prefix << "latency_p99_us " << percentile(all, 0.99) << '\n';
+			cout << prefix << "latency_p999_us " << percentile(all, 0.999) << '\n';
+			cout << prefix << "latency_max_us " << percentile(all, 1.0) << '\n';
+			cout << prefix << "reports_per_sec " << all.size() / elapsed / controllers << '\n';
+			cout << prefix << "requests_per_sec " << requests / elapsed / controllers << '\n';
+			cout << prefix << "input_age_mean_us " << (ages.empty() ? 0.0 : ageSum / ages.size()) << '\n';
+			cout << prefix << "input_age_p99_us " << percentile(ages, 0.99) << '\n';
+			cout << prefix << "cpu_percent " << 100.0 * cpu / elapsed << '\n';
+			if (mode.reading.wait == ReadWait::Adaptive) {
+				const AdaptiveWait::Stats w = slots.front()->controller->waitStats();
+				const double reads = static_cast<double>(std::max<uint64_t>(w.reads, 1));
+				cout << prefix << "in_window_percent " << 100.0 * w.inWindow / reads << '\n';
+				cout << prefix << "early_percent " << 100.0 * w.early / reads << '\n';
+				cout << prefix << "late_percent " << 100.0 * w.late / reads << '\n';
+				cout << prefix << "window_us " << w.windowUs << '\n';
+			}
+			if (mode.reading.phaseLock) {
+				const PhaseLock::Stats s = slots.front()->controller->phaseStats();
+				cout << prefix << "repeated_percent " << 100.0 * s.repeated / std::max<uint64_t>(s.replies, 1) << '\n';
+				cout << prefix << "period_us " << s.periodUs << '\n';
+			}
+		}
+	}
+	catch (const std::exception &e) {
+		cout << "Error: " << e.what() << '\n';
+		return -1;
+	}
+	return 0;
+}
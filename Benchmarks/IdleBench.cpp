@@ -0,0 +1,181 @@
+// Idle power mode: CPU use and getInput requests while nobody touches the
+// controller, and how long the first press after that takes to come out,
+// with iIdleAfterMs off and on, for each way of reading reports.
+// A simulated controller is read through the driver's PollWorkers as in
+// main. Each mode first sits untouched for the quiet period plus 'seconds'
+// (CPU and requests are measured over the last 'seconds'), then presses
+// and releases A 'wakes' times, each press a random time into an idle
+// poll period after the controller went quiet again, and the sink times
+// each press from setInput to the output.
+//
+// Usage: IdleBench [rate_hz] [latency_us] [idle_after_ms] [idle_poll_ms] [seconds] [wakes]
+// Defaults: 1000 Hz, a 1000 us round trip, idle after 200 ms, polled every
+// 20 ms when idle, 2 seconds, 20 wakes. Reports, per mode, idle CPU use,
+// idle requests per second, wake latency p50/max and how many times the
+// controller went idle and woke.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../ButtonMap.hpp"
+#include "../Combos.hpp"
+#include "../Controller.hpp"
+#include "../OutputSink.hpp"
+#include "../PollLoop.hpp"
+#include "../PollWorkers.hpp"
+#include "../Profile.hpp"
+#include "../SimulatedProcon.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+	int64_t nowNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+	}
+
+	struct Mode {
+		const char *name;
+		ReportMode mode;
+		ReadWait wait;
+	};
+
+	const Mode modes[] = {
+		{ "poll_block", ReportMode::Poll, ReadWait::Block },
+		{ "poll_spin", ReportMode::Poll, ReadWait::Spin },
+		{ "poll_adaptive", ReportMode::Poll, ReadWait::Adaptive },
+		{ "stream_block", ReportMode::Stream, ReadWait::Block },
+		{ "stream_spin", ReportMode::Stream, ReadWait::Spin },
+		{ "stream_adaptive", ReportMode::Stream, ReadWait::Adaptive },
+	};
+
+	// Notes when the buttons change
+	class ChangeSink : public OutputSink {
+		uint16_t last{ 0 };
+	public:
+		std::atomic<int64_t> changedAt{ 0 };
+
+		void plugIn(uchar) override {}
+		void unplug(uchar) override {}
+		void submit(const PadUpdate *updates, size_t count) override {
+			for (size_t i = 0; i < count; ++i) {
+				if (updates[i].state.wButtons == last) continue;
+				last = updates[i].state.wButtons;
+				changedAt.store(nowNs(), std::memory_order_release);
+			}
+		}
+	};
+
+	double percentile(std::vector<double> &v, double p) {
+		if (v.empty()) return 0;
+		const size_t i = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+		std::nth_element(v.begin(), v.begin() + i, v.end());
+		return v[i];
+	}
+
+	// Sets 'in' and waits up to a second for the output to change. Returns
+	// how long it took in microseconds, or -1.
+	double change(SimulatedProcon &sim, ChangeSink &sink, const SimulatedInput &in) {
+		const int64_t before = sink.changedAt.load(std::memory_order_acquire);
+		const int64_t made = nowNs();
+		sim.setInput(in);
+		while (sink.changedAt.load(std::memory_order_acquire) == before) {
+			if (nowNs() - made > 1'000'000'000) return -1;
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+		return (sink.changedAt.load(std::memory_order_acquire) - made) / 1000.0;
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	const uint32_t rate = argc > 1 ? std::stoul(argv[1]) : 1000;
+	const uint32_t latencyUs = argc > 2 ? std::stoul(argv[2]) : 1000;
+	const uint32_t idleAfterMs = argc > 3 ? std::stoul(argv[3]) : 200;
+	const uint32_t idlePollMs = argc > 4 ? std::max<uint32_t>(std::stoul(argv[4]), 1) : 20;
+	const double seconds = argc > 5 ? std::stod(argv[5]) : 2.0;
+	const size_t wakes = argc > 6 ? std::stoul(argv[6]) : 20;
+	const uint32_t pressed = packedButtonBit(Button::A);
+
+	try {
+		const ProfileSet profiles = ProfileSet::fromConfig();
+		const ComboAutomaton combos = ComboAutomaton::fromConfig();
+		for (const Mode &mode : modes) {
+			for (const bool idle : { false, true }) {
+				ChangeSink sink;
+				SimulatedProconSettings settings;
+				settings.reportPeriodUs = 1000000 / std::max<uint32_t>(rate, 1);
+				settings.latencyUs = latencyUs;
+				auto owned = std::make_unique<SimulatedProcon>(settings);
+				SimulatedProcon &sim = *owned;
+				PollSlot slot;
+				slot.controller = std::make_unique<Controller>(0_uc, slot.wheel, profiles, combos, sink);
+				ReadSettings reading;
+				reading.mode = mode.mode;
+				reading.wait = mode.wait;
+				reading.idleAfterMs = idle ? idleAfterMs : 0;
+				reading.idlePollMs = idlePollMs;
+				slot.controller->setReadSettings(reading);
+				slot.controller->openDevice(std::move(owned));
+
+				PollWorkers workers{ 1, nullptr, nullptr };
+				workers.add(slot);
+				workers.start();
+
+				// Untouched: past the quiet period, then measured
+				const auto quiet = std::chrono::milliseconds(idleAfterMs + 100);
+				std::this_thread::sleep_for(quiet);
+				const uint64_t commands = sim.stats().commands;
+				const std::clock_t cpuStart = std::clock();
+				const auto begin = clock::now();
+				std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+				const double elapsed = std::chrono::duration<double>(clock::now() - begin).count();
+				const double cpu = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+				const uint64_t requests = sim.stats().commands - commands;
+
+				// Presses after going quiet again, at a random point of an idle poll
+				std::mt19937 rng{ 1 };
+				std::uniform_int_distribution<int64_t> offset{ 0, idlePollMs * 1000 };
+				std::vector<double> latencies;
+				size_t timedOut = 0;
+				for (size_t i = 0; i < wakes; ++i) {
+					std::this_thread::sleep_for(quiet + std::chrono::microseconds(offset(rng)));
+					const double us = change(sim, sink, { pressed, { 128, 128 }, { 128, 128 } });
+					if (us < 0) {
+						++timedOut;
+					}
+					else {
+						latencies.push_back(us);
+					}
+					change(sim, sink, { 0, { 128, 128 }, { 128, 128 } });
+				}
+				workers.stop();
+				workers.check();
+
+				const IdleMode::Stats s = slot.controller->idleStats();
+				const std::string prefix = std::string{ mode.name } + (idle ? "_idle_" : "_always_");
+				cout << prefix << "idle_cpu_percent " << 100.0 * cpu / elapsed << '\n';
+				cout << prefix << "idle_requests_per_sec " << requests / elapsed << '\n';
+				cout << prefix << "wake_p50_us " << percentile(latencies, 0.5) << '\n';
+				cout << prefix << "wake_max_us " << percentile(latencies, 1.0) << '\n';
+				cout << prefix << "wake_timeouts " << timedOut << '\n';
+				cout << prefix << "sleeps " << s.sleeps << '\n';
+				cout << prefix << "wakes " << s.wakes << '\n';
+			}
+		}
+	}
+	catch (const std::exception &e) {
+		cout << "Error: " << e.what() << '\n';
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,202 @@
+// Load generator for the input loop: 1 to N simulated controllers at a given
+// report rate, polled by the driver's own PollWorkers as in main.
+// A generator thread presses and releases a button on each controller at
+// random times and the output sink measures how long each change took to
+// come out, so the latency covers waiting for the loop to reach the
+// controller, the device round trip and decoding.
+//
+// Usage: LoadBench [max_controllers] [rate_hz] [latency_us] [seconds] [threads] [slow_every]
+// rate_hz is the controllers' input sample rate (default 1000, try 60 and
+// 120), latency_us the simulated device round trip (default 1000, one USB
+// frame). threads is the polling threads, 0 (default) for one per core as in
+// the driver. Every slow_every-th controller answers 4 times slower, to give
+// rebalancing something to do (default 0, none). Reports, per controller
+// count, passes per second, input-to-output latency p50/p99/max over all
+// controllers and the worst controller's p99, CPU use, input samples no
+// report carried, and controllers moved between threads.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../ButtonMap.hpp"
+#include "../Combos.hpp"
+#include "../Controller.hpp"
+#include "../OutputSink.hpp"
+#include "../PollLoop.hpp"
+#include "../PollWorkers.hpp"
+#include "../Profile.hpp"
+#include "../SimulatedProcon.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+	int64_t nowNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+	}
+
+	// Input changes made by the generator, one outstanding per port
+	struct Change {
+		std::atomic<int64_t> madeAt{ 0 };
+		std::atomic<int64_t> seenAt{ 0 };
+		std::atomic<bool> seen{ true };
+	};
+
+	// Times how long each input change takes to reach the output
+	class LatencySink : public OutputSink {
+		std::vector<Change> &changes;
+		std::vector<uint16_t> last;
+	public:
+		std::vector<std::vector<double>> latencies; // Microseconds, by port
+
+		explicit LatencySink(std::vector<Change> &changes)
+			:changes(changes), last(changes.size(), 0), latencies(changes.size()) {
+		}
+		void plugIn(uchar) override {
+		}
+		void unplug(uchar) override {
+		}
+		void submit(const PadUpdate *updates, size_t count) override {
+			for (size_t i = 0; i < count; ++i) {
+				const uchar port = updates[i].port;
+				if (updates[i].state.wButtons == last[port]) continue;
+				last[port] = updates[i].state.wButtons;
+				Change &c = changes[port];
+				if (c.seen.load(std::memory_order_acquire)) continue;
+				const int64_t now = nowNs();
+				latencies[port].push_back((now - c.madeAt.load(std::memory_order_relaxed)) / 1000.0);
+				c.seenAt.store(now, std::memory_order_relaxed);
+				c.seen.store(true, std::memory_order_release);
+			}
+		}
+	};
+
+	double percentile(std::vector<double> &v, double p) {
+		if (v.empty()) return 0;
+		const size_t i = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+		std::nth_element(v.begin(), v.begin() + i, v.end());
+		return v[i];
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	const size_t maxControllers = argc > 1 ? std::stoul(argv[1]) : 64;
+	const double rate = argc > 2 ? std::stod(argv[2]) : 1000;
+	const uint32_t latencyUs = argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 1000;
+	const double seconds = argc > 4 ? std::stod(argv[4]) : 2.0;
+	const size_t threadArg = argc > 5 ? std::stoul(argv[5]) : 0;
+	const size_t slowEvery = argc > 6 ? std::stoul(argv[6]) : 0;
+	const uint32_t pressed = packedButtonBit(Button::A);
+
+	try {
+		const ProfileSet profiles = ProfileSet::fromConfig();
+		const ComboAutomaton combos = ComboAutomaton::fromConfig();
+		for (size_t n = 1; n <= maxControllers; n *= 2) {
+			std::vector<Change> changes(n);
+			LatencySink latency{ changes };
+			LockedSink sink{ latency };
+			std::vector<SimulatedProcon*> sims;
+			std::vector<std::unique_ptr<PollSlot>> slots;
+			for (size_t i = 0; i < n; ++i) {
+				SimulatedProconSettings settings;
+				settings.reportPeriodUs = static_cast<uint32_t>(1e6 / rate);
+				settings.latencyUs = slowEvery > 0 && i % slowEvery == 0 ? latencyUs * 4 : latencyUs;
+				settings.seed = static_cast<uint32_t>(i + 1);
+				auto sim = std::make_unique<SimulatedProcon>(settings);
+				sims.push_back(sim.get());
+				slots.push_back(std::make_unique<PollSlot>());
+				slots.back()->controller = std::make_unique<Controller>(static_cast<uchar>(i), slots.back()->wheel, profiles, combos, sink);
+				slots.back()->controller->openDevice(std::move(sim));
+			}
+			PollWorkers workers{ threadArg > 0 ? std::min(threadArg, n) : PollWorkers::defaultThreads(n), nullptr, nullptr };
+			for (auto &s : slots) {
+				workers.add(*s);
+			}
+			std::vector<SimulatedProcon::Stats> before;
+			for (SimulatedProcon *s : sims) {
+				before.push_back(s->stats());
+			}
+
+			// Presses or releases A on a port 2 to 10 ms after its last change came out
+			std::atomic<bool> done{ false };
+			std::thread generator([&] {
+				std::mt19937 rng{ 1 };
+				std::uniform_int_distribution<int64_t> gap{ 2'000'000, 10'000'000 };
+				std::vector<int64_t> gaps(n, 0);
+				std::vector<bool> down(n, false);
+				while (!done.load(std::memory_order_relaxed)) {
+					const int64_t now = nowNs();
+					for (size_t i = 0; i < n; ++i) {
+						Change &c = changes[i];
+						if (!c.seen.load(std::memory_order_acquire)) continue;
+						if (gaps[i] == 0) gaps[i] = gap(rng);
+						if (now - c.seenAt.load(std::memory_order_relaxed) < gaps[i]) continue;
+						gaps[i] = 0;
+						down[i] = !down[i];
+						c.madeAt.store(nowNs(), std::memory_order_relaxed);
+						c.seen.store(false, std::memory_order_release);
+						sims[i]->setInput({ down[i] ? pressed : 0, { 128, 128 }, { 128, 128 } });
+					}
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+				}
+			});
+
+			const std::clock_t cpuStart = std::clock();
+			const auto begin = clock::now();
+			const auto end = begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+			workers.start();
+			int ticks{ 0 };
+			while (clock::now() < end) { // Like main
+				workers.check();
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				if (++ticks % 50 == 0) workers.rebalance();
+			}
+			workers.stop();
+			const double elapsed = std::chrono::duration<double>(clock::now() - begin).count();
+			const double cpu = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+			done = true;
+			generator.join();
+			const PollWorkers::Stats ws = workers.stats();
+
+			std::vector<double> all;
+			double worstP99 = 0;
+			for (auto &l : latency.latencies) {
+				all.insert(all.end(), l.begin(), l.end());
+				worstP99 = std::max(worstP99, percentile(l, 0.99));
+			}
+			uint64_t missed = 0;
+			for (size_t i = 0; i < n; ++i) {
+				missed += sims[i]->stats().missed - before[i].missed;
+			}
+			const std::string prefix = "controllers_" + std::to_string(n) + '_';
+			cout << prefix << "threads " << workers.threads() << '\n';
+			cout << prefix << "passes_per_sec " << ws.passes / elapsed << '\n';
+			cout << prefix << "changes " << all.size() << '\n';
+			cout << prefix << "latency_p50_us " << percentile(all, 0.5) << '\n';
+			cout << prefix << "latency_p99_us " << percentile(all, 0.99) << '\n';
+			cout << prefix << "latency_max_us " << percentile(all, 1.0) << '\n';
+			cout << prefix << "worst_controller_p99_us " << worstP99 << '\n';
+			cout << prefix << "cpu_percent " << 100.0 * cpu / elapsed << '\n';
+			cout << prefix << "missed_samples_percent " << 100.0 * missed / (elapsed * rate * n) << '\n';
+			cout << prefix << "moves " << ws.moves << '\n';
+			cout << prefix << "max_thread_load_us " << *std::max_element(ws.loadsNs.begin(), ws.loadsNs.end()) / 1000.0 << '\n';
+			cout << prefix << "min_thread_load_us " << *std::min_element(ws.loadsNs.begin(), ws.loadsNs.end()) / 1000.0 << '\n';
+		}
+	}
+	catch (const std::exception &e) {
+		cout << "Error: " << e.what() << '\n';
+		return -1;
+	}
+	return 0;
+}
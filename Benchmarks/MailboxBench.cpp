@@ -0,0 +1,166 @@
+// Handing the newest pad state from a polling thread to a slower consumer,
+// such as an output or overlay thread, through a PadMailbox against an
+// EventRing queue. A producer publishes states at rate_hz while a consumer
+// wakes at frame_hz and takes one: the mailbox's newest, the queue's oldest
+// (a consumer handling one state per frame), or the queue's newest after
+// draining it. Each state carries its publish time, so the consumer can
+// tell how old what it got is.
+//
+// Usage: MailboxBench [rate_hz] [frame_hz] [seconds]
+// Defaults: 1000 Hz states, 144 Hz frames, 2 seconds. Reports, per way,
+// the age of the state taken p50/p99, frames that got nothing new, states
+// copied per frame, and the consumer's time per frame. Also times publish
+// and take back to back on one thread, without the threads in the way.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../ButtonEvents.hpp"
+#include "../InputDecode.hpp"
+#include "../Mailbox.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+	int64_t nowNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+	}
+
+	// A state and when it was published. The mailbox has its own generation,
+	// the queue needs one in the item.
+	struct Stamped {
+		ExpandedPadState state;
+		int64_t publishedNs;
+		uint64_t generation;
+	};
+
+	enum class Way { Mailbox, QueueOldest, QueueDrain };
+
+	struct Result {
+		std::vector<double> agesUs;
+		uint64_t frames{ 0 };
+		uint64_t repeats{ 0 };   // Frames with nothing newer than the last
+		uint64_t copies{ 0 };    // States copied out
+		int64_t takeNs{ 0 };
+	};
+
+	double percentile(std::vector<double> &v, double p) {
+		if (v.empty()) return 0;
+		const size_t i = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+		std::nth_element(v.begin(), v.begin() + i, v.end());
+		return v[i];
+	}
+
+	ExpandedPadState stateFor(uint64_t n) {
+		ExpandedPadState s{};
+		s.xinState.sThumbLX = static_cast<int16_t>(n * 7);
+		s.xinState.wButtons = static_cast<uint16_t>(n / 50 % 2);
+		return s;
+	}
+
+	Result run(Way way, double rate, double frameRate, double seconds) {
+		TripleBuffer<Stamped> mailbox;
+		EventRing<Stamped, 64> queue;
+		std::atomic<bool> done{ false };
+		Result r;
+		r.agesUs.reserve(static_cast<size_t>(frameRate * seconds) + 16);
+
+		std::thread producer([&] {
+			const auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / rate));
+			auto next = clock::now();
+			for (uint64_t n = 1; !done.load(std::memory_order_relaxed); ++n) {
+				const Stamped s{ stateFor(n), nowNs(), n };
+				if (way == Way::Mailbox) {
+					mailbox.publish(s);
+				}
+				else {
+					queue.push(s);
+				}
+				next += period;
+				std::this_thread::sleep_until(next);
+			}
+		});
+
+		const auto framePeriod = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / frameRate));
+		const auto end = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+		std::vector<Stamped> drained(64);
+		uint64_t last = 0;
+		for (auto next = clock::now() + framePeriod; next < end; next += framePeriod) {
+			std::this_thread::sleep_until(next);
+			const int64_t start = nowNs();
+			const Stamped *taken = nullptr;
+			if (way == Way::Mailbox) {
+				if (mailbox.update()) ++r.copies; // Copied once, by the producer
+				taken = &mailbox.value();
+			}
+			else {
+				const size_t count = queue.drain(drained.data(), way == Way::QueueOldest ? 1 : drained.size());
+				r.copies += count;
+				if (count > 0) taken = &drained[count - 1];
+			}
+			const int64_t took = nowNs() - start;
+			++r.frames;
+			r.takeNs += took;
+			if (taken == nullptr || taken->generation == 0 || taken->generation == last) {
+				++r.repeats;
+				continue;
+			}
+			last = taken->generation;
+			r.agesUs.push_back((start - taken->publishedNs) / 1000.0);
+		}
+		done = true;
+		producer.join();
+		return r;
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	const double rate = argc > 1 ? std::stod(argv[1]) : 1000;
+	const double frameRate = argc > 2 ? std::stod(argv[2]) : 144;
+	const double seconds = argc > 3 ? std::stod(argv[3]) : 2.0;
+
+	const std::pair<const char*, Way> ways[] = {
+		{ "mailbox", Way::Mailbox },
+		{ "queue_oldest", Way::QueueOldest },
+		{ "queue_drain", Way::QueueDrain },
+	};
+	for (const auto &[name, way] : ways) {
+		Result r = run(way, rate, frameRate, seconds);
+		const std::string prefix = std::string{ name } + '_';
+		cout << prefix << "age_p50_us " << percentile(r.agesUs, 0.5) << '\n';
+		cout << prefix << "age_p99_us " << percentile(r.agesUs, 0.99) << '\n';
+		cout << prefix << "repeated_frames_percent " << 100.0 * r.repeats / std::max<uint64_t>(r.frames, 1) << '\n';
+		cout << prefix << "copies_per_frame " << static_cast<double>(r.copies) / std::max<uint64_t>(r.frames, 1) << '\n';
+		cout << prefix << "take_ns " << static_cast<double>(r.takeNs) / std::max<uint64_t>(r.frames, 1) << '\n';
+	}
+
+	// Both sides on one thread, the cost of the operations alone
+	constexpr int rounds{ 1000000 };
+	PadMailbox box;
+	ExpandedPadState s = stateFor(1);
+	uint64_t sum = 0;
+	auto start = clock::now();
+	for (int i = 0; i < rounds; ++i) {
+		s.xinState.sThumbLX = static_cast<int16_t>(i);
+		box.publish(s);
+	}
+	const double publishNs = std::chrono::duration<double, std::nano>(clock::now() - start).count() / rounds;
+	start = clock::now();
+	for (int i = 0; i < rounds; ++i) {
+		box.publish(s);
+		if (box.update()) sum += box.generation();
+	}
+	const double pairNs = std::chrono::duration<double, std::nano>(clock::now() - start).count() / rounds;
+	cout << "mailbox_publish_ns " << publishNs << '\n';
+	cout << "mailbox_publish_take_ns " << pairNs << '\n';
+	if (sum == 0) cout << "unreachable\n";
+	return 0;
+}
@@ -0,0 +1,152 @@
+// Compares sending each controller's state to the sink as soon as its poll
+// finishes with collecting them in a FrameCommit and sending once per pass.
+//
+// Usage: OutputBatchBench [controllers] [poll_us] [activity]
+// controllers - virtual controllers polled per pass (default 4)
+// poll_us     - time each poll takes before its state is ready (default 50)
+// activity    - fraction of polls that change a pad's state (default 0.5)
+//
+// The backend writes each pad to the null device unbuffered, one system call
+// per pad like ScpVBus and uinput. Latency is from a pad's state being ready
+// to its write returning, for states that reach the backend.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../FrameCommit.hpp"
+#include "../OutputSink.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+	const char * const nullDevice{ "NUL" };
+#else
+	const char * const nullDevice{ "/dev/null" };
+#endif
+
+	class WriteSink : public OutputSink {
+		std::FILE *file;
+		std::vector<clock::time_point> done; // Indexed by port
+	public:
+		size_t calls{ 0 };
+
+		explicit WriteSink(size_t ports) :file(std::fopen(nullDevice, "wb")), done(ports) {
+			std::setvbuf(file, nullptr, _IONBF, 0);
+		}
+		~WriteSink() override {
+			std::fclose(file);
+		}
+		void plugIn(uchar) override {}
+		void unplug(uchar) override {}
+		void submit(const PadUpdate *updates, size_t count) override {
+			for (size_t i = 0; i < count; ++i) {
+				std::fwrite(&updates[i].state, sizeof(XINPUT_GAMEPAD), 1, file);
+				++calls;
+				done[updates[i].port] = clock::now();
+			}
+		}
+		clock::time_point doneAt(uchar port) const {
+			return done[port];
+		}
+	};
+
+	struct Lcg {
+		uint32_t state{ 12345 };
+		uint32_t next() {
+			state = state * 1664525u + 1013904223u;
+			return state >> 8;
+		}
+	};
+
+	void spinFor(std::chrono::microseconds d) {
+		const auto until = clock::now() + d;
+		while (clock::now() < until) {}
+	}
+
+	struct Result {
+		double callsPerPass;
+		double p50;
+		double p99;
+		double max;
+	};
+
+	double percentile(std::vector<double> &v, double p) {
+		if (v.empty()) return 0.0;
+		const size_t i = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+		std::nth_element(v.begin(), v.begin() + i, v.end());
+		return v[i];
+	}
+
+	Result run(bool batched, size_t controllers, std::chrono::microseconds poll, double activity, size_t passes) {
+		WriteSink backend{ controllers };
+		FrameCommit frame{ backend };
+		OutputSink &sink = batched ? static_cast<OutputSink&>(frame) : backend;
+		std::vector<XINPUT_GAMEPAD> states(controllers, XINPUT_GAMEPAD{});
+		std::vector<clock::time_point> ready(controllers);
+		std::vector<bool> changed(controllers);
+		std::vector<double> latencies;
+		latencies.reserve(passes * controllers);
+		Lcg rng;
+		const uint32_t threshold = static_cast<uint32_t>(activity * (1u << 24));
+
+		for (size_t pass = 0; pass < passes; ++pass) {
+			for (size_t c = 0; c < controllers; ++c) {
+				spinFor(poll);
+				changed[c] = rng.next() < threshold;
+				if (changed[c]) {
+					states[c].sThumbLX = static_cast<int16_t>(rng.next());
+				}
+				ready[c] = clock::now();
+				const PadUpdate u{ static_cast<uchar>(c), states[c] };
+				sink.submit(&u, 1);
+				if (!batched && changed[c]) {
+					latencies.push_back(std::chrono::duration<double, std::micro>(backend.doneAt(u.port) - ready[c]).count());
+				}
+			}
+			if (batched) {
+				frame.commit();
+				for (size_t c = 0; c < controllers; ++c) {
+					if (changed[c]) {
+						latencies.push_back(std::chrono::duration<double, std::micro>(backend.doneAt(static_cast<uchar>(c)) - ready[c]).count());
+					}
+				}
+			}
+		}
+		Result r;
+		r.callsPerPass = static_cast<double>(backend.calls) / passes;
+		r.p50 = percentile(latencies, 0.5);
+		r.p99 = percentile(latencies, 0.99);
+		r.max = latencies.empty() ? 0.0 : *std::max_element(latencies.begin(), latencies.end());
+		return r;
+	}
+
+	void print(const std::string &prefix, const Result &r) {
+		std::cout << prefix << "_calls_per_pass " << r.callsPerPass << '\n';
+		std::cout << prefix << "_latency_p50_us " << r.p50 << '\n';
+		std::cout << prefix << "_latency_p99_us " << r.p99 << '\n';
+		std::cout << prefix << "_latency_max_us " << r.max << '\n';
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	const size_t controllers = argc > 1 ? std::stoul(argv[1]) : 4;
+	const std::chrono::microseconds poll{ argc > 2 ? std::stol(argv[2]) : 50 };
+	const double activity = argc > 3 ? std::stod(argv[3]) : 0.5;
+	if (controllers == 0 || controllers > 256) {
+		std::cout << "controllers must be 1 to 256\n";
+		return -1;
+	}
+	constexpr size_t passes{ 20000 };
+
+	std::cout << "controllers " << controllers << '\n';
+	print("direct", run(false, controllers, poll, activity, passes));
+	print("batched", run(true, controllers, poll, activity, passes));
+	return 0;
+}
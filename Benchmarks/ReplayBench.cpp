@@ -0,0 +1,173 @@
+// Replays a capture (bCapture) through the real Controller decode pipeline,
+// no device needed. As fast as possible it's a throughput benchmark on real
+// gameplay data, at recorded pace it reproduces a session for debugging.
+//
+// Usage: ReplayBench capture.pxcap [config.txt] [passes] [realtime]
+//        ReplayBench --simulated [seconds]
+// The config supplies the profiles, mappings and combos to decode with.
+// Reports, per pass, reports decoded per second of wall and CPU time and a
+// hash of everything sent to the output, which is the same on every pass
+// and every machine for the same capture and config.
+// --simulated instead captures a SimulatedProcon read polled and then
+// streamed for 'seconds' each (default 1), replays each capture and reports
+// the live and replayed output calls and whether their hashes match.
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "../CaptureReader.hpp"
+#include "../CaptureWriter.hpp"
+#include "../Combos.hpp"
+#include "../Config.hpp"
+#include "../Controller.hpp"
+#include "../OutputSink.hpp"
+#include "../Profile.hpp"
+#include "../Replay.hpp"
+#include "../SimulatedProcon.hpp"
+#include "../TimerWheel.hpp"
+
+namespace {
+	using namespace Procon;
+
+	// FNV-1a over every call, to compare outputs without storing them
+	class HashSink : public OutputSink {
+		uint64_t h{ 0xcbf29ce484222325ull };
+		uint64_t calls{ 0 };
+
+		void mix(const void *data, size_t size) {
+			const uint8_t *bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; ++i) {
+				h = (h ^ bytes[i]) * 0x100000001b3ull;
+			}
+		}
+	public:
+		void plugIn(uchar port) override {
+			mix("P", 1);
+			mix(&port, 1);
+		}
+		void unplug(uchar port) override {
+			mix("U", 1);
+			mix(&port, 1);
+		}
+		void submit(const PadUpdate *updates, size_t count) override {
+			++calls;
+			for (size_t i = 0; i < count; ++i) {
+				mix(&updates[i].port, 1);
+				mix(&updates[i].state.wButtons, sizeof(updates[i].state.wButtons));
+				mix(&updates[i].state.bLeftTrigger, 1);
+				mix(&updates[i].state.bRightTrigger, 1);
+				mix(&updates[i].state.sThumbLX, sizeof(int16_t));
+				mix(&updates[i].state.sThumbLY, sizeof(int16_t));
+				mix(&updates[i].state.sThumbRX, sizeof(int16_t));
+				mix(&updates[i].state.sThumbRY, sizeof(int16_t));
+			}
+		}
+		uint64_t hash() const {
+			return h;
+		}
+		uint64_t submits() const {
+			return calls;
+		}
+	};
+
+	// Polls a SimulatedProcon read 'mode' for 'seconds' while capturing it
+	// to 'path', with the sticks moving so every report decodes differently
+	void captureSimulated(ReportMode mode, double seconds, const std::string &path, const ProfileSet &profiles, const ComboAutomaton &combos, HashSink &sink) {
+		using clock = std::chrono::steady_clock;
+		CaptureWriter writer{ path };
+		SimulatedProconSettings settings;
+		settings.reportPeriodUs = 1000;
+		settings.latencyUs = 500;
+		auto device = std::make_unique<SimulatedProcon>(settings);
+		SimulatedProcon &sim = *device;
+		TimerWheel wheel{ TimerWheel::clockNow() };
+		Controller controller{ 0, wheel, profiles, combos, sink };
+		ReadSettings reading;
+		reading.mode = mode;
+		controller.setReadSettings(reading);
+		controller.captureTo(&writer.channel(0));
+		controller.openDevice(std::move(device));
+		const auto end = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+		for (uint8_t step = 0; clock::now() < end; ++step) {
+			wheel.advance(TimerWheel::clockNow());
+			sim.setInput({ 0, { step, static_cast<uchar>(255 - step) }, { 128, step } });
+			controller.pollInput();
+		}
+	}
+
+	int runSimulated(double seconds, const ProfileSet &profiles, const ComboAutomaton &combos) {
+		using std::cout;
+		for (const auto &[name, mode] : { std::pair{ "poll", ReportMode::Poll }, std::pair{ "stream", ReportMode::Stream } }) {
+			const std::string path = std::string{ "ReplayBench-" } + name + ".pxcap";
+			HashSink live;
+			captureSimulated(mode, seconds, path, profiles, combos, live);
+			const CaptureReader capture{ path };
+			HashSink replayed;
+			Replay replay{ capture, profiles, combos, replayed };
+			const Replay::Stats s = replay.run(false);
+			const std::string prefix = std::string{ name } + '_';
+			cout << prefix << "live_submits " << live.submits() << '\n';
+			cout << prefix << "replayed_submits " << replayed.submits() << '\n';
+			cout << prefix << "command_mismatches " << s.mismatches << '\n';
+			cout << prefix << "output_matches " << (live.hash() == replayed.hash()) << '\n';
+		}
+		return 0;
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	if (argc < 2) {
+		cout << "Usage: ReplayBench capture.pxcap [config.txt] [passes] [realtime]\n";
+		cout << "       ReplayBench --simulated [seconds]\n";
+		return -1;
+	}
+	const bool simulated = std::strcmp(argv[1], "--simulated") == 0;
+	const int passes = argc > 3 ? std::stoi(argv[3]) : 1;
+	const bool realTime = argc > 4 && std::strcmp(argv[4], "realtime") == 0;
+
+	std::optional<ProfileSet> profiles;
+	std::optional<ComboAutomaton> combos;
+	try {
+		if (argc > 2 && !simulated) {
+			Config::readConfigFile(argv[2]);
+		}
+		profiles = ProfileSet::fromConfig();
+		combos = ComboAutomaton::fromConfig();
+	}
+	catch (const ConfigError &e) {
+		cout << "Error reading config file: " << e.what() << '\n';
+		return -1;
+	}
+
+	try {
+		if (simulated) {
+			return runSimulated(argc > 2 ? std::stod(argv[2]) : 1.0, *profiles, *combos);
+		}
+		const CaptureReader capture{ argv[1] };
+		for (int pass = 0; pass < passes; ++pass) {
+			HashSink sink;
+			Replay replay{ capture, *profiles, *combos, sink };
+			const Replay::Stats s = replay.run(realTime);
+			const std::string prefix = "pass_" + std::to_string(pass) + '_';
+			cout << prefix << "controllers " << s.controllers << '\n';
+			cout << prefix << "reports " << s.reports << '\n';
+			cout << prefix << "reports_per_sec " << (s.seconds > 0 ? s.reports / s.seconds : 0.0) << '\n';
+			cout << prefix << "reports_per_cpu_sec " << (s.cpuSeconds > 0 ? s.reports / s.cpuSeconds : 0.0) << '\n';
+			cout << prefix << "ns_per_report " << (s.reports > 0 ? s.seconds * 1e9 / s.reports : 0.0) << '\n';
+			cout << prefix << "command_mismatches " << s.mismatches << '\n';
+			cout << prefix << "skipped_exchanges " << s.skipped << '\n';
+			cout << prefix << "output_hash " << std::hex << sink.hash() << std::dec << '\n';
+		}
+	}
+	catch (const std::exception &e) {
+		cout << "Error: " << e.what() << '\n';
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,102 @@
+// Contention benchmark for the shared memory state publisher. One writer
+// publishes as fast as it can while 0 to N reader threads read the newest
+// state in a loop, through the same region and reader library other
+// processes use.
+//
+// Usage: SharedStateBench [max_readers]
+// Reports, per reader count, the writer's cost per publish, total reads per
+// second, and torn reads (states whose fields don't match), which must be 0.
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../SharedMemory.hpp"
+#include "../StatePublisher.hpp"
+#include "../StateReader.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+	const std::string regionName{ "ProconXInputStateBench" };
+	constexpr uint64_t publishes{ 2'000'000 };
+
+	// Every field is derived from one value so readers can spot torn copies
+	PublishedState stateFor(uint32_t v) {
+		PublishedState s{};
+		s.time = v;
+		s.buttons = ~v;
+		s.xinState.sThumbLX = static_cast<int16_t>(v);
+		s.xinState.sThumbRY = static_cast<int16_t>(~v);
+		s.accel[0] = static_cast<int16_t>(v >> 3);
+		s.gyro[2] = static_cast<int16_t>(v >> 5);
+		return s;
+	}
+
+	bool consistent(const PublishedState &s) {
+		const PublishedState expected = stateFor(s.time);
+		return s.buttons == expected.buttons
+			&& s.xinState.sThumbLX == expected.xinState.sThumbLX
+			&& s.xinState.sThumbRY == expected.xinState.sThumbRY
+			&& s.accel[0] == expected.accel[0]
+			&& s.gyro[2] == expected.gyro[2];
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	const size_t maxReaders = argc > 1 ? std::stoul(argv[1]) : 8;
+
+	try {
+		StatePublisher publisher{ regionName };
+		for (size_t readers = 0; readers <= maxReaders; readers = readers == 0 ? 1 : readers * 2) {
+			const uchar port = static_cast<uchar>(readers % sharedStatePorts);
+			std::atomic<bool> done{ false };
+			std::atomic<uint64_t> reads{ 0 };
+			std::atomic<uint64_t> torn{ 0 };
+			std::vector<std::thread> threads;
+			for (size_t r = 0; r < readers; ++r) {
+				threads.emplace_back([&] {
+					const StateReader reader{ regionName };
+					PublishedState s;
+					uint64_t myReads{ 0 };
+					uint64_t myTorn{ 0 };
+					while (!done.load(std::memory_order_relaxed)) {
+						if (reader.latest(port, s)) {
+							++myReads;
+							if (!consistent(s)) ++myTorn;
+						}
+					}
+					reads += myReads;
+					torn += myTorn;
+				});
+			}
+
+			const auto begin = clock::now();
+			for (uint64_t i = 0; i < publishes; ++i) {
+				publisher.publish(port, stateFor(static_cast<uint32_t>(i)));
+			}
+			const auto end = clock::now();
+			done = true;
+			for (std::thread &t : threads) {
+				t.join();
+			}
+			const double seconds = std::chrono::duration<double>(end - begin).count();
+			const std::string prefix = "readers_" + std::to_string(readers) + '_';
+			cout << prefix << "writer_ns_per_publish " << seconds * 1e9 / publishes << '\n';
+			cout << prefix << "reads_per_sec " << reads / seconds << '\n';
+			cout << prefix << "torn_reads " << torn << '\n';
+			if (readers == maxReaders) break;
+		}
+	}
+	catch (const SharedMemoryError &e) {
+		cout << "Shared memory error: " << e.what() << '\n';
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,183 @@
+// Runs one real Controller against the simulated Pro Controller: the
+// handshake, then polling for a few seconds while the simulated player moves
+// the sticks, checking every decoded report against what was held.
+//
+// Usage: SimulatedProconBench [latency_us] [jitter_us] [loss] [seconds] [sink]
+// Reports the handshake time, pollInput p50/p99/max, what the handshake set
+// up on the controller, replies lost and reads that timed out, and decoded
+// sticks that didn't match the simulated input, which must be 0 apart from
+// polls whose reply was lost. Then the controller's own ReportStats next to
+// the simulator's counts: lost and repeated samples agree apart from streamed
+// reports, which the simulator counts and the driver skips. sink is where
+// the polled states go: null (default) or, on Linux, uinput for a virtual
+// pad through UinputSink.
+// Last, two controllers are polled through a FrameCommit into a
+// RecordingSink and the calls it got are checked: both plugged in first,
+// then batches of one state per controller, then both unplugged.
+// sink_order_errors counts what was out of place and must be 0.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../Combos.hpp"
+#include "../Controller.hpp"
+#include "../FrameCommit.hpp"
+#include "../OutputSink.hpp"
+#include "../Profile.hpp"
+#include "../SimulatedProcon.hpp"
+#include "../TimerWheel.hpp"
+#include "../UinputSink.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+	double percentile(std::vector<double> &v, double p) {
+		if (v.empty()) return 0;
+		const size_t i = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+		std::nth_element(v.begin(), v.begin() + i, v.end());
+		return v[i];
+	}
+
+	std::unique_ptr<OutputSink> makeSink(const std::string &name) {
+#ifdef __linux__
+		if (name == "uinput") return std::make_unique<UinputSink>();
+#endif
+		if (name != "null") throw OutputError("Unknown sink " + name);
+		return std::make_unique<NullSink>();
+	}
+
+	// Counts calls a RecordingSink got out of the order two controllers
+	// polled through a FrameCommit must make them in
+	size_t checkSinkOrder(const ProfileSet &profiles, const ComboAutomaton &combos) {
+		constexpr size_t ports{ 2 };
+		constexpr size_t passes{ 50 };
+		RecordingSink recording;
+		FrameCommit frame{ recording };
+		TimerWheel wheel{ TimerWheel::clockNow() };
+		std::vector<SimulatedProcon*> sims;
+		std::vector<std::unique_ptr<Controller>> controllers;
+		for (size_t i = 0; i < ports; ++i) {
+			SimulatedProconSettings settings;
+			settings.seed = static_cast<uint32_t>(i + 1);
+			auto device = std::make_unique<SimulatedProcon>(settings);
+			sims.push_back(device.get());
+			controllers.push_back(std::make_unique<Controller>(static_cast<uchar>(i), wheel, profiles, combos, frame));
+			controllers.back()->openDevice(std::move(device));
+		}
+		// The sticks swing end to end every pass, far enough to get through the
+		// stick filter, so every commit has a new state for each controller
+		for (size_t pass = 0; pass < passes; ++pass) {
+			for (size_t i = 0; i < ports; ++i) {
+				const uchar x = pass % 2 ? 0 : 255;
+				sims[i]->setInput({ 0, { x, 128 }, { 128, x } });
+				controllers[i]->pollInput();
+			}
+			frame.commit();
+		}
+		controllers.clear();
+
+		const std::vector<RecordingSink::Record> &r = recording.records();
+		size_t errors = 0;
+		size_t at = 0;
+		for (size_t i = 0; i < ports; ++i, ++at) {
+			if (at >= r.size() || r[at].kind != RecordingSink::Kind::PlugIn || r[at].update.port != i) ++errors;
+		}
+		for (size_t batch = 0; batch < passes; ++batch) {
+			for (size_t i = 0; i < ports; ++i, ++at) {
+				if (at >= r.size() || r[at].kind != RecordingSink::Kind::State || r[at].batch != batch || r[at].update.port != i) ++errors;
+			}
+		}
+		for (size_t i = 0; i < ports; ++i, ++at) {
+			if (at >= r.size() || r[at].kind != RecordingSink::Kind::Unplug || r[at].update.port != i) ++errors;
+		}
+		if (recording.batchCount() != passes) ++errors;
+		return errors + (r.size() > at ? r.size() - at : 0);
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	SimulatedProconSettings settings;
+	settings.latencyUs = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 0;
+	settings.jitterUs = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 0;
+	settings.lossRate = argc > 3 ? std::stod(argv[3]) : 0.0;
+	const double seconds = argc > 4 ? std::stod(argv[4]) : 2.0;
+	const std::string sinkName = argc > 5 ? argv[5] : "null";
+
+	try {
+		const ProfileSet profiles = ProfileSet::fromConfig();
+		const ComboAutomaton combos = ComboAutomaton::fromConfig();
+		const std::unique_ptr<OutputSink> output = makeSink(sinkName);
+		OutputSink &sink = *output;
+		TimerWheel wheel{ TimerWheel::clockNow() };
+		auto device = std::make_unique<SimulatedProcon>(settings);
+		SimulatedProcon &sim = *device;
+		Controller controller{ 0, wheel, profiles, combos, sink };
+
+		auto t0 = clock::now();
+		controller.openDevice(std::move(device));
+		const double openMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+
+		std::mt19937 rng{ 7 };
+		std::uniform_int_distribution<int> axis{ 0, 255 };
+		std::vector<double> polls;
+		uint64_t mismatches = 0, stale = 0;
+		const auto end = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+		while (clock::now() < end) {
+			wheel.advance(TimerWheel::clockNow());
+			if (polls.size() % 10 == 0) {
+				const StickPoint left{ static_cast<uchar>(axis(rng)), static_cast<uchar>(axis(rng)) };
+				const StickPoint right{ static_cast<uchar>(axis(rng)), static_cast<uchar>(axis(rng)) };
+				sim.setInput({ 0, left, right });
+			}
+			const uint64_t timeouts = sim.stats().timeouts;
+			t0 = clock::now();
+			controller.pollInput();
+			polls.push_back(std::chrono::duration<double, std::micro>(clock::now() - t0).count());
+			if (sim.stats().timeouts != timeouts) {
+				++stale;
+				continue;
+			}
+			const SimulatedInput in = sim.input();
+			const ExpandedPadState &state = controller.getState();
+			if (state.leftStick.x != in.left.x || state.leftStick.y != in.left.y
+				|| state.rightStick.x != in.right.x || state.rightStick.y != in.right.y) {
+				++mismatches;
+			}
+		}
+		const SimulatedProcon::Stats st = sim.stats();
+		cout << "open_ms " << openMs << '\n';
+		cout << "player_lights " << static_cast<int>(sim.playerLights()) << '\n';
+		cout << "imu_enabled " << sim.imuEnabled() << '\n';
+		cout << "vibration_enabled " << sim.vibrationEnabled() << '\n';
+		cout << "polls " << polls.size() << '\n';
+		cout << "poll_p50_us " << percentile(polls, 0.5) << '\n';
+		cout << "poll_p99_us " << percentile(polls, 0.99) << '\n';
+		cout << "poll_max_us " << percentile(polls, 1.0) << '\n';
+		cout << "reports " << st.reports << '\n';
+		cout << "lost " << st.lost << '\n';
+		cout << "timeouts " << st.timeouts << '\n';
+		cout << "stale_polls " << stale << '\n';
+		cout << "mismatches " << mismatches << '\n';
+		const ReportStats::Summary rs = controller.reportStats();
+		cout << "report_rate_hz " << rs.rateHz << '\n';
+		cout << "report_jitter_us " << rs.jitterUs << '\n';
+		cout << "report_lost_total " << rs.totalLost << '\n';
+		cout << "report_repeated_total " << rs.totalRepeated << '\n';
+		cout << "simulated_missed " << st.missed << '\n';
+		cout << "simulated_repeated " << st.repeated << '\n';
+		cout << "sink_order_errors " << checkSinkOrder(profiles, combos) << '\n';
+	}
+	catch (const std::exception &e) {
+		cout << "Error: " << e.what() << '\n';
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,99 @@
+// Cost and accuracy of the per-stage latency histograms (bLatencyStats).
+// Times LatencyHistogram::record on its own, compares its percentiles with
+// exact ones on a long-tailed sample, then polls a Controller on a
+// SimulatedProcon with no latency, with and without timing, so the
+// difference is the whole overhead per poll.
+//
+// Usage: StageTimingBench [polls]
+// Reports ns per record(), the largest percentile error against sorting,
+// ns per poll without and with timing, and the timed run's report().
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../Combos.hpp"
+#include "../Controller.hpp"
+#include "../LatencyHistogram.hpp"
+#include "../LatencyMonitor.hpp"
+#include "../OutputSink.hpp"
+#include "../Profile.hpp"
+#include "../SimulatedProcon.hpp"
+#include "../TimerWheel.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+	double nsPer(clock::time_point start, uint64_t n) {
+		return std::chrono::duration<double, std::nano>(clock::now() - start).count() / n;
+	}
+
+	// ns per pollInput over 'polls', timed into 'timing' if it's set
+	double pollCost(const ProfileSet &profiles, const ComboAutomaton &combos, size_t polls, StageHistograms *timing) {
+		NullSink sink;
+		TimerWheel wheel{ TimerWheel::clockNow() };
+		Controller controller{ 0, wheel, profiles, combos, sink };
+		controller.timeTo(timing);
+		controller.openDevice(std::make_unique<SimulatedProcon>());
+		const auto start = clock::now();
+		for (size_t i = 0; i < polls; ++i) {
+			controller.pollInput();
+		}
+		return nsPer(start, polls);
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	const size_t polls = argc > 1 ? std::stoul(argv[1]) : 200000;
+
+	// Long tail like real reads: mostly around 1 ms, some up to tens of ms
+	std::mt19937_64 rng{ 3 };
+	std::lognormal_distribution<double> dist{ std::log(1e6), 0.6 };
+	std::vector<uint64_t> values(1 << 20);
+	for (uint64_t &v : values) {
+		v = static_cast<uint64_t>(dist(rng));
+	}
+
+	LatencyHistogram h;
+	const auto start = clock::now();
+	for (uint64_t v : values) {
+		h.record(v);
+	}
+	cout << "record_ns " << nsPer(start, values.size()) << '\n';
+
+	const LatencyHistogram::Snapshot s = h.snapshot();
+	std::sort(values.begin(), values.end());
+	double worst = 0;
+	for (double p : { 0.5, 0.9, 0.99, 0.999, 0.9999 }) {
+		const double exact = static_cast<double>(values[static_cast<size_t>(std::ceil(p * values.size())) - 1]);
+		worst = std::max(worst, std::abs(s.percentile(p) - exact) / exact);
+	}
+	cout << "percentile_max_error_percent " << worst * 100 << '\n';
+	cout << "max_exact " << (s.maxNs == values.back()) << '\n';
+
+	try {
+		const ProfileSet profiles = ProfileSet::fromConfig();
+		const ComboAutomaton combos = ComboAutomaton::fromConfig();
+		LatencyMonitor monitor;
+		pollCost(profiles, combos, polls / 10, nullptr); // Warm up
+		const double untimed = pollCost(profiles, combos, polls, nullptr);
+		const double timed = pollCost(profiles, combos, polls, &monitor.controller(0));
+		cout << "poll_ns_untimed " << untimed << '\n';
+		cout << "poll_ns_timed " << timed << '\n';
+		cout << "overhead_ns " << timed - untimed << '\n';
+		monitor.report(cout);
+	}
+	catch (const std::exception &e) {
+		cout << "Error: " << e.what() << '\n';
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,163 @@
+// Replays a stick trace through StickFilter and reports the jitter removed at
+// rest, the lag added to fast movements and the cost per sample.
+//
+// Usage: StickFilterBench [config.txt] [trace.txt]
+// trace.txt holds one sample per line: "lx ly rx ry" raw values (0-255) at
+// iFilterRateHz. Without a trace a synthetic one is generated: a noisy
+// resting stick with full-range flicks and slow sweeps mixed in.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Config.hpp"
+#include "../StickFilter.hpp"
+
+namespace {
+	using Procon::StickPoint;
+	using Procon::StickFilter;
+	using Procon::StickFilterTable;
+	using Procon::StickFilterParams;
+
+	struct Sample {
+		StickPoint left;
+		StickPoint right;
+	};
+
+	// Deterministic noise so runs are comparable
+	struct Lcg {
+		uint32_t state{ 12345 };
+		int noise(int amplitude) {
+			state = state * 1664525u + 1013904223u;
+			return static_cast<int>((state >> 16) % (2 * amplitude + 1)) - amplitude;
+		}
+	};
+
+	Procon::uchar toAxis(int v) {
+		return static_cast<Procon::uchar>(std::clamp(v, 0, 255));
+	}
+
+	std::vector<Sample> syntheticTrace(std::vector<size_t> &stepStarts) {
+		constexpr int center{ 128 };
+		std::vector<Sample> trace;
+		Lcg rng;
+		auto rest = [&](size_t count, int at) {
+			for (size_t i = 0; i < count; ++i) {
+				const Procon::uchar v = toAxis(at + rng.noise(2));
+				trace.push_back({ { v, toAxis(center + rng.noise(2)) }, { toAxis(center + rng.noise(2)), toAxis(center + rng.noise(2)) } });
+			}
+		};
+		for (int flick = 0; flick < 40; ++flick) {
+			rest(120, center);
+			stepStarts.push_back(trace.size());
+			rest(60, flick % 2 == 0 ? 250 : 5);
+			// Slow sweep back through the whole range
+			for (int v = 0; v < 256; v += 2) {
+				trace.push_back({ { toAxis(v), toAxis(center) }, { toAxis(255 - v), toAxis(center) } });
+			}
+		}
+		return trace;
+	}
+
+	std::vector<Sample> readTrace(const std::string &filename) {
+		std::vector<Sample> trace;
+		std::ifstream file{ filename };
+		int lx, ly, rx, ry;
+		while (file >> lx >> ly >> rx >> ry) {
+			trace.push_back({ { toAxis(lx), toAxis(ly) }, { toAxis(rx), toAxis(ry) } });
+		}
+		return trace;
+	}
+
+	// Samples between a raw step starting and the traced axis covering 90% of it
+	size_t settleTime(const std::vector<Sample> &trace, const std::vector<Sample> &raw, size_t start) {
+		const int from = raw[start - 1].left.x;
+		const int to = raw[start].left.x;
+		for (size_t i = start; i < trace.size(); ++i) {
+			if (std::abs(trace[i].left.x - to) * 10 <= std::abs(to - from)) {
+				return i - start;
+			}
+		}
+		return trace.size() - start;
+	}
+
+	double restJitter(const std::vector<Sample> &trace, const std::vector<size_t> &stepStarts) {
+		// Sample-to-sample movement of left x while it rests before each step
+		double sum{ 0 };
+		size_t count{ 0 };
+		for (size_t start : stepStarts) {
+			for (size_t i = start - 100; i < start; ++i) {
+				const double d = static_cast<double>(trace[i].left.x) - trace[i - 1].left.x;
+				sum += d * d;
+				++count;
+			}
+		}
+		return count == 0 ? 0.0 : std::sqrt(sum / count);
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	using clock = std::chrono::steady_clock;
+
+	if (argc > 1) {
+		try {
+			Procon::Config::readConfigFile(argv[1]);
+		}
+		catch (const Procon::ConfigError &e) {
+			cout << "Error reading config file: " << e.what() << '\n';
+			return -1;
+		}
+	}
+	StickFilterParams params = Procon::stickFilterParamsFromConfig();
+	params.enabled = true;
+
+	std::vector<size_t> stepStarts;
+	const std::vector<Sample> raw = argc > 2 ? readTrace(argv[2]) : syntheticTrace(stepStarts);
+	if (raw.size() < 2) {
+		cout << "Trace is empty.\n";
+		return -1;
+	}
+
+	const StickFilterTable table{ params };
+	StickFilter filter;
+	std::vector<Sample> filtered = raw;
+	for (Sample &s : filtered) {
+		filter.apply(table, s.left, s.right);
+	}
+
+	// Per-sample cost, replaying the trace until enough samples have been timed
+	constexpr size_t minSamples{ 4'000'000 };
+	size_t samples{ 0 };
+	uint32_t sink{ 0 };
+	const auto begin = clock::now();
+	while (samples < minSamples) {
+		filter.reset();
+		for (Sample s : raw) {
+			filter.apply(table, s.left, s.right);
+			sink += s.left.x + s.right.y;
+		}
+		samples += raw.size();
+	}
+	const double ns = std::chrono::duration<double, std::nano>(clock::now() - begin).count();
+
+	const double msPerSample = 1000.0 / params.rateHz;
+	cout << "samples " << raw.size() << '\n';
+	cout << "ns_per_sample " << ns / samples << '\n';
+	if (!stepStarts.empty()) {
+		double addedLag{ 0 };
+		for (size_t start : stepStarts) {
+			addedLag += static_cast<double>(settleTime(filtered, raw, start)) - settleTime(raw, raw, start);
+		}
+		cout << "added_latency_ms " << addedLag / stepStarts.size() * msPerSample << '\n';
+		cout << "rest_jitter_raw " << restJitter(raw, stepStarts) << '\n';
+		cout << "rest_jitter_filtered " << restJitter(filtered, stepStarts) << '\n';
+	}
+	cout << "checksum " << sink << '\n';
+	return 0;
+}
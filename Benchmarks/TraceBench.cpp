@@ -0,0 +1,108 @@
+// Cost of tracing (bTrace) and a sample trace. Times a TraceScope with
+// tracing off and on, then runs simulated controllers on the driver's
+// PollWorkers with tracing on and writes the trace, to open in
+// chrome://tracing or ui.perfetto.dev.
+//
+// Usage: TraceBench [controllers] [threads] [seconds] [trace.json]
+// Reports ns per TraceScope off and on, polls per second with tracing
+// off and on, and the events written.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Combos.hpp"
+#include "../Controller.hpp"
+#include "../OutputSink.hpp"
+#include "../PollLoop.hpp"
+#include "../PollWorkers.hpp"
+#include "../Profile.hpp"
+#include "../SimulatedProcon.hpp"
+#include "../Trace.hpp"
+
+namespace {
+	using namespace Procon;
+	using clock = std::chrono::steady_clock;
+
+	double scopeNs(size_t n) {
+		const auto start = clock::now();
+		for (size_t i = 0; i < n; ++i) {
+			TraceScope trace{ "bench", 0 };
+		}
+		return std::chrono::duration<double, std::nano>(clock::now() - start).count() / n;
+	}
+
+	// Polls per second of 'controllers' SimulatedProcons at 1000 Hz with a
+	// 1 ms round trip, on 'threads' PollWorkers
+	double run(const ProfileSet &profiles, const ComboAutomaton &combos, size_t controllers, size_t threads, double seconds) {
+		NullSink null;
+		LockedSink sink{ null };
+		std::vector<std::unique_ptr<PollSlot>> slots;
+		for (size_t i = 0; i < controllers; ++i) {
+			SimulatedProconSettings settings;
+			settings.reportPeriodUs = 1000;
+			settings.latencyUs = 1000;
+			settings.seed = static_cast<uint32_t>(i + 1);
+			slots.push_back(std::make_unique<PollSlot>());
+			slots.back()->controller = std::make_unique<Controller>(static_cast<uchar>(i), slots.back()->wheel, profiles, combos, sink);
+			slots.back()->controller->openDevice(std::make_unique<SimulatedProcon>(settings));
+		}
+		PollWorkers workers{ std::min(threads, controllers), nullptr, nullptr };
+		for (auto &s : slots) {
+			workers.add(*s);
+		}
+		workers.start();
+		std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+		workers.stop();
+		// Each pass polls the thread's share of the controllers
+		return workers.stats().passes * (static_cast<double>(controllers) / workers.threads()) / seconds;
+	}
+
+}; // namespace
+
+int main(int argc, char *argv[]) {
+	using std::cout;
+	const size_t controllers = argc > 1 ? std::stoul(argv[1]) : 4;
+	const size_t threads = argc > 2 ? std::stoul(argv[2]) : 2;
+	const double seconds = argc > 3 ? std::stod(argv[3]) : 1.0;
+	const std::string path = argc > 4 ? argv[4] : "trace.json";
+
+	try {
+		const ProfileSet profiles = ProfileSet::fromConfig();
+		const ComboAutomaton combos = ComboAutomaton::fromConfig();
+		constexpr size_t scopes = 1 << 22;
+		cout << "scope_ns_off " << scopeNs(scopes) << '\n';
+		const double pollsOff = run(profiles, combos, controllers, threads, seconds);
+
+		Tracer tracer{ 1 << 16 };
+		tracer.activate();
+		tracer.nameThread("main");
+		cout << "scope_ns_on " << scopeNs(scopes) << '\n';
+		Tracer sample{ 1 << 16 }; // A fresh one without the timing loop's events
+		sample.activate();
+		sample.nameThread("main");
+		const double pollsOn = run(profiles, combos, controllers, threads, seconds);
+		sample.deactivate();
+
+		std::ostringstream json;
+		sample.write(json);
+		const std::string text = json.str();
+		std::ofstream{ path, std::ios::trunc } << text;
+		cout << "polls_per_sec_off " << pollsOff << '\n';
+		cout << "polls_per_sec_on " << pollsOn << '\n';
+		cout << "trace_events " << std::count(text.begin(), text.end(), '\n') - 1 << '\n';
+		cout << "trace_bytes " << text.size() << '\n';
+		cout << "trace_file " << path << '\n';
+	}
+	catch (const std::exception &e) {
+		cout << "Error: " << e.what() << '\n';
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "Common.hpp"
+
+namespace Procon {
+
+	// A button press or release
+	struct ButtonEvent {
+		uint32_t time; // Microseconds on the steady clock, see eventTime()
+		Button button;
+		bool down;
+	};
+
+	// Current steady clock time in ButtonEvent::time units. Wraps every ~71
+	// minutes, compare times by subtracting them as uint32_t.
+	inline uint32_t eventTime() {
+		using namespace std::chrono;
+		return static_cast<uint32_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+	}
+
+	// Fixed-size single producer, single consumer ring, lock-free.
+	// When full, new items are dropped and counted rather than overwriting
+	// ones the consumer hasn't seen.
+	template<class T, size_t N>
+	class EventRing {
+		static_assert(N > 0 && (N & (N - 1)) == 0, "EventRing size must be a power of two");
+
+		std::array<T, N> items;
+		alignas(64) std::atomic<size_t> head{ 0 }; // Next write, producer only
+		alignas(64) std::atomic<size_t> tail{ 0 }; // Next read, consumer only
+		std::atomic<size_t> dropped{ 0 };
+	public:
+		// Producer side. Returns false if the ring was full.
+		bool push(const T &item) {
+			const size_t h = head.load(std::memory_order_relaxed);
+			if (h - tail.load(std::memory_order_acquire) == N) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			items[h & (N - 1)] = item;
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer side. Copies up to 'max' items, oldest first, returns the count.
+		size_t drain(T *out, size_t max) {
+			const size_t t = tail.load(std::memory_order_relaxed);
+			const size_t available = head.load(std::memory_order_acquire) - t;
+			const size_t count = available < max ? available : max;
+			for (size_t i = 0; i < count; ++i) {
+				out[i] = items[(t + i) & (N - 1)];
+			}
+			tail.store(t + count, std::memory_order_release);
+			return count;
+		}
+
+		size_t droppedCount() const {
+			return dropped.load(std::memory_order_relaxed);
+		}
+	};
+
+};
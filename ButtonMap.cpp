@@ -0,0 +1,286 @@
+#include "ButtonMap.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+#include "Config.hpp"
+
+namespace {
+	using std::array;
+	using namespace Procon;
+
+	const array<Button, 8> JoyconLBitmap =
+	{
+		Button::DPadDown,
+		Button::DPadUp,
+		Button::DPadRight,
+		Button::DPadLeft,
+		Button::None,
+		Button::None,
+		Button::L,
+		Button::LZ
+	};
+
+	const array<Button, 8> JoyconRBitmap = {
+		Button::Y,
+		Button::X,
+		Button::B,
+		Button::A,
+		Button::None,
+		Button::None,
+		Button::R,
+		Button::RZ
+	};
+
+	const array<Button, 8> JoyconMidBitmap = {
+		Button::Minus,
+		Button::Plus,
+		Button::RStick,
+		Button::LStick,
+		Button::Home,
+		Button::Share,
+		Button::None,
+		Button::None
+	};
+
+	const array<Button, 8>& getButtonMap(ButtonSource s) {
+		switch (s) {
+		case ButtonSource::Left:
+			return JoyconLBitmap;
+		case ButtonSource::Middle:
+			return JoyconMidBitmap;
+		case ButtonSource::Right:
+			return JoyconRBitmap;
+		default:
+			throw std::logic_error("Unknown ButtonSource passed to getButtonMap");
+		}
+	}
+
+	const array<const char*, buttonCount> buttonNames{
+		"None",
+		"DPadUp",
+		"DPadDown",
+		"DPadRight",
+		"DPadLeft",
+		"A",
+		"B",
+		"X",
+		"Y",
+		"Plus",
+		"Minus",
+		"L",
+		"LZ",
+		"R",
+		"RZ",
+		"LStick",
+		"RStick",
+		"Home",
+		"Share"
+	};
+
+	const array<const char*, static_cast<size_t>(MapTarget::RStickRight) + 1> targetNames{
+		"None",
+		"DPadUp",
+		"DPadDown",
+		"DPadLeft",
+		"DPadRight",
+		"Start",
+		"Back",
+		"LThumb",
+		"RThumb",
+		"LB",
+		"RB",
+		"Guide",
+		"A",
+		"B",
+		"X",
+		"Y",
+		"LT",
+		"RT",
+		"LStickUp",
+		"LStickDown",
+		"LStickLeft",
+		"LStickRight",
+		"RStickUp",
+		"RStickDown",
+		"RStickLeft",
+		"RStickRight"
+	};
+
+	const std::string buttonConfigName{ "bMatchButtonLabels" };
+	const std::string mapConfigPrefix{ "sMap" };
+
+}; // namespace
+
+namespace Procon {
+
+	ButtonBit buttonBit(Button b) {
+		for (ButtonSource src : { ButtonSource::Left, ButtonSource::Right, ButtonSource::Middle }) {
+			const array<Button, 8> &map = getButtonMap(src);
+			for (int i = 0; i < 8; ++i) {
+				if (map[i] == b) {
+					return { src, static_cast<uchar>(1 << i) };
+				}
+			}
+		}
+		return { ButtonSource::Left, 0 };
+	}
+
+	uint32_t packedButtonBit(Button b) {
+		const ButtonBit bit = buttonBit(b);
+		return static_cast<uint32_t>(bit.mask) << (8 * static_cast<uint32_t>(bit.source));
+	}
+
+	Button buttonAt(ButtonSource src, int bit) {
+		return getButtonMap(src)[bit];
+	}
+
+	std::optional<Button> buttonFromName(const std::string &name) {
+		for (size_t i = 1; i < buttonNames.size(); ++i) {
+			if (name == buttonNames[i]) return static_cast<Button>(i);
+		}
+		return {};
+	}
+
+	std::optional<MapTarget> mapTargetFromName(const std::string &name) {
+		for (size_t i = 0; i < targetNames.size(); ++i) {
+			if (name == targetNames[i]) return static_cast<MapTarget>(i);
+		}
+		return {};
+	}
+
+	const char* buttonName(Button b) {
+		return buttonNames[static_cast<size_t>(b)];
+	}
+
+	const char* mapTargetName(MapTarget t) {
+		return targetNames[static_cast<size_t>(t)];
+	}
+
+	MappedButtons targetOutput(MapTarget t) {
+		constexpr uchar full = std::numeric_limits<uchar>::max();
+		switch (t) {
+		case MapTarget::DPadUp:
+			return { 0x0001 };
+		case MapTarget::DPadDown:
+			return { 0x0002 };
+		case MapTarget::DPadLeft:
+			return { 0x0004 };
+		case MapTarget::DPadRight:
+			return { 0x0008 };
+		case MapTarget::Start:
+			return { 0x0010 };
+		case MapTarget::Back:
+			return { 0x0020 };
+		case MapTarget::LThumb:
+			return { 0x0040 };
+		case MapTarget::RThumb:
+			return { 0x0080 };
+		case MapTarget::LB:
+			return { 0x0100 };
+		case MapTarget::RB:
+			return { 0x0200 };
+		case MapTarget::Guide:
+			return { 0x0400 }; // Undocumented
+		case MapTarget::A:
+			return { 0x1000 };
+		case MapTarget::B:
+			return { 0x2000 };
+		case MapTarget::X:
+			return { 0x4000 };
+		case MapTarget::Y:
+			return { 0x8000 };
+		case MapTarget::LT:
+			return { 0, full };
+		case MapTarget::RT:
+			return { 0, 0, full };
+		case MapTarget::LStickUp:
+			return { 0, 0, 0, LStickUpBit };
+		case MapTarget::LStickDown:
+			return { 0, 0, 0, LStickDownBit };
+		case MapTarget::LStickLeft:
+			return { 0, 0, 0, LStickLeftBit };
+		case MapTarget::LStickRight:
+			return { 0, 0, 0, LStickRightBit };
+		case MapTarget::RStickUp:
+			return { 0, 0, 0, RStickUpBit };
+		case MapTarget::RStickDown:
+			return { 0, 0, 0, RStickDownBit };
+		case MapTarget::RStickLeft:
+			return { 0, 0, 0, RStickLeftBit };
+		case MapTarget::RStickRight:
+			return { 0, 0, 0, RStickRightBit };
+		default:
+			return { 0 };
+		}
+	}
+
+	ButtonTargets defaultButtonTargets(bool matchLabels) {
+		ButtonTargets t;
+		t.fill(MapTarget::None);
+		auto set = [&t](Button b, MapTarget target) { t[static_cast<size_t>(b)] = target; };
+		set(Button::DPadUp, MapTarget::DPadUp);
+		set(Button::DPadDown, MapTarget::DPadDown);
+		set(Button::DPadLeft, MapTarget::DPadLeft);
+		set(Button::DPadRight, MapTarget::DPadRight);
+		set(Button::Plus, MapTarget::Start);
+		set(Button::Minus, MapTarget::Back);
+		set(Button::LStick, MapTarget::LThumb);
+		set(Button::RStick, MapTarget::RThumb);
+		set(Button::L, MapTarget::LB);
+		set(Button::R, MapTarget::RB);
+		set(Button::LZ, MapTarget::LT);
+		set(Button::RZ, MapTarget::RT);
+		set(Button::Home, MapTarget::Guide);
+		if (matchLabels) {
+			set(Button::A, MapTarget::A);
+			set(Button::B, MapTarget::B);
+			set(Button::X, MapTarget::X);
+			set(Button::Y, MapTarget::Y);
+		}
+		else {
+			// NOTICE: A and B are swapped, and X and Y are swapped.
+			set(Button::A, MapTarget::B);
+			set(Button::B, MapTarget::A);
+			set(Button::X, MapTarget::Y);
+			set(Button::Y, MapTarget::X);
+		}
+		// Share is only used for calibration
+		return t;
+	}
+
+	ButtonTargets buttonTargetsFromConfig(const std::string &profile) {
+		ButtonTargets t = defaultButtonTargets(Config::get<bool>(buttonConfigName, profile).value_or(false));
+		for (size_t i = 1; i < buttonCount; ++i) {
+			const std::string key = mapConfigPrefix + buttonNames[i];
+			std::optional<std::string> name = Config::get<std::string>(key, profile);
+			if (!name) continue;
+			std::optional<MapTarget> target = mapTargetFromName(*name);
+			if (!target) {
+				throw ConfigError(key + " has unknown mapping target " + *name);
+			}
+			t[i] = *target;
+		}
+		return t;
+	}
+
+	ButtonMap::ButtonMap(const ButtonTargets &targets) {
+		for (ButtonSource src : { ButtonSource::Left, ButtonSource::Right, ButtonSource::Middle }) {
+			const array<Button, 8> &map = getButtonMap(src);
+			array<MappedButtons, 256> &table = tables[static_cast<size_t>(src)];
+			for (size_t value = 0; value < table.size(); ++value) {
+				MappedButtons out{ 0 };
+				for (int i = 0; i < 8; ++i) {
+					if ((value & (1 << i)) == 0 || map[i] == Button::None) continue;
+					const MappedButtons add = targetOutput(targets[static_cast<size_t>(map[i])]);
+					out.wButtons |= add.wButtons;
+					out.leftTrigger |= add.leftTrigger;
+					out.rightTrigger |= add.rightTrigger;
+					out.stickDirections |= add.stickDirections;
+				}
+				table[value] = out;
+			}
+		}
+	}
+
+};
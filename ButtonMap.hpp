@@ -0,0 +1,123 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "Common.hpp"
+
+namespace Procon {
+
+	// Everything a Procon button can be mapped to on the XInput side.
+	enum class MapTarget {
+		None,
+		DPadUp,
+		DPadDown,
+		DPadLeft,
+		DPadRight,
+		Start,
+		Back,
+		LThumb,
+		RThumb,
+		LB,
+		RB,
+		Guide,
+		A,
+		B,
+		X,
+		Y,
+		LT,
+		RT,
+		LStickUp,
+		LStickDown,
+		LStickLeft,
+		LStickRight,
+		RStickUp,
+		RStickDown,
+		RStickLeft,
+		RStickRight,
+	};
+
+	// Bits of MappedButtons::stickDirections
+	enum StickDirection : uchar {
+		LStickUpBit = 0x01,
+		LStickDownBit = 0x02,
+		LStickLeftBit = 0x04,
+		LStickRightBit = 0x08,
+		RStickUpBit = 0x10,
+		RStickDownBit = 0x20,
+		RStickLeftBit = 0x40,
+		RStickRightBit = 0x80,
+	};
+
+	// The output contribution of a set of pressed buttons. Contributions of
+	// several sets combine with bitwise or.
+	struct MappedButtons {
+		uint16_t wButtons;
+		uchar leftTrigger;
+		uchar rightTrigger;
+		uchar stickDirections;
+	};
+
+	// Where a button lives in the input report
+	struct ButtonBit {
+		ButtonSource source;
+		uchar mask;
+	};
+
+	// All three button bytes of a report in one mask, byte n is ButtonSource n
+	constexpr uint32_t packButtons(uchar left, uchar right, uchar middle) {
+		return static_cast<uint32_t>(left) | (static_cast<uint32_t>(right) << 8) | (static_cast<uint32_t>(middle) << 16);
+	}
+
+	// Output buttons and triggers as one mask, wButtons in the low 16 bits
+	constexpr uint32_t leftTriggerBit{ 1 << 16 };
+	constexpr uint32_t rightTriggerBit{ 1 << 17 };
+	constexpr size_t outputBitCount{ 18 };
+	constexpr uint32_t outputBits(const MappedButtons &m) {
+		return m.wButtons | (m.leftTrigger != 0 ? leftTriggerBit : 0) | (m.rightTrigger != 0 ? rightTriggerBit : 0);
+	}
+
+	constexpr size_t buttonCount{ static_cast<size_t>(Button::Share) + 1 };
+	using ButtonTargets = std::array<MapTarget, buttonCount>; // Indexed by Button
+
+	ButtonBit buttonBit(Button b);
+	// Bit of b in a packButtons mask
+	uint32_t packedButtonBit(Button b);
+	// Button at bit 'bit' (0-7) of the report byte for 'src', Button::None if unused
+	Button buttonAt(ButtonSource src, int bit);
+
+	// Config names are the enum names, e.g. "LZ" or "LStickUp"
+	std::optional<Button> buttonFromName(const std::string &name);
+	std::optional<MapTarget> mapTargetFromName(const std::string &name);
+	const char* buttonName(Button b);
+	const char* mapTargetName(MapTarget t);
+	MappedButtons targetOutput(MapTarget t);
+
+	// The default layout, following bMatchButtonLabels for ABXY
+	ButtonTargets defaultButtonTargets(bool matchLabels);
+	// Default layout overridden by any sMap<Button> = <MapTarget> config entries
+	// for 'profile' (see Config::get). Throws Procon::ConfigError on unknown names.
+	ButtonTargets buttonTargetsFromConfig(const std::string &profile = "");
+
+	// Button remapping compiled to one 256-entry table per report byte, so
+	// any layout costs three lookups per report.
+	class ButtonMap {
+		std::array<std::array<MappedButtons, 256>, 3> tables; // Indexed by ButtonSource
+	public:
+		explicit ButtonMap(const ButtonTargets &targets);
+
+		MappedButtons lookup(uchar left, uchar right, uchar middle) const {
+			const MappedButtons &l = tables[static_cast<size_t>(ButtonSource::Left)][left];
+			const MappedButtons &r = tables[static_cast<size_t>(ButtonSource::Right)][right];
+			const MappedButtons &m = tables[static_cast<size_t>(ButtonSource::Middle)][middle];
+			return {
+				static_cast<uint16_t>(l.wButtons | r.wButtons | m.wButtons),
+				static_cast<uchar>(l.leftTrigger | r.leftTrigger | m.leftTrigger),
+				static_cast<uchar>(l.rightTrigger | r.rightTrigger | m.rightTrigger),
+				static_cast<uchar>(l.stickDirections | r.stickDirections | m.stickDirections)
+			};
+		}
+	};
+
+};
@@ -0,0 +1,49 @@
+#pragma once
+// Layout of raw HID capture files, see CaptureWriter and CaptureReader.
+// A CaptureFileHeader followed by records back to back, each a CaptureRecord
+// then 'size' bytes padded to captureAlign. Little endian, no compression,
+// so a reader can map the file and walk it in place.
+// Bump captureVersion on any change.
+#include <cstddef>
+#include <cstdint>
+
+#include "Common.hpp"
+
+namespace Procon {
+
+	constexpr uint32_t captureMagic{ 0x50435850 }; // "PXCP"
+	constexpr uint16_t captureVersion{ 1 };
+	constexpr size_t captureAlign{ 8 };
+	constexpr size_t capturePorts{ 64 };
+
+	enum class CaptureKind : uint8_t {
+		Command, // Bytes written to the controller
+		Reply,   // What was read back after any command but getInput
+		Report,  // What was read back after getInput, an input report
+	};
+
+	struct CaptureFileHeader {
+		uint32_t magic;
+		uint16_t version;
+		uint16_t headerSize;  // sizeof(CaptureFileHeader), records start here
+		uint64_t startTime;   // System clock when capture started, ns since 1970
+		uint64_t reserved[2];
+	};
+
+	struct CaptureRecord {
+		uint64_t time;     // Steady clock, ns since startTime
+		uint32_t sequence; // Per port, a gap means records were dropped
+		uint16_t size;     // Payload bytes, not counting padding
+		uchar port;
+		CaptureKind kind;
+	};
+
+	static_assert(sizeof(CaptureFileHeader) == 32, "CaptureFileHeader layout changed");
+	static_assert(sizeof(CaptureRecord) == 16, "CaptureRecord layout changed");
+
+	// Bytes a record with 'size' payload bytes takes in the file
+	constexpr size_t captureRecordSpan(size_t size) {
+		return sizeof(CaptureRecord) + ((size + captureAlign - 1) & ~(captureAlign - 1));
+	}
+
+};
@@ -0,0 +1,62 @@
+#include "CaptureReader.hpp"
+
+#include "CaptureWriter.hpp"
+
+namespace {
+	using Procon::CaptureRecord;
+
+	// Start of the first record that doesn't fit before 'last', or 'last'
+	const uint8_t* complete(const uint8_t *pos, const uint8_t *last) {
+		if (static_cast<size_t>(last - pos) < sizeof(CaptureRecord)) return last;
+		const CaptureRecord *r = reinterpret_cast<const CaptureRecord*>(pos);
+		return static_cast<size_t>(last - pos) < Procon::captureRecordSpan(r->size) ? last : pos;
+	}
+
+	Procon::SharedMemory mapCapture(const std::string &path) {
+		try {
+			return Procon::SharedMemory::mapFile(path);
+		}
+		catch (const Procon::SharedMemoryError &e) {
+			throw Procon::CaptureError(e.what());
+		}
+	}
+}; // namespace
+
+namespace Procon {
+
+	CaptureReader::CaptureReader(const std::string &path) :file(mapCapture(path)) {
+		const uint8_t *base = static_cast<const uint8_t*>(file.data());
+		if (file.size() < sizeof(CaptureFileHeader) || header().magic != captureMagic) {
+			throw CaptureError(path + " is not a capture file");
+		}
+		const CaptureFileHeader &h = header();
+		if (h.version != captureVersion || h.headerSize < sizeof(CaptureFileHeader) || h.headerSize > file.size()) {
+			throw CaptureError(path + " is capture version " + std::to_string(h.version) + ", expected " + std::to_string(captureVersion));
+		}
+		last = base + file.size();
+		first = complete(base + h.headerSize, last);
+	}
+
+	const CaptureFileHeader& CaptureReader::header() const {
+		return *static_cast<const CaptureFileHeader*>(file.data());
+	}
+	CaptureReader::const_iterator CaptureReader::begin() const {
+		return const_iterator(first, last);
+	}
+	CaptureReader::const_iterator CaptureReader::end() const {
+		return const_iterator(last, last);
+	}
+
+	CaptureReader::const_iterator::const_iterator(const uint8_t *pos, const uint8_t *last) :pos(pos), last(last) {
+	}
+	CaptureEntry CaptureReader::const_iterator::operator*() const {
+		const CaptureRecord *r = reinterpret_cast<const CaptureRecord*>(pos);
+		return { r, pos + sizeof(CaptureRecord) };
+	}
+	CaptureReader::const_iterator& CaptureReader::const_iterator::operator++() {
+		const CaptureRecord *r = reinterpret_cast<const CaptureRecord*>(pos);
+		pos = complete(pos + captureRecordSpan(r->size), last);
+		return *this;
+	}
+
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+
+#include "CaptureFormat.hpp"
+#include "Common.hpp"
+#include "SharedMemory.hpp"
+
+namespace Procon {
+
+	struct CaptureEntry {
+		const CaptureRecord *record;
+		const uint8_t *data; // record->size bytes
+	};
+
+	// Reads a capture file written by CaptureWriter, mapped rather than
+	// loaded, so hours of capture cost no more than the pages touched.
+	// Iterates in file order and stops at a record cut short, like the tail
+	// of a capture whose driver was killed.
+	// Throws Procon::CaptureError from the constructor if the file can't be
+	// mapped or isn't a capture of this version.
+	class CaptureReader {
+		SharedMemory file;
+		const uint8_t *first;
+		const uint8_t *last;
+	public:
+		class const_iterator {
+			const uint8_t *pos;
+			const uint8_t *last;
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = CaptureEntry;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const CaptureEntry*;
+			using reference = CaptureEntry;
+
+			const_iterator(const uint8_t *pos, const uint8_t *last);
+			CaptureEntry operator*() const;
+			const_iterator& operator++();
+			bool operator==(const const_iterator &other) const { return pos == other.pos; }
+			bool operator!=(const const_iterator &other) const { return pos != other.pos; }
+		};
+
+		explicit CaptureReader(const std::string &path);
+
+		const CaptureFileHeader& header() const;
+		const_iterator begin() const;
+		const_iterator end() const;
+	};
+
+};
@@ -0,0 +1,187 @@
+#include "CaptureWriter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+	constexpr int flushIntervalMs{ 5 };
+	constexpr size_t fileBuffer{ 1 << 16 };
+	constexpr uint8_t padKind{ 0xFF }; // Rest of the ring up to its end is unused
+
+	size_t roundUpPow2(size_t n) {
+		size_t p = 64;
+		while (p < n) p <<= 1;
+		return p;
+	}
+}; // namespace
+
+namespace Procon {
+
+	CaptureError::CaptureError(const std::string &what) : std::runtime_error(what) {}
+	CaptureError::CaptureError(const char *what) : std::runtime_error(what) {}
+
+	CaptureChannel::CaptureChannel(uchar port, size_t bytes, std::chrono::steady_clock::time_point start)
+		:ring(roundUpPow2(bytes)), port(port), start(start) {
+	}
+
+	uint64_t CaptureChannel::now() const {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	// Records never wrap around the end of the ring, the space left there is
+	// skipped, marked with a pad record if one fits
+	bool CaptureChannel::record(CaptureKind kind, uint64_t time, const uint8_t *data, size_t size) {
+		size = std::min<size_t>(size, std::numeric_limits<uint16_t>::max());
+		const size_t span = captureRecordSpan(size);
+		const uint32_t seq = sequence++;
+		const size_t h = head.load(std::memory_order_relaxed);
+		const size_t offset = h & (ring.size() - 1);
+		const size_t toEnd = ring.size() - offset;
+		const size_t skip = span > toEnd ? toEnd : 0;
+		if (h + skip + span - tail.load(std::memory_order_acquire) > ring.size()) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		if (skip >= sizeof(CaptureRecord)) {
+			CaptureRecord pad{};
+			pad.kind = static_cast<CaptureKind>(padKind);
+			std::memcpy(ring.data() + offset, &pad, sizeof(pad));
+		}
+		uint8_t *out = ring.data() + ((h + skip) & (ring.size() - 1));
+		const CaptureRecord r{ time, seq, static_cast<uint16_t>(size), port, kind };
+		std::memcpy(out, &r, sizeof(r));
+		if (size > 0) {
+			std::memcpy(out + sizeof(r), data, size);
+		}
+		std::memset(out + sizeof(r) + size, 0, span - sizeof(r) - size);
+		head.store(h + skip + span, std::memory_order_release);
+		return true;
+	}
+
+	uint64_t CaptureChannel::droppedCount() const {
+		return dropped.load(std::memory_order_relaxed);
+	}
+
+	const CaptureRecord* CaptureChannel::peek() {
+		size_t t = tail.load(std::memory_order_relaxed);
+		const size_t h = head.load(std::memory_order_acquire);
+		if (t == h) return nullptr;
+		const size_t offset = t & (ring.size() - 1);
+		const size_t toEnd = ring.size() - offset;
+		const CaptureRecord *r = reinterpret_cast<const CaptureRecord*>(ring.data() + offset);
+		if (toEnd < sizeof(CaptureRecord) || static_cast<uint8_t>(r->kind) == padKind) {
+			t += toEnd;
+			tail.store(t, std::memory_order_release);
+			if (t == h) return nullptr;
+			r = reinterpret_cast<const CaptureRecord*>(ring.data());
+		}
+		return r;
+	}
+
+	void CaptureChannel::pop() {
+		const size_t t = tail.load(std::memory_order_relaxed);
+		const CaptureRecord *r = reinterpret_cast<const CaptureRecord*>(ring.data() + (t & (ring.size() - 1)));
+		tail.store(t + captureRecordSpan(r->size), std::memory_order_release);
+	}
+
+	CaptureWriter::CaptureWriter(const std::string &path, size_t channelBytes)
+		:file(std::fopen(path.c_str(), "wb")), start(std::chrono::steady_clock::now()), channelBytes(channelBytes) {
+		if (file == nullptr) {
+			throw CaptureError("Unable to create capture file " + path);
+		}
+		std::setvbuf(file, nullptr, _IOFBF, fileBuffer);
+		CaptureFileHeader header{};
+		header.magic = captureMagic;
+		header.version = captureVersion;
+		header.headerSize = sizeof(CaptureFileHeader);
+		header.startTime = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count());
+		if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+			std::fclose(file);
+			throw CaptureError("Unable to write capture file " + path);
+		}
+		for (auto &c : channels) {
+			c.store(nullptr, std::memory_order_relaxed);
+		}
+		thread = std::thread([this] { run(); });
+	}
+
+	CaptureWriter::~CaptureWriter() {
+		stopping = true;
+		thread.join();
+		std::fclose(file);
+	}
+
+	CaptureChannel& CaptureWriter::channel(uchar port) {
+		if (port >= capturePorts) {
+			throw std::out_of_range("Capture port out of range");
+		}
+		if (!owned[port]) {
+			owned[port] = std::make_unique<CaptureChannel>(port, channelBytes, start);
+			channels[port].store(owned[port].get(), std::memory_order_release);
+		}
+		return *owned[port];
+	}
+
+	CaptureWriter::Stats CaptureWriter::stats() const {
+		Stats s;
+		s.records = written.load(std::memory_order_relaxed);
+		s.bytes = bytes.load(std::memory_order_relaxed);
+		s.dropped = 0;
+		for (const auto &c : channels) {
+			const CaptureChannel *channel = c.load(std::memory_order_acquire);
+			if (channel != nullptr) s.dropped += channel->droppedCount();
+		}
+		s.failed = failed.load(std::memory_order_relaxed);
+		return s;
+	}
+
+	void CaptureWriter::run() {
+		while (!stopping.load(std::memory_order_relaxed)) {
+			drain();
+			std::fflush(file);
+			std::this_thread::sleep_for(std::chrono::milliseconds(flushIntervalMs));
+		}
+		drain();
+		std::fflush(file);
+	}
+
+	// Writes out every channel, oldest record first across channels
+	void CaptureWriter::drain() {
+		std::array<CaptureChannel*, capturePorts> active;
+		size_t count = 0;
+		for (auto &c : channels) {
+			CaptureChannel *channel = c.load(std::memory_order_acquire);
+			if (channel != nullptr) active[count++] = channel;
+		}
+		uint64_t records = 0;
+		uint64_t total = 0;
+		for (;;) {
+			CaptureChannel *oldest = nullptr;
+			const CaptureRecord *next = nullptr;
+			for (size_t i = 0; i < count; ++i) {
+				const CaptureRecord *r = active[i]->peek();
+				if (r != nullptr && (next == nullptr || r->time < next->time)) {
+					oldest = active[i];
+					next = r;
+				}
+			}
+			if (next == nullptr) break;
+			const size_t span = captureRecordSpan(next->size);
+			if (!failed.load(std::memory_order_relaxed)) {
+				if (std::fwrite(next, 1, span, file) == span) {
+					++records;
+					total += span;
+				}
+				else {
+					failed = true;
+				}
+			}
+			oldest->pop();
+		}
+		written.fetch_add(records, std::memory_order_relaxed);
+		bytes.fetch_add(total, std::memory_order_relaxed);
+	}
+
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CaptureFormat.hpp"
+#include "Common.hpp"
+
+namespace Procon {
+
+	class CaptureError : public std::runtime_error {
+	public:
+		explicit CaptureError(const std::string &what);
+		explicit CaptureError(const char *what);
+	};
+
+	// One port's records on their way to the file. A single-producer,
+	// single-consumer byte ring holding records already in file layout, so
+	// recording is one copy and never waits for the disk.
+	class CaptureChannel {
+		std::vector<uint8_t> ring; // Power of two
+		alignas(64) std::atomic<size_t> head{ 0 }; // Next write, producer only
+		alignas(64) std::atomic<size_t> tail{ 0 }; // Next read, consumer only
+		std::atomic<uint64_t> dropped{ 0 };
+		uint32_t sequence{ 0 };
+		uchar port;
+		std::chrono::steady_clock::time_point start;
+	public:
+		CaptureChannel(uchar port, size_t bytes, std::chrono::steady_clock::time_point start);
+
+		// Timestamp for record(), ns since the capture started
+		uint64_t now() const;
+		// Producer side. Returns false, and counts a drop, if the ring is full.
+		// Payloads past 0xFFFF bytes are cut short.
+		bool record(CaptureKind kind, uint64_t time, const uint8_t *data, size_t size);
+		uint64_t droppedCount() const;
+
+		// Consumer side. The oldest record, in file layout, or nullptr if empty.
+		const CaptureRecord* peek();
+		// Releases the record peek() returned
+		void pop();
+	};
+
+	// Appends the raw traffic of every controller to a capture file (see
+	// CaptureFormat.hpp). Controllers record into their port's channel and a
+	// background thread writes the channels out every few milliseconds,
+	// merged in time order. Records are dropped, not waited for, if the
+	// writer falls behind.
+	// Throws Procon::CaptureError from the constructor.
+	class CaptureWriter {
+		std::FILE *file;
+		std::chrono::steady_clock::time_point start;
+		size_t channelBytes;
+		std::array<std::unique_ptr<CaptureChannel>, capturePorts> owned;
+		std::array<std::atomic<CaptureChannel*>, capturePorts> channels;
+		std::atomic<bool> stopping{ false };
+		std::atomic<uint64_t> written{ 0 };
+		std::atomic<uint64_t> bytes{ 0 };
+		std::atomic<bool> failed{ false };
+		std::thread thread;
+	public:
+		struct Stats {
+			uint64_t records;
+			uint64_t bytes;
+			uint64_t dropped;
+			bool failed; // A write to the file failed, nothing more was written
+		};
+
+		// Creates or truncates 'path'. Each channel buffers 'channelBytes'.
+		explicit CaptureWriter(const std::string &path, size_t channelBytes = 1 << 20);
+		CaptureWriter(const CaptureWriter&) = delete;
+		CaptureWriter& operator=(const CaptureWriter&) = delete;
+		// Writes out everything recorded so far
+		~CaptureWriter();
+
+		// Creates the channel on first use, from the thread that sets up
+		// controllers. Throws std::out_of_range past capturePorts.
+		CaptureChannel& channel(uchar port);
+		Stats stats() const;
+	private:
+		void run();
+		void drain();
+	};
+
+};
@@ -0,0 +1,174 @@
+#include "Combos.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <sstream>
+
+#include "Config.hpp"
+
+namespace {
+	using namespace Procon;
+
+	const std::string comboConfigPrefix{ "sCombo" };
+	constexpr uint16_t noState{ 0xffff };
+	constexpr uint32_t maxWindowMs{ 60000 };
+
+	const std::array<std::pair<ComboAction, const char*>, 4> actionNames{ {
+		{ ComboAction::Recenter, "Recenter" },
+		{ ComboAction::Disconnect, "Disconnect" },
+		{ ComboAction::NextProfile, "NextProfile" },
+		{ ComboAction::PreviousProfile, "PreviousProfile" },
+	} };
+
+	size_t symbolOf(Button b) {
+		return static_cast<size_t>(b) - 1;
+	}
+
+}; // namespace
+
+namespace Procon {
+
+	ComboSpec parseCombo(ComboAction action, const std::string &text) {
+		ComboSpec spec{ action, {}, 0, 0 };
+		std::string steps = text;
+		const size_t slash = text.find('/');
+		if (slash != std::string::npos) {
+			steps = text.substr(0, slash);
+			const std::string ms = text.substr(slash + 1);
+			if (ms.empty() || ms.find_first_not_of("0123456789") != std::string::npos || ms.size() > 5
+				|| std::stoul(ms) > maxWindowMs) {
+				throw ConfigError("Combo " + text + " must have a time window of 0 to " + std::to_string(maxWindowMs) + " ms");
+			}
+			spec.window = static_cast<uint32_t>(std::stoul(ms)) * 1000;
+		}
+		std::stringstream s{ steps };
+		std::string step;
+		while (std::getline(s, step, ',')) {
+			std::stringstream buttons{ step };
+			std::string name;
+			std::optional<Button> last;
+			while (std::getline(buttons, name, '+')) {
+				std::optional<Button> button = buttonFromName(name);
+				if (!button || *button == Button::None) {
+					throw ConfigError("Combo " + text + " has unknown button " + name);
+				}
+				if (last) {
+					spec.held |= packedButtonBit(*last);
+				}
+				last = button;
+			}
+			if (!last) {
+				throw ConfigError("Combo " + text + " has an empty step");
+			}
+			spec.presses.push_back(*last);
+		}
+		if (spec.presses.empty() || spec.presses.size() > maxComboLength) {
+			throw ConfigError("Combo " + text + " must have 1 to " + std::to_string(maxComboLength) + " steps");
+		}
+		return spec;
+	}
+
+	std::vector<ComboSpec> comboSpecsFromConfig() {
+		std::vector<ComboSpec> specs;
+		for (const auto &action : actionNames) {
+			std::optional<std::string> text = Config::get<std::string>(comboConfigPrefix + action.second);
+			if (text && !text->empty()) {
+				specs.push_back(parseCombo(action.first, *text));
+			}
+		}
+		return specs;
+	}
+
+	ComboAutomaton::ComboAutomaton(std::vector<ComboSpec> specs) :combos(std::move(specs)) {
+		std::array<uint16_t, symbolCount> empty;
+		empty.fill(noState);
+
+		// Trie of all press sequences
+		next.push_back(empty);
+		accepts.emplace_back();
+		for (uint16_t c = 0; c < combos.size(); ++c) {
+			uint16_t s = 0;
+			for (Button b : combos[c].presses) {
+				uint16_t &target = next[s][symbolOf(b)];
+				if (target == noState) {
+					target = static_cast<uint16_t>(next.size());
+					next.push_back(empty);
+					accepts.emplace_back();
+				}
+				s = next[s][symbolOf(b)];
+			}
+			accepts[s].push_back(c);
+		}
+
+		// Breadth first, fill missing transitions from the failure state and
+		// inherit its accepts, so a state also completes every combo that is a
+		// suffix of its own sequence.
+		std::vector<uint16_t> fail(next.size(), 0);
+		std::deque<uint16_t> queue;
+		for (uint16_t &target : next[0]) {
+			if (target == noState) {
+				target = 0;
+			}
+			else {
+				queue.push_back(target);
+			}
+		}
+		while (!queue.empty()) {
+			const uint16_t s = queue.front();
+			queue.pop_front();
+			accepts[s].insert(accepts[s].end(), accepts[fail[s]].begin(), accepts[fail[s]].end());
+			for (size_t a = 0; a < symbolCount; ++a) {
+				uint16_t &target = next[s][a];
+				if (target == noState) {
+					target = next[fail[s]][a];
+				}
+				else {
+					fail[target] = next[fail[s]][a];
+					queue.push_back(target);
+				}
+			}
+		}
+
+		for (std::vector<uint16_t> &list : accepts) {
+			std::stable_sort(list.begin(), list.end(), [this](uint16_t a, uint16_t b) {
+				return combos[a].presses.size() > combos[b].presses.size();
+			});
+		}
+	}
+
+	ComboAutomaton ComboAutomaton::fromConfig() {
+		return ComboAutomaton(comboSpecsFromConfig());
+	}
+
+	bool ComboAutomaton::empty() const {
+		return combos.empty();
+	}
+
+	size_t ComboAutomaton::stateCount() const {
+		return next.size();
+	}
+
+	ComboRecognizer::ComboRecognizer(const ComboAutomaton &automaton) :automaton(automaton) {
+	}
+
+	ComboAction ComboRecognizer::feed(const ButtonEvent &e, uint32_t held) {
+		if (!e.down || e.button == Button::None) {
+			return ComboAction::None;
+		}
+		pressTimes[pressCount++ % maxComboLength] = e.time;
+		state = automaton.next[state][symbolOf(e.button)];
+		for (uint16_t c : automaton.accepts[state]) {
+			const ComboSpec &combo = automaton.combos[c];
+			if ((held & combo.held) != combo.held) continue;
+			if (combo.window != 0) {
+				const uint32_t start = pressTimes[(pressCount - combo.presses.size()) % maxComboLength];
+				if (e.time - start > combo.window) continue;
+			}
+			// Start over so the presses of one combo can't complete another
+			state = 0;
+			return combo.action;
+		}
+		return ComboAction::None;
+	}
+
+};
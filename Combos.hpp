@@ -0,0 +1,77 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ButtonEvents.hpp"
+#include "ButtonMap.hpp"
+#include "Common.hpp"
+
+namespace Procon {
+
+	enum class ComboAction : uint8_t {
+		None,
+		Recenter,
+		Disconnect,
+		NextProfile,
+		PreviousProfile,
+	};
+
+	constexpr size_t maxComboLength{ 16 };
+
+	// A combo completes when 'presses' are pressed in order with no other
+	// presses in between, 'held' buttons are all down at the last press, and
+	// the whole sequence took at most 'window' microseconds (0 for no limit).
+	struct ComboSpec {
+		ComboAction action;
+		std::vector<Button> presses;
+		uint32_t held; // packButtons mask
+		uint32_t window;
+	};
+
+	// Parses steps separated by commas, each step being buttons joined by +.
+	// The last button of a step is pressed, the ones before it must be held.
+	// An optional /<ms> suffix sets the time window, up to a minute. For
+	// example Home+A, or DPadUp,DPadUp,DPadDown/300.
+	// Throws Procon::ConfigError.
+	ComboSpec parseCombo(ComboAction action, const std::string &text);
+	// Reads sCombo<Action> entries (Recenter, Disconnect, NextProfile,
+	// PreviousProfile) from Config.
+	std::vector<ComboSpec> comboSpecsFromConfig();
+
+	// All combos compiled into one deterministic automaton over button
+	// presses (an Aho-Corasick automaton with every transition filled in).
+	// Recognising costs one table lookup per press however many combos exist.
+	// Immutable, shared by all controllers.
+	class ComboAutomaton {
+		friend class ComboRecognizer;
+		static constexpr size_t symbolCount{ buttonCount - 1 }; // Every Button but None
+
+		std::vector<std::array<uint16_t, symbolCount>> next;
+		std::vector<std::vector<uint16_t>> accepts; // Combos completed in each state, longest first
+		std::vector<ComboSpec> combos;
+	public:
+		explicit ComboAutomaton(std::vector<ComboSpec> combos);
+		// Throws Procon::ConfigError.
+		static ComboAutomaton fromConfig();
+
+		bool empty() const;
+		size_t stateCount() const;
+	};
+
+	// One controller's position in a ComboAutomaton.
+	class ComboRecognizer {
+		const ComboAutomaton &automaton;
+		uint16_t state{ 0 };
+		std::array<uint32_t, maxComboLength> pressTimes{};
+		size_t pressCount{ 0 };
+	public:
+		explicit ComboRecognizer(const ComboAutomaton &automaton);
+
+		// 'held' is the packButtons mask including this event. Returns the
+		// action of the combo this event completes, if any.
+		ComboAction feed(const ButtonEvent &e, uint32_t held);
+	};
+
+};
@@ -1,9 +1,23 @@
 #pragma once
+#include <cstdint>
+#include <utility>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace Procon {
 
 	using uchar = unsigned char;
 
+	constexpr uchar operator ""_uc(unsigned long long t) {
+		return static_cast<uchar>(t);
+	}
+
+	struct StickPoint {
+		uchar x;
+		uchar y;
+	};
+
 	// RAII function object
 	template<class T>
 	class ScopedFunction {
@@ -22,7 +36,7 @@ namespace Procon {
 		return ScopedFunction<T>(std::move(f));
 	}
 
-	enum class Button {
+	enum class Button : uint8_t {
 		None,
 		DPadUp,
 		DPadDown,
@@ -50,6 +64,31 @@ namespace Procon {
 		Middle
 	};
 
+	// Index of the lowest set bit, v must not be 0
+	inline int lowestSetBit(uint32_t v) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, v);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctz(v);
+#endif
+	}
+
+	// Index of the highest set bit, v must not be 0
+	inline int highestSetBit(uint64_t v) {
+#ifdef _MSC_VER
+		unsigned long index;
+		if (_BitScanReverse(&index, static_cast<unsigned long>(v >> 32)) != 0) {
+			return static_cast<int>(index) + 32;
+		}
+		_BitScanReverse(&index, static_cast<unsigned long>(v));
+		return static_cast<int>(index);
+#else
+		return 63 - __builtin_clzll(v);
+#endif
+	}
+
 	constexpr int JoyconL_ID = 0x2006;
 	constexpr int JoyconR_ID = 0x2007;
 	constexpr int Procon_ID = 0x2009;
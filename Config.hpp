@@ -36,6 +36,17 @@ namespace Procon {
 			return {};
 		}
 
+		// Looks up 'name@scope' first, then falls back to 'name'.
+		// Used for settings that can be overridden per profile.
+		template<class T>
+		static std::optional<T> get(const std::string& name, const std::string& scope) {
+			if (!scope.empty()) {
+				std::optional<T> scoped = get<T>(name + '@' + scope);
+				if (scoped) return scoped;
+			}
+			return get<T>(name);
+		}
+
 		template<class T>
 		static void store(const std::string& name, const T& value) {
 			getStore<T>().insert({ name, value });
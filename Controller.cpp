@@ -2,56 +2,39 @@
 
 #include <array>
 #include <algorithm>
+#include <cstddef>
 #ifdef _DEBUG
 #include <iostream>
 #endif
 #include <string>
 #include <limits>
-#include <vector>
 
-#include "hidapi.h"
-#include "XOutput.hpp"
+#include "CaptureWriter.hpp"
 #include "Config.hpp"
-
-using namespace XOutput;
+#include "LatencyMonitor.hpp"
 
 namespace Procon {
 	using std::array;
 
-	void SetDefaultCalibration(CalibrationData &dat) {
-		constexpr uchar ucmin = std::numeric_limits<uchar>::min();
-		constexpr uchar ucmax = std::numeric_limits<uchar>::max();
-		dat.leftCenter.x = ucmax / 2;
-		dat.leftCenter.y = ucmax / 2;
-		dat.rightCenter = dat.leftCenter;
-		dat.left.x.min = dat.leftCenter.x;
-		dat.left.x.max = dat.leftCenter.x;
-		dat.left.y = dat.left.x;
-		dat.right = dat.left;
-	}
-
-	void HIDCloser::operator()(hid_device *ptr) {
-		if (ptr != nullptr)
-			hid_close(ptr);
-	}
-	void zeroPadState(ExpandedPadState &state) {
-		state.xinState = { 0 };
-		state.leftStick = { 0 };
-		state.rightStick = { 0 };
-		state.sharePressed = false;
-	}
-	Controller::Controller(uchar port) :device(nullptr), port(port) {
+	Controller::Controller(uchar port, TimerWheel &wheel, const ProfileSet &profiles, const ComboAutomaton &combos, OutputSink &sink)
+		:device(nullptr), port(port), macros(wheel), profiles(profiles), profile(&profiles.defaultProfile()), combos(combos), sink(sink) {
 		SetDefaultCalibration(calib);
 	}
-	Controller::Controller(Controller &&) = default;
-	Controller& Controller::operator=(Controller &&) = default;
 	Controller::~Controller() {
+		disconnect();
+	}
+	void Controller::disconnect() {
+		for (StateObserver *o : observers) {
+			o->setConnected(port, false);
+		}
 		if (_connected) {
-			XOutputUnPlug(port);
+			sink.unplug(port);
+			_connected = false;
 		}
 		if (device) {
 			static const array<uchar, 2> disconnect{ 0x80, 0x05 };
 			exchange(disconnect);
+			device.reset();
 		}
 	}
 
@@ -74,47 +57,26 @@ namespace {
 
 	constexpr uchar ledCommand{ 0x30 };
 	const array<uchar, 1> led{ 0x1 };
+	constexpr uchar reportModeCommand{ 0x03 };
+	const array<uchar, 1> fullReports{ 0x30 };
+
+	// Stage timing
+	uint64_t nanosBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+	}
 
 	// pollInput
 	constexpr uchar getInput{ 0x1f };
 	const array<uchar, 0> empty{};
-
-	struct InputPacket {
-		uint8_t header[8];
-		uint8_t unknown[5];
-		uint8_t rightButtons;
-		uint8_t middleButtons;
-		uint8_t leftButtons;
-		uint8_t sticks[6];
-	};
+	constexpr uchar streamedReport{ 0x30 };
+	constexpr size_t streamedLen{ 64 };
+	// A spinning read gives up after this, like a blocking one would
+	constexpr auto spinLimit = std::chrono::milliseconds(10);
 
 	constexpr double lerp(double min, double max, double t) {
 		return (1.0 - t) * min + t * max;
 	}
 
-	// stick is current stick location, range is min/max of stick, center is center point of stick
-	void calibrateToRange(const StickPoint &stick, const StickRange &range, const StickPoint &center, short &outx, short &outy) {
-		constexpr short smax = std::numeric_limits<short>::max();
-		constexpr short smin = std::numeric_limits<short>::min();
-		
-		outx = static_cast<short>(
-			smax * std::clamp(
-				(static_cast<double>(stick.x) - center.x) / static_cast<double>(range.x.max - range.x.min) * 2.0,
-				-1.0,
-				1.0
-			)
-			
-		);
-		outy = static_cast<short>(
-			smax *std::clamp(
-				(static_cast<double>(stick.y) - center.y) / static_cast<double>(range.y.max - range.y.min) * 2.0,
-				-1.0,
-				1.0
-			)
-		);
-
-	}
-
 	short expandUChar(uchar c) {
 		constexpr uchar ucmax = std::numeric_limits<uchar>::max();
 		constexpr short smax = std::numeric_limits<short>::max();
@@ -127,351 +89,251 @@ namespace {
 };
 namespace Procon {
 
-	void Controller::openDevice(hid_device_info *dev) {
+	void Controller::openDevice(std::unique_ptr<HidTransport> transport) {
 		using namespace std::this_thread;
 		using namespace std::chrono;
 
-		if (dev == nullptr)
-			throw ControllerException("Unable to open controller device: dev was nullptr.");
-		if (dev->product_id != Procon_ID)
-			throw ControllerException("Unable to open controller device: product id was not a Switch Pro Controller.");
-		device.reset(hid_open_path(dev->path));
-		if (!device)
-			throw ControllerException("Unable to open controller device: device path could not be opened.");
-		//vController.ProductId = dev->product_id;
-		//vController.VendorId = dev->vendor_id;
-		if (!exchange(handshake)) {
-			throw ControllerException("Handshake failed.");
-		}
-		exchange(switchBaudrate);
-		exchange(handshake);
-		exchange(HIDOnlyMode);
-		
+		if (!transport)
+			throw ControllerException("Unable to open controller device: transport was nullptr.");
+		TraceScope trace{ "open_device", port };
+		device = std::move(transport);
+		{
+			TraceScope step{ "handshake", port };
+			if (!exchange(handshake)) {
+				throw ControllerException("Handshake failed.");
+			}
+		}
+		{
+			TraceScope step{ "switch_baudrate", port };
+			exchange(switchBaudrate);
+			exchange(handshake);
+		}
+		{
+			TraceScope step{ "hid_only_mode", port };
+			exchange(HIDOnlyMode);
+		}
 		
 		sendSubcommand(0x1, rumbleCommand, enable);
 		sendSubcommand(0x1, imuDataCommand, enable);
 		sendSubcommand(0x1, ledCommand, led);
+		if (reading.mode == ReportMode::Stream) {
+			sendSubcommand(0x1, reportModeCommand, fullReports); // Last, so no report comes instead of a reply
+		}
 
-		if (XOutputPlugIn(port) != ERROR_SUCCESS) {
+		try {
+			TraceScope step{ "plug_in", port };
+			sink.plugIn(port);
+		}
+		catch (const OutputError &e) {
 			device.reset(nullptr);
-			throw ControllerException("Unable to plugin XOutput controller.");
+			throw ControllerException(e.what());
 		}
 		_connected = true;
+		TraceScope step{ "settle", port };
 		sleep_for(milliseconds(100));
 		//updateStatus();
 	}
 
 };
 namespace {
-	using std::vector;
-	using std::tuple;
 	using std::array;
 
 	using namespace Procon;
 
-	const std::array<Button, 8> JoyconLBitmap =
-	{
-		Button::DPadDown,
-		Button::DPadUp,
-		Button::DPadRight,
-		Button::DPadLeft,
-		Button::None,
-		Button::None,
-		Button::L,
-		Button::LZ
+	const uint32_t shareButton = packedButtonBit(Button::Share);
+	const array<uint32_t, 4> profileChord{
+		packedButtonBit(Button::DPadUp),
+		packedButtonBit(Button::DPadRight),
+		packedButtonBit(Button::DPadDown),
+		packedButtonBit(Button::DPadLeft)
 	};
+	const uint32_t profileChordButtons = profileChord[0] | profileChord[1] | profileChord[2] | profileChord[3];
 
-	const std::array<Button, 8> JoyconRBitmap = {
-		Button::Y,
-		Button::X,
-		Button::B,
-		Button::A,
-		Button::None,
-		Button::None,
-		Button::R,
-		Button::RZ
-	};
-
-	const std::array<Button, 8> JoyconMidBitmap = {
-		Button::Minus,
-		Button::Plus,
-		Button::RStick,
-		Button::LStick,
-		Button::Home,
-		Button::Share,
-		Button::None,
-		Button::None
-	};
+	int16_t readInt16(const uint8_t *bytes) {
+		return static_cast<int16_t>(bytes[0] | (bytes[1] << 8));
+	}
 
-	const array<Button, 8>& getButtonMap(ButtonSource s) {
-		switch (s) {
-		case ButtonSource::Left:
-			return JoyconLBitmap;
-		case ButtonSource::Middle:
-			return JoyconMidBitmap;
-		case ButtonSource::Right:
-			return JoyconRBitmap;
-		default:
-			throw std::logic_error("Unknown ButtonSource passed to getButtonMap");
-		}
-	}
-
-	void pullButtonsFromByte(uchar c, ButtonSource src, vector<tuple<Button, bool>> &out) {
-		const array<Button, 8>& map = getButtonMap(src);
-		for (uchar i{ 0 }; i < 8; ++i) {
-			if (map[i] == Button::None) continue;
-			out.push_back(std::make_tuple(map[i], (c & (1 << i)) != 0));
-		}
-	}
-
-	constexpr unsigned short buttonToReportBits(Button b){
-		switch (b) {
-		case Button::DPadUp:
-			return 0x0001;
-		case Button::DPadDown:
-			return 0x0002;
-		case Button::DPadLeft:
-			return 0x0004;
-		case Button::DPadRight:
-			return 0x0008;
-		case Button::Plus:
-			return 0x0010;
-		case Button::Minus:
-			return 0x0020;
-		case Button::LStick:
-			return 0x0040;
-		case Button::RStick:
-			return 0x0080;
-		case Button::L:
-			return 0x0100;
-		case Button::R:
-			return 0x0200;
-		case Button::Home:
-			return 0x0400; // Undocumented
-
-		// NOTICE: A and B are swapped, and X and Y are swapped.
-		case Button::A:
-			return 0x2000;
-		case Button::B:
-			return 0x1000;
-		case Button::X:
-			return 0x8000;
-		case Button::Y:
-			return 0x4000;
-		default:
-			return 0x0000;
-		}
-	}
-	constexpr unsigned short buttonToReportBitsOld(Button b) {
-		switch (b) {
-		case Button::DPadUp:
-			return 0x0001;
-		case Button::DPadDown:
-			return 0x0002;
-		case Button::DPadLeft:
-			return 0x0004;
-		case Button::DPadRight:
-			return 0x0008;
-		case Button::Plus:
-			return 0x0010;
-		case Button::Minus:
-			return 0x0020;
-		case Button::LStick:
-			return 0x0040;
-		case Button::RStick:
-			return 0x0080;
-		case Button::L:
-			return 0x0100;
-		case Button::R:
-			return 0x0200;
-		case Button::Home:
-			return 0x0400; // Undocumented
-
-		case Button::A:
-			return 0x1000;
-		case Button::B:
-			return 0x2000;
-		case Button::X:
-			return 0x4000;
-		case Button::Y:
-			return 0x8000;
-		default:
-			return 0x0000;
+	PublishedState makePublishedState(const InputPacket &p, uint64_t frame, uint32_t time, const ExpandedPadState &state, uchar profile) {
+		PublishedState s{};
+		s.frame = frame;
+		s.time = time;
+		s.buttons = packButtons(p.leftButtons, p.rightButtons, p.middleButtons);
+		s.xinState = state.xinState;
+		s.leftStick = state.leftStick;
+		s.rightStick = state.rightStick;
+		const uint8_t *newest = p.imu + 24;
+		for (int i = 0; i < 3; ++i) {
+			s.accel[i] = readInt16(newest + 2 * i);
+			s.gyro[i] = readInt16(newest + 6 + 2 * i);
 		}
+		s.timer = p.timer;
+		s.profile = profile;
+		return s;
 	}
+}; //namespace
 
-	const std::string buttonConfigName{ "bMatchButtonLabels" };
+namespace Procon {
 
-	void mapButtonToState(Button b, ExpandedPadState &state) {
-		switch (b) {
-		case Button::LZ:
-			state.xinState.bLeftTrigger = std::numeric_limits<BYTE>::max();
-			return;
-		case Button::RZ:
-			state.xinState.bRightTrigger = std::numeric_limits<BYTE>::max();
+	void Controller::pollInput() {
+		if (!device)
 			return;
-		case Button::Share:
-			state.sharePressed = true;
+
+		if ((reading.phaseLock || idleMode.idle()) && !pollDue(clock::now()))
 			return;
-		default:
-			if (Config::get<bool>(buttonConfigName).value_or(false)) {
-				state.xinState.wButtons |= buttonToReportBitsOld(b);
+
+		TraceScope trace{ "poll", port };
+		// Idle polls skip the samples in between on purpose
+		const bool idlePoll = reading.mode == ReportMode::Poll && idleMode.idle();
+		InputPacket p;
+		if (reading.mode == ReportMode::Stream ? readStreamed(p) : readPolled(p)) {
+			const uint32_t time = device->readTime();
+			rates.add(time, p.timer, idlePoll);
+
+			{
+				TraceScope step{ "decode", port };
+				zeroPadState(padStatus);
+				mapInputToState(p, *profile.load(std::memory_order_acquire), calib, stickFilter, macros, padStatus);
+				updateButtons(packButtons(p.leftButtons, p.rightButtons, p.middleButtons), time);
+			}
+
+			if (PadMailbox *m = mailbox.load(std::memory_order_acquire)) { // Before the sink, which may take a while
+				m->publish(padStatus);
+			}
+			const PadUpdate update{ port, padStatus.xinState };
+			if (timing != nullptr) {
+				const clock::time_point decoded = clock::now();
+				{
+					TraceScope step{ "output", port };
+					sink.submit(&update, 1);
+				}
+				timing->record(PollStage::Decode, nanosBetween(readDone, decoded));
+				timing->record(PollStage::Output, nanosBetween(decoded, clock::now()));
 			}
 			else {
-				state.xinState.wButtons |= buttonToReportBits(b);
+				TraceScope step{ "output", port };
+				sink.submit(&update, 1);
 			}
-			return;
+			idleMode.report(padStatus.xinState);
+			++frames;
+			if (!observers.empty()) {
+				const uchar profileIndex = static_cast<uchar>(profiles.indexOf(getProfile()));
+				const PublishedState s = makePublishedState(p, frames, time, padStatus, profileIndex);
+				for (StateObserver *o : observers) {
+					o->publish(port, s);
+				}
+			}
+			if (disconnectRequested) {
+				disconnect();
+			}
+		}
+		else {
+			rates.advance(device->readTime());
 		}
+		//updateStatus();
 	}
 
-	void updateCalibrationRangeStick(const StickPoint &input, StickRange &cal) {
-		using std::max;
-		using std::min;
-
-		cal.x.max = max(cal.x.max, input.x);
-		cal.x.min = min(cal.x.min, input.x);
-		cal.y.max = max(cal.y.max, input.y);
-		cal.y.min = min(cal.y.min, input.y);
-		
+	Controller::clock::time_point Controller::nextPoll(clock::time_point now) const {
+		if (!device) return clock::time_point::max();
+		// Streamed reports are read as they come, idle or not
+		if (reading.mode != ReportMode::Poll) return now;
+		const clock::time_point from = idleMode.next(now);
+		return reading.phaseLock ? phase.next(from) : from;
 	}
-
-	void updateCalibrationRange(const ExpandedPadState &state, CalibrationData &cal) {
-		updateCalibrationRangeStick(state.leftStick, cal.left);
-		updateCalibrationRangeStick(state.rightStick, cal.right);
+	bool Controller::pollDue(clock::time_point now) const {
+		return nextPoll(now) <= now;
 	}
 
-#ifdef _DEBUG
-	using std::string;
-
-	const string buttonA{ "A" };
-	const string buttonB{ "B" };
-	const string buttonX{ "X" };
-	const string buttonY{ "Y" };
-	const string buttonLStick{ "Left Stick" };
-	const string buttonRStick{ "Right Stick" };
-	const string buttonL{ "L" };
-	const string buttonR{ "R" };
-	const string buttonLZ{ "LZ" };
-	const string buttonRZ{ "RZ" };
-	const string buttonHome{ "Home" };
-	const string buttonShare{ "Share" };
-	const string buttonPlus{ "Plus" };
-	const string buttonMinus{ "Minus" };
-	const string buttonDPUp{ "DPad Up" };
-	const string buttonDPLeft{ "DPad Left" };
-	const string buttonDPRight{ "DPad Right" };
-	const string buttonDPDown{ "DPad Down" };
-	const string buttonNone{ "None" };
-	const string buttonUnknown{ "Unknown" };
-
-	const std::string& buttonToString(Button b) {
-		switch (b) {
-		case Button::A:
-			return buttonA;
-		case Button::B:
-			return buttonB;
-		case Button::X:
-			return buttonX;
-		case Button::Y:
-			return buttonY;
-		case Button::LStick:
-			return buttonLStick;
-		case Button::RStick:
-			return buttonRStick;
-		case Button::L:
-			return buttonL;
-		case Button::LZ:
-			return buttonLZ;
-		case Button::R:
-			return buttonR;
-		case Button::RZ:
-			return buttonRZ;
-		case Button::Home:
-			return buttonHome;
-		case Button::Share:
-			return buttonShare;
-		case Button::Plus:
-			return buttonPlus;
-		case Button::Minus:
-			return buttonMinus;
-		case Button::DPadDown:
-			return buttonDPDown;
-		case Button::DPadUp:
-			return buttonDPUp;
-		case Button::DPadLeft:
-			return buttonDPLeft;
-		case Button::DPadRight:
-			return buttonDPRight;
-		case Button::None:
-			return buttonNone;
-		default:
-			return buttonUnknown;
+	bool Controller::readPolled(InputPacket &p) {
+		if (idleMode.idle()) {
+			// A reply that came after its read gave up would be taken for
+			// this poll's, a whole idle period old
+			std::array<uchar, exchangeLen> stale;
+			while (device->readTimeout(stale.data(), stale.size(), 0) > 0) {
+			}
 		}
+		const clock::time_point sent = reading.phaseLock ? clock::now() : clock::time_point{};
+		auto dat = sendCommand(getInput, empty);
+		if (!dat) {
+			throw ControllerException("Error sending getInput command.");
+		}
+		// 0x30 is a streamed report rather than the reply, 0 means nothing was read
+		if (dat.value()[0] == streamedReport || dat.value()[0] == 0x00) return false;
+		memcpy(&p, dat.value().data(), sizeof(InputPacket));
+		if (reading.phaseLock) {
+			phase.reply(sent, p.timer);
+		}
+		return true;
 	}
-#endif //#ifdef _DEBUG
-
-	void mapInputToState(const InputPacket &p, CalibrationData &cal, ExpandedPadState &state) {
-		state.leftStick.x = ((p.sticks[1] & 0x0F) << 4) | ((p.sticks[0] & 0xF0) >> 4);
-		state.leftStick.y = p.sticks[2];
-		state.rightStick.x = ((p.sticks[4] & 0x0F) << 4) | ((p.sticks[3] & 0xF0) >> 4);
-		state.rightStick.y = p.sticks[5];
-		
-		updateCalibrationRange(state, cal);
 
-		// Sets state.xinState's sticks
-		calibrateToRange(state.leftStick, cal.left, cal.leftCenter, state.xinState.sThumbLX, state.xinState.sThumbLY);
-		calibrateToRange(state.rightStick, cal.right, cal.rightCenter, state.xinState.sThumbRX, state.xinState.sThumbRY);
-
-		vector<tuple<Button, bool>> buttons;
-		pullButtonsFromByte(p.leftButtons, ButtonSource::Left, buttons);
-		pullButtonsFromByte(p.rightButtons, ButtonSource::Right, buttons);
-		pullButtonsFromByte(p.middleButtons, ButtonSource::Middle, buttons);
-
-		for (auto pair : buttons) {
-			if (std::get<1>(pair)) {
-#ifdef _DEBUG
-				std::cout << buttonToString(std::get<0>(pair)) << ' ';
-#endif
-				mapButtonToState(std::get<0>(pair), state);
-			}
+	// Streamed reports come without the header of a reply to getInput
+	bool Controller::readStreamed(InputPacket &p) {
+		std::array<uchar, streamedLen> buf;
+		const clock::time_point start = timing != nullptr ? clock::now() : clock::time_point{};
+		int read;
+		{
+			TraceScope trace{ "hid_read", port };
+			read = receive(buf.data(), buf.size());
+		}
+		if (read < 0) {
+			throw ControllerException("Error reading input report.");
+		}
+		if (timing != nullptr) {
+			timeExchange(start, start);
+		}
+		if (capture != nullptr) {
+			capture->record(CaptureKind::Report, captureTime(), buf.data(), static_cast<size_t>(read));
 		}
+		constexpr size_t header = offsetof(InputPacket, reportId);
+		if (read == 0 || buf[0] != streamedReport) return false;
+		memset(&p, 0, header);
+		memcpy(reinterpret_cast<uchar*>(&p) + header, buf.data(), sizeof(InputPacket) - header);
+		return true;
 	}
 
-	unsigned char operator ""_uc(unsigned long long t) {
-		return static_cast<unsigned char>(t);
+	int Controller::receive(uchar *data, size_t size) {
+		if (reading.wait == ReadWait::Block || idleMode.idle()) { // Nobody waits on an idle controller
+			return device->read(data, size);
+		}
+		if (reading.wait == ReadWait::Adaptive) {
+			return waiter.read(*device, data, size, reading.mode == ReportMode::Stream, spinLimit);
+		}
+		const clock::time_point until = clock::now() + spinLimit;
+		int read;
+		while ((read = device->readTimeout(data, size, 0)) == 0 && clock::now() < until) {
+		}
+		return read;
 	}
-}; //namespace
 
-namespace Procon {
-
-	void Controller::pollInput() {
-		if (!device)
-			return;
+	void Controller::setReadSettings(const ReadSettings &s) {
+		reading = s;
+		idleMode.configure(std::chrono::milliseconds(s.idleAfterMs), std::chrono::milliseconds(s.idlePollMs));
+	}
 
-		auto dat = sendCommand(getInput, empty);
-		if (!dat) {
-			throw ControllerException("Error sending getInput command.");
+	ReadSettings ReadSettings::fromConfig() {
+		ReadSettings s;
+		s.mode = Config::get<bool>("bStreamReports").value_or(false) ? ReportMode::Stream : ReportMode::Poll;
+		const std::string wait = Config::get<std::string>("sReadWait").value_or("block");
+		if (wait == "spin") {
+			s.wait = ReadWait::Spin;
 		}
-		if (dat.value()[0] != 0x30) {
-			InputPacket p;
-			memcpy(&p, dat.value().data(), sizeof(InputPacket));
-
-			zeroPadState(padStatus);
-			mapInputToState(p, calib, padStatus);
-			
-			DWORD err;
-			if ((err = XOutputSetState(port, &padStatus.xinState)) != ERROR_SUCCESS) {
-				std::string errMsg{ "XOutput Error: " };
-				errMsg += std::to_string(err);
-				throw ControllerException(errMsg);
-			}
+		else if (wait == "adaptive") {
+			s.wait = ReadWait::Adaptive;
 		}
-		//updateStatus();
+		else if (wait != "block") {
+			throw ConfigError("sReadWait must be block, spin or adaptive, not " + wait);
+		}
+		s.phaseLock = Config::get<bool>("bPhaseLock").value_or(false);
+		s.idleAfterMs = static_cast<uint32_t>(std::max(Config::get<int32_t>("iIdleAfterMs").value_or(0), 0));
+		s.idlePollMs = static_cast<uint32_t>(std::max(Config::get<int32_t>("iIdlePollMs").value_or(20), 1));
+		return s;
 	}
 
 	bool Controller::connected() const {
 		return _connected;
 	}
+	bool Controller::idle() const {
+		return idleMode.idle();
+	}
 	uchar Controller::getPort() const {
 		return port;
 	}
@@ -482,20 +344,124 @@ namespace Procon {
 		calib.leftCenter = left;
 		calib.rightCenter = right;
 	}
+	void Controller::setProfile(const Profile &p) {
+		profile.store(&p, std::memory_order_release);
+	}
+	const Profile& Controller::getProfile() const {
+		return *profile.load(std::memory_order_acquire);
+	}
+	ReportStats::Summary Controller::reportStats() const {
+		return rates.summary();
+	}
+	AdaptiveWait::Stats Controller::waitStats() const {
+		return waiter.stats();
+	}
+	PhaseLock::Stats Controller::phaseStats() const {
+		return phase.stats();
+	}
+	IdleMode::Stats Controller::idleStats() const {
+		return idleMode.stats();
+	}
+	void Controller::addObserver(StateObserver *o) {
+		observers.push_back(o);
+		o->setConnected(port, _connected);
+	}
+	void Controller::mailTo(PadMailbox *m) {
+		mailbox.store(m, std::memory_order_release);
+	}
+	void Controller::captureTo(CaptureChannel *c) {
+		capture = c;
+	}
+	void Controller::timeTo(StageHistograms *t) {
+		timing = t;
+	}
+	void Controller::timeExchange(clock::time_point start, clock::time_point written) {
+		readDone = clock::now();
+		timing->record(PollStage::HidWrite, nanosBetween(start, written));
+		timing->record(PollStage::HidRead, nanosBetween(written, readDone));
+	}
+	uint64_t Controller::captureTime() const {
+		return capture->now();
+	}
+	void Controller::recordExchange(uint64_t sent, const uchar *command, size_t commandSize, const uchar *reply, int replySize) {
+		capture->record(CaptureKind::Command, sent, command, commandSize);
+		const bool input = commandSize > 8 && command[0] == 0x80 && command[8] == getInput;
+		const size_t size = replySize > 0 ? static_cast<size_t>(replySize) : 0;
+		capture->record(input ? CaptureKind::Report : CaptureKind::Reply, capture->now(), reply, size);
+	}
+	size_t Controller::drainEvents(ButtonEvent *out, size_t max) {
+		return events.drain(out, max);
+	}
+	size_t Controller::droppedEvents() const {
+		return events.droppedCount();
+	}
+	// Turns the difference between consecutive button masks into events
+	void Controller::updateButtons(uint32_t buttons, uint32_t time) {
+		const uint32_t changed = buttons ^ lastButtons;
+		lastButtons = buttons;
+		for (uint32_t c = changed; c != 0; c &= c - 1) {
+			const int bit = lowestSetBit(c);
+			const Button b = buttonAt(static_cast<ButtonSource>(bit / 8), bit % 8);
+			if (b == Button::None) continue;
+			const ButtonEvent e{ time, b, (buttons & (1u << bit)) != 0 };
+			events.push(e);
+			const ComboAction action = combos.feed(e, buttons);
+			if (action != ComboAction::None) {
+				runCombo(action);
+			}
+		}
+		checkProfileChord(buttons, changed & buttons);
+	}
+	// Share + DPad Up/Right/Down/Left selects profile 0/1/2/3
+	void Controller::checkProfileChord(uint32_t buttons, uint32_t pressed) {
+		if ((buttons & shareButton) == 0 || (pressed & profileChordButtons) == 0) return;
+		for (size_t i = 0; i < profileChord.size() && i < profiles.size(); ++i) {
+			if ((pressed & profileChord[i]) != 0) {
+				setProfile(profiles[i]);
+#ifdef _DEBUG
+				std::cout << "Controller " << static_cast<int>(port) << " switched to profile " << profiles[i].name << '\n';
+#endif
+				return;
+			}
+		}
+	}
+	void Controller::runCombo(ComboAction action) {
+		switch (action) {
+		case ComboAction::Recenter:
+			setCalibrationCenter(padStatus.leftStick, padStatus.rightStick);
+			break;
+		case ComboAction::Disconnect:
+			// After this report is sent, so the virtual pad doesn't keep a stale state
+			disconnectRequested = true;
+			break;
+		case ComboAction::NextProfile:
+		case ComboAction::PreviousProfile: {
+			const size_t current = profiles.indexOf(getProfile());
+			const size_t step = action == ComboAction::NextProfile ? 1 : profiles.size() - 1;
+			setProfile(profiles[(current + step) % profiles.size()]);
+			break;
+		}
+		default:
+			return;
+		}
+#ifdef _DEBUG
+		std::cout << "Controller " << static_cast<int>(port) << " ran combo " << static_cast<int>(action) << '\n';
+#endif
+	}
 	void Controller::updateStatus() {
 		if (clock::now() < lastStatus + std::chrono::milliseconds(100)) {
 			return;
 		}
-		uchar vibrate{ 0 };
-		uchar led{ 0 };
-		uchar smallMotor{ 0 };
-		uchar bigMotor{ 0 };
-		XOutputGetState(port, &vibrate, &bigMotor, &smallMotor, &led);
-		if (vibrate != 0) {
-			sendRumble(bigMotor, 0);
-			sendRumble(0, smallMotor);
+		PadFeedback fb{};
+		if (!sink.feedback(port, fb)) {
+			lastStatus = clock::now();
+			return;
+		}
+		if (fb.vibrate) {
+			sendRumble(fb.largeMotor, 0);
+			sendRumble(0, fb.smallMotor);
 		}
-		array<uchar, 1> ledData{ static_cast<uchar>(0x1 << led) };
+		array<uchar, 1> ledData{ static_cast<uchar>(0x1 << fb.led) };
 		sendSubcommand(0x1, ledCommand, ledData);
 		lastStatus = clock::now();
 	}
@@ -1,84 +1,173 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <stdexcept>
 #include <chrono>
+#include <cstring>
 #include <thread>
+#include <vector>
 
-#ifndef NOMINMAX
-#define NOMINMAX
-#endif
-#include <Windows.h>
-#include <Xinput.h>
-
+#include "AdaptiveWait.hpp"
+#include "ButtonEvents.hpp"
+#include "ButtonMap.hpp"
+#include "Combos.hpp"
 #include "Common.hpp"
-#include "hidapi.h"
+#include "HidTransport.hpp"
+#include "IdleMode.hpp"
+#include "InputDecode.hpp"
+#include "Macros.hpp"
+#include "Mailbox.hpp"
+#include "OutputSink.hpp"
+#include "PhaseLock.hpp"
+#include "Profile.hpp"
+#include "ReportStats.hpp"
+#include "StateObserver.hpp"
+#include "StickFilter.hpp"
+#include "Trace.hpp"
+#include "TimerWheel.hpp"
+#include "XInputGamepad.hpp"
 
 namespace Procon {
 
+	class CaptureChannel;
+	struct StageHistograms;
+
 	constexpr size_t exchangeLen{ 0x400 };
-	struct AxisRange {
-		uchar min;
-		uchar max;
-	};
-	struct StickRange {
-		AxisRange x;
-		AxisRange y;
-	};
-	struct StickPoint {
-		uchar x;
-		uchar y;
-	};
-	struct CalibrationData {
-		StickRange left;
-		StickRange right;
-		StickPoint leftCenter;
-		StickPoint rightCenter;
-	};
-	void SetDefaultCalibration(CalibrationData &dat);
-	struct HIDCloser {
-		void operator()(hid_device *ptr);
-	};
-	struct ExpandedPadState {
-		XINPUT_GAMEPAD xinState;
-		StickPoint leftStick;
-		StickPoint rightStick;
-		bool sharePressed;
+
+	// Poll asks for every report with getInput and waits for the reply.
+	// Stream has the controller send a report every sample and reads them
+	// as they come.
+	enum class ReportMode : uchar { Poll, Stream };
+	// Block sleeps in a read until a packet comes. Spin checks for one
+	// over and over: no wake-up delay, but a core kept busy. Adaptive
+	// sleeps until shortly before the packet is due and spins from there,
+	// see AdaptiveWait.
+	enum class ReadWait : uchar { Block, Spin, Adaptive };
+	// bStreamReports, sReadWait, bPhaseLock, iIdleAfterMs and iIdlePollMs in
+	// config.txt
+	struct ReadSettings {
+		ReportMode mode{ ReportMode::Poll };
+		ReadWait wait{ ReadWait::Block };
+		bool phaseLock{ false }; // Time polls to the controller's samples, see PhaseLock
+		uint32_t idleAfterMs{ 0 }; // Quiet time before going idle, 0 never does, see IdleMode
+		uint32_t idlePollMs{ 20 }; // Poll period while idle
+		// Throws Procon::ConfigError for an unknown sReadWait
+		static ReadSettings fromConfig();
 	};
-	void zeroPadState(ExpandedPadState &state);
 	// Switch Procon class.
-	// Create, then call openDevice(hid_device_info) to initialize.
-	// Call pollInput() to send input to ViGEm, such as in a main loop.
+	// Create, then call openDevice with a transport to the device to initialize.
+	// Call pollInput() to send input to the OutputSink, such as in a main loop.
 	// Cleanup is automatic when the object is destroyed.
+	// Not movable, the timer wheel holds pointers into it.
 	// Throws Procon::Controller exceptions from openDevice.
 	class Controller {
-		bool _connected;
-		std::unique_ptr<hid_device, HIDCloser> device;
+		bool _connected{ false };
+		std::unique_ptr<HidTransport> device;
 		uchar rumbleCounter{ 0 };
 		using clock = std::chrono::steady_clock;
 		clock::time_point lastStatus{ clock::now() };
 		uchar port{ 0 };
 		ExpandedPadState padStatus{};
 		CalibrationData calib;
+		StickFilter stickFilter;
+		MacroPlayer macros;
+		const ProfileSet &profiles;
+		std::atomic<const Profile*> profile;
+		uint32_t lastButtons{ 0 };
+		EventRing<ButtonEvent, 64> events;
+		ComboRecognizer combos;
+		bool disconnectRequested{ false };
+		OutputSink &sink;
+		std::vector<StateObserver*> observers;
+		std::atomic<PadMailbox*> mailbox{ nullptr }; // Set from any thread
+		uint64_t frames{ 0 };
+		CaptureChannel *capture{ nullptr };
+		StageHistograms *timing{ nullptr };
+		clock::time_point readDone{}; // End of the last timed exchange
+		ReportStats rates;
+		ReadSettings reading;
+		AdaptiveWait waiter;
+		PhaseLock phase;
+		IdleMode idleMode;
 	public:
-		Controller(uchar port);
-		Controller(Controller &&);
+		// Turbo and macro timers run on 'wheel'. 'wheel', 'profiles', 'combos'
+		// and 'sink' must outlive the Controller. Starts on the default profile.
+		Controller(uchar port, TimerWheel &wheel, const ProfileSet &profiles, const ComboAutomaton &combos, OutputSink &sink);
 		Controller(const Controller&) = delete;
 		Controller& operator=(const Controller&) = delete;
-		Controller& operator=(Controller &&);
 		~Controller();
 
-		void openDevice(hid_device_info *dev);
+		// Call before openDevice, the handshake starts streaming
+		void setReadSettings(const ReadSettings &s);
+		// Takes over 'transport' and does the handshake over it.
+		void openDevice(std::unique_ptr<HidTransport> transport);
+		// Does nothing once disconnected, or before the next poll is due.
+		// Throws Procon::ControllerException on read errors and
+		// Procon::OutputError from the sink.
 		void pollInput();
+		// When the next poll is due: 'now', unless a phase locked controller
+		// waits for its next sample or an idle one for its next idle poll.
+		// Never once disconnected.
+		clock::time_point nextPoll(clock::time_point now) const;
+		bool pollDue(clock::time_point now) const;
+		// Unplugs the virtual pad and tells the controller to disconnect.
+		void disconnect();
 
 		bool connected() const;
+		// Gone idle after iIdleAfterMs without a change. From the polling
+		// thread.
+		bool idle() const;
 		uchar getPort() const;
 		const ExpandedPadState& getState() const;
 		void setCalibrationCenter(const StickPoint &left, const StickPoint &right);
+		// Takes effect from the next report. Safe to call from any thread,
+		// 'p' must belong to the controller's ProfileSet.
+		void setProfile(const Profile &p);
+		const Profile& getProfile() const;
+		// Button presses and releases since the last drain, oldest first.
+		// Copies up to 'max' events and returns the count. Single consumer,
+		// events are dropped (see droppedEvents) if nobody drains them.
+		size_t drainEvents(ButtonEvent *out, size_t max);
+		size_t droppedEvents() const;
+		// Report rate, jitter and lost samples over the last second.
+		// Safe to call from any thread.
+		ReportStats::Summary reportStats() const;
+		// How adaptive reads went (sReadWait = adaptive). From the polling
+		// thread, or once it has stopped.
+		AdaptiveWait::Stats waitStats() const;
+		// How phase locked polling went (bPhaseLock). From the polling
+		// thread, or once it has stopped.
+		PhaseLock::Stats phaseStats() const;
+		// Whether and how often the controller went idle (iIdleAfterMs). From
+		// the polling thread, or once it has stopped.
+		IdleMode::Stats idleStats() const;
+		// Hands every report to 'o' from now on. 'o' must outlive the Controller.
+		void addObserver(StateObserver *o);
+		// Publishes every decoded state to 'm' from now on, for a consumer on
+		// another thread that only wants the newest. nullptr stops. Can be
+		// called from any thread while polling goes on. 'm' must outlive the
+		// Controller.
+		void mailTo(PadMailbox *m);
+		// Records every write and read to 'c' from now on, call before
+		// openDevice to include the handshake. 'c' must outlive the Controller.
+		void captureTo(CaptureChannel *c);
+		// Times every write, read, decode and output into 't' from now on.
+		// 't' must outlive the Controller.
+		void timeTo(StageHistograms *t);
 	private:
 
 		void updateStatus();
+		void updateButtons(uint32_t buttons, uint32_t time);
+		void checkProfileChord(uint32_t buttons, uint32_t pressed);
+		void runCombo(ComboAction action);
+		uint64_t captureTime() const;
+		void recordExchange(uint64_t sent, const uchar *command, size_t commandSize, const uchar *reply, int replySize);
+		void timeExchange(clock::time_point start, clock::time_point written);
+		int receive(uchar *data, size_t size);
+		bool readPolled(InputPacket &p);
+		bool readStreamed(InputPacket &p);
 		
 		using exchangeArray = std::optional<std::array<uchar, exchangeLen>>;
 
@@ -86,12 +175,28 @@ namespace Procon {
 		exchangeArray exchange(std::array<uchar, len> const &data) {
 			if (!device) return {};
 
-			if (hid_write(device.get(), data.data(), len) < 0) {
-				return {};
+			const uint64_t sent = capture != nullptr ? captureTime() : 0;
+			const clock::time_point start = timing != nullptr ? clock::now() : clock::time_point{};
+			{
+				TraceScope trace{ "hid_write", port };
+				if (device->write(data.data(), len) < 0) {
+					return {};
+				}
 			}
+			const clock::time_point written = timing != nullptr ? clock::now() : clock::time_point{};
 			std::array<uchar, exchangeLen> ret;
 			ret.fill(0);
-			hid_read(device.get(), ret.data(), exchangeLen);
+			int read;
+			{
+				TraceScope trace{ "hid_read", port };
+				read = receive(ret.data(), exchangeLen);
+			}
+			if (timing != nullptr) {
+				timeExchange(start, written);
+			}
+			if (capture != nullptr) {
+				recordExchange(sent, data.data(), len, ret.data(), read);
+			}
 			return ret;
 		}
 
@@ -112,6 +217,7 @@ namespace Procon {
 
 		template<size_t len>
 		exchangeArray sendSubcommand(uchar command, uchar subcommand, std::array<uchar, len> const& data) {
+			TraceScope trace{ "subcommand", port, subcommand };
 			std::array<uchar, 10 + len> buf
 			{ 
 				static_cast<uchar>(rumbleCounter++ & 0xF),
@@ -0,0 +1,41 @@
+#include "DeltaClient.hpp"
+
+#include <cstring>
+
+namespace {
+	constexpr size_t readSize{ 16 * 1024 };
+};
+
+namespace Procon {
+
+	DeltaClient::DeltaClient(const std::string &path) :socket(LocalSocket::connect(path)), buffer(readSize) {
+	}
+
+	const PublishedState& DeltaClient::state(uchar port) const {
+		return decoder.state(port);
+	}
+
+	bool DeltaClient::isConnected(uchar port) const {
+		return decoder.isConnected(port);
+	}
+
+	// Reads whatever has arrived, waiting up to 'timeoutMs' for the first byte
+	bool DeltaClient::fill(int timeoutMs) {
+		LocalSocket::PollEntry entry{ &socket, true, false, false, false };
+		if (LocalSocket::poll(&entry, 1, timeoutMs) == 0) return true;
+		if (buffer.size() - used < readSize) {
+			buffer.resize(used + readSize);
+		}
+		const ptrdiff_t n = socket.receive(buffer.data() + used, buffer.size() - used);
+		if (n < 0) return false;
+		used += static_cast<size_t>(n);
+		return true;
+	}
+
+	void DeltaClient::compact(size_t consumed) {
+		if (consumed == 0) return;
+		std::memmove(buffer.data(), buffer.data() + consumed, used - consumed);
+		used -= consumed;
+	}
+
+};
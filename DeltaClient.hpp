@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DeltaCodec.hpp"
+#include "LocalSocket.hpp"
+
+namespace Procon {
+
+	// Subscriber library for the delta stream, for tools running in other
+	// processes. Keeps the latest state of every port.
+	// Throws Procon::SocketError from the constructor and
+	// Procon::DeltaStreamError from receive().
+	class DeltaClient {
+		LocalSocket socket;
+		DeltaDecoder decoder;
+		std::vector<uint8_t> buffer;
+		size_t used{ 0 };
+	public:
+		explicit DeltaClient(const std::string &path);
+
+		// Waits up to 'timeoutMs' (-1 forever) for data and decodes all of it,
+		// calling onMessage(const DeltaDecoder::Message&) for each message.
+		// Returns false once the server has gone.
+		template<class F>
+		bool receive(int timeoutMs, F &&onMessage) {
+			if (!fill(timeoutMs)) return false;
+			size_t pos = 0;
+			for (;;) {
+				DeltaDecoder::Message m;
+				const bool wasHeader = !decoder.headerSeen();
+				const size_t n = decoder.decode(buffer.data() + pos, used - pos, m);
+				if (n == 0) break;
+				pos += n;
+				if (!wasHeader) onMessage(m);
+			}
+			compact(pos);
+			return true;
+		}
+
+		const PublishedState& state(uchar port) const;
+		bool isConnected(uchar port) const;
+	private:
+		bool fill(int timeoutMs);
+		void compact(size_t consumed);
+	};
+
+};
@@ -0,0 +1,215 @@
+#include "DeltaCodec.hpp"
+
+namespace {
+	using namespace Procon;
+
+	const PublishedState zeroState{};
+
+	uint8_t* putVarint(uint8_t *out, uint64_t v) {
+		while (v >= 0x80) {
+			*out++ = static_cast<uint8_t>(v | 0x80);
+			v >>= 7;
+		}
+		*out++ = static_cast<uint8_t>(v);
+		return out;
+	}
+
+	uint64_t zigzag(int64_t v) {
+		return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+	}
+	int64_t unzigzag(uint64_t v) {
+		return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+	}
+
+	// Reads a varint, returns false if the data ends first
+	bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &v) {
+		v = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (p == end) return false;
+			const uint8_t b = *p++;
+			v |= static_cast<uint64_t>(b & 0x7f) << shift;
+			if ((b & 0x80) == 0) return true;
+		}
+		throw DeltaStreamError("Varint is too long");
+	}
+
+	// Signed fields, in mask bit order starting at ThumbLXField
+	struct SignedFields {
+		int32_t v[14];
+	};
+	SignedFields signedFields(const PublishedState &s) {
+		return { {
+			s.xinState.sThumbLX, s.xinState.sThumbLY, s.xinState.sThumbRX, s.xinState.sThumbRY,
+			s.leftStick.x, s.leftStick.y, s.rightStick.x, s.rightStick.y,
+			s.accel[0], s.accel[1], s.accel[2], s.gyro[0], s.gyro[1], s.gyro[2]
+		} };
+	}
+	void setSignedFields(PublishedState &s, const SignedFields &f) {
+		s.xinState.sThumbLX = static_cast<int16_t>(f.v[0]);
+		s.xinState.sThumbLY = static_cast<int16_t>(f.v[1]);
+		s.xinState.sThumbRX = static_cast<int16_t>(f.v[2]);
+		s.xinState.sThumbRY = static_cast<int16_t>(f.v[3]);
+		s.leftStick.x = static_cast<uchar>(f.v[4]);
+		s.leftStick.y = static_cast<uchar>(f.v[5]);
+		s.rightStick.x = static_cast<uchar>(f.v[6]);
+		s.rightStick.y = static_cast<uchar>(f.v[7]);
+		for (int i = 0; i < 3; ++i) {
+			s.accel[i] = static_cast<int16_t>(f.v[8 + i]);
+			s.gyro[i] = static_cast<int16_t>(f.v[11 + i]);
+		}
+	}
+	constexpr int firstSignedBit{ 6 };
+
+}; // namespace
+
+namespace Procon {
+
+	DeltaStreamError::DeltaStreamError(const std::string &what) : std::runtime_error(what) {}
+	DeltaStreamError::DeltaStreamError(const char *what) : std::runtime_error(what) {}
+
+	size_t encodeDeltaHeader(uint8_t *out) {
+		for (int i = 0; i < 4; ++i) {
+			out[i] = static_cast<uint8_t>(deltaStreamMagic >> (8 * i));
+		}
+		return putVarint(out + 4, deltaStreamVersion) - out;
+	}
+
+	size_t encodeDelta(uchar port, const PublishedState &base, const PublishedState &state, uint8_t *out) {
+		uint32_t mask = 0;
+		if (state.frame != base.frame + 1) mask |= FrameField;
+		if (state.time != base.time) mask |= TimeField;
+		if (state.buttons != base.buttons) mask |= ButtonsField;
+		if (state.xinState.wButtons != base.xinState.wButtons) mask |= WButtonsField;
+		if (state.xinState.bLeftTrigger != base.xinState.bLeftTrigger) mask |= LeftTriggerField;
+		if (state.xinState.bRightTrigger != base.xinState.bRightTrigger) mask |= RightTriggerField;
+		const SignedFields from = signedFields(base);
+		const SignedFields to = signedFields(state);
+		for (int i = 0; i < 14; ++i) {
+			if (to.v[i] != from.v[i]) mask |= 1u << (firstSignedBit + i);
+		}
+		if (state.timer != base.timer) mask |= TimerField;
+		if (state.profile != base.profile) mask |= ProfileField;
+
+		uint8_t *p = putVarint(out, port);
+		p = putVarint(p, mask);
+		if (mask & FrameField) p = putVarint(p, zigzag(static_cast<int64_t>(state.frame - base.frame)));
+		if (mask & TimeField) p = putVarint(p, static_cast<uint32_t>(state.time - base.time));
+		if (mask & ButtonsField) p = putVarint(p, state.buttons);
+		if (mask & WButtonsField) p = putVarint(p, state.xinState.wButtons);
+		if (mask & LeftTriggerField) p = putVarint(p, state.xinState.bLeftTrigger);
+		if (mask & RightTriggerField) p = putVarint(p, state.xinState.bRightTrigger);
+		for (int i = 0; i < 14; ++i) {
+			if (mask & (1u << (firstSignedBit + i))) p = putVarint(p, zigzag(to.v[i] - from.v[i]));
+		}
+		if (mask & TimerField) p = putVarint(p, state.timer);
+		if (mask & ProfileField) p = putVarint(p, state.profile);
+		return p - out;
+	}
+
+	size_t encodeDisconnect(uchar port, uint8_t *out) {
+		return putVarint(putVarint(out, port), DisconnectedField) - out;
+	}
+
+	size_t DeltaDecoder::decode(const uint8_t *data, size_t size, Message &out) {
+		const uint8_t *p = data;
+		const uint8_t *end = data + size;
+		uint64_t v;
+		if (!headerDone) {
+			if (size < 4) return 0;
+			uint32_t magic = 0;
+			for (int i = 0; i < 4; ++i) {
+				magic |= static_cast<uint32_t>(data[i]) << (8 * i);
+			}
+			if (magic != deltaStreamMagic) {
+				throw DeltaStreamError("Not a delta stream");
+			}
+			p += 4;
+			if (!getVarint(p, end, v)) return 0;
+			if (v != deltaStreamVersion) {
+				throw DeltaStreamError("Delta stream version " + std::to_string(v) + " isn't supported");
+			}
+			headerDone = true;
+			return p - data;
+		}
+
+		uint64_t port;
+		uint64_t mask;
+		if (!getVarint(p, end, port) || !getVarint(p, end, mask)) return 0;
+		if (port > 0xff) {
+			throw DeltaStreamError("Bad port in delta stream");
+		}
+		if (mask == DisconnectedField) {
+			if (port < states.size()) {
+				states[port] = zeroState;
+				connected[port] = false;
+			}
+			out = { static_cast<uchar>(port), true };
+			return p - data;
+		}
+		if ((mask & ~((DisconnectedField << 1) - 1)) != 0 || (mask & DisconnectedField) != 0) {
+			throw DeltaStreamError("Bad field mask in delta stream");
+		}
+
+		PublishedState s = port < states.size() ? states[port] : zeroState;
+		SignedFields f = signedFields(s);
+		auto field = [&](uint32_t bit, uint64_t &value) {
+			return (mask & bit) == 0 || getVarint(p, end, value);
+		};
+		uint64_t frameDelta = 1;
+		uint64_t time = 0;
+		if (mask & FrameField) {
+			if (!field(FrameField, v)) return 0;
+			frameDelta = static_cast<uint64_t>(unzigzag(v));
+		}
+		if (!field(TimeField, time)) return 0;
+		s.frame += frameDelta;
+		s.time += static_cast<uint32_t>(time);
+		v = s.buttons;
+		if (!field(ButtonsField, v)) return 0;
+		s.buttons = static_cast<uint32_t>(v);
+		v = s.xinState.wButtons;
+		if (!field(WButtonsField, v)) return 0;
+		s.xinState.wButtons = static_cast<uint16_t>(v);
+		v = s.xinState.bLeftTrigger;
+		if (!field(LeftTriggerField, v)) return 0;
+		s.xinState.bLeftTrigger = static_cast<uint8_t>(v);
+		v = s.xinState.bRightTrigger;
+		if (!field(RightTriggerField, v)) return 0;
+		s.xinState.bRightTrigger = static_cast<uint8_t>(v);
+		for (int i = 0; i < 14; ++i) {
+			const uint32_t bit = 1u << (firstSignedBit + i);
+			if ((mask & bit) == 0) continue;
+			if (!field(bit, v)) return 0;
+			f.v[i] += static_cast<int32_t>(unzigzag(v));
+		}
+		setSignedFields(s, f);
+		v = s.timer;
+		if (!field(TimerField, v)) return 0;
+		s.timer = static_cast<uchar>(v);
+		v = s.profile;
+		if (!field(ProfileField, v)) return 0;
+		s.profile = static_cast<uchar>(v);
+
+		if (port >= states.size()) {
+			states.resize(port + 1, zeroState);
+			connected.resize(port + 1, false);
+		}
+		states[port] = s;
+		connected[port] = true;
+		out = { static_cast<uchar>(port), false };
+		return p - data;
+	}
+
+	bool DeltaDecoder::headerSeen() const {
+		return headerDone;
+	}
+
+	const PublishedState& DeltaDecoder::state(uchar port) const {
+		return port < states.size() ? states[port] : zeroState;
+	}
+
+	bool DeltaDecoder::isConnected(uchar port) const {
+		return port < connected.size() && connected[port];
+	}
+
+};
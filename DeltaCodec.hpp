@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Common.hpp"
+#include "SharedState.hpp"
+
+namespace Procon {
+
+	// Wire format of the delta stream (see DeltaServer and DeltaClient).
+	// The server starts with deltaStreamMagic as 4 little endian bytes and a
+	// varint version, then sends messages:
+	//   varint port, varint field mask, one varint per field set in the mask.
+	// Each message turns the previous state the subscriber got for that port
+	// (all zero at first and after a disconnect) into the new one. The frame
+	// is only sent when it isn't the previous frame + 1, the time as the
+	// difference from the previous one, signed fields as zigzag differences
+	// and the rest as plain values.
+	constexpr uint32_t deltaStreamMagic{ 0x53445850 }; // "PXDS"
+	constexpr uint32_t deltaStreamVersion{ 1 };
+
+	enum DeltaField : uint32_t {
+		FrameField = 1u << 0,
+		TimeField = 1u << 1,
+		ButtonsField = 1u << 2,
+		WButtonsField = 1u << 3,
+		LeftTriggerField = 1u << 4,
+		RightTriggerField = 1u << 5,
+		ThumbLXField = 1u << 6,
+		ThumbLYField = 1u << 7,
+		ThumbRXField = 1u << 8,
+		ThumbRYField = 1u << 9,
+		LeftStickXField = 1u << 10,
+		LeftStickYField = 1u << 11,
+		RightStickXField = 1u << 12,
+		RightStickYField = 1u << 13,
+		AccelField = 1u << 14, // Three bits, x y z
+		GyroField = 1u << 17,  // Three bits, x y z
+		TimerField = 1u << 20,
+		ProfileField = 1u << 21,
+		DisconnectedField = 1u << 22, // No other fields, resets the port to zero
+	};
+
+	constexpr size_t maxDeltaMessageSize{ 96 };
+
+	class DeltaStreamError : public std::runtime_error {
+	public:
+		explicit DeltaStreamError(const std::string &what);
+		explicit DeltaStreamError(const char *what);
+	};
+
+	// Writes the stream header to 'out', returns its size (at most 8).
+	size_t encodeDeltaHeader(uint8_t *out);
+	// Writes a message turning 'base' into 'state' for 'port' to 'out',
+	// which must have maxDeltaMessageSize bytes. Returns the size.
+	size_t encodeDelta(uchar port, const PublishedState &base, const PublishedState &state, uint8_t *out);
+	size_t encodeDisconnect(uchar port, uint8_t *out);
+
+	// Subscriber side, rebuilds each port's state from the messages.
+	class DeltaDecoder {
+		std::vector<PublishedState> states;
+		std::vector<bool> connected;
+		bool headerDone{ false };
+	public:
+		struct Message {
+			uchar port;
+			bool disconnected;
+		};
+		// Decodes the header or one message from the start of 'data'. Returns
+		// the bytes used, 0 if 'data' doesn't hold a whole one yet. 'out' is
+		// only set for messages, check headerSeen() for the header.
+		// Throws Procon::DeltaStreamError on a bad stream.
+		size_t decode(const uint8_t *data, size_t size, Message &out);
+
+		bool headerSeen() const;
+		// All zero for ports that never sent anything
+		const PublishedState& state(uchar port) const;
+		bool isConnected(uchar port) const;
+	};
+
+};
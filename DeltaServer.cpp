@@ -0,0 +1,235 @@
+#include "DeltaServer.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace {
+	constexpr int pollIntervalMs{ 1 }; // Longest a new state waits for the server thread
+	constexpr size_t encodeBatch{ 128 }; // Messages encoded per send
+}; // namespace
+
+namespace Procon {
+
+	struct DeltaServer::Subscriber {
+		struct Queued {
+			uchar port;
+			Item item;
+		};
+
+		LocalSocket socket;
+		std::vector<PublishedState> sent; // Last state sent by port, what the next delta is from
+		std::vector<Queued> queue; // Circular
+		std::vector<bool> behind; // By port, states were dropped since the last resend
+		size_t head{ 0 };
+		size_t count{ 0 };
+		std::vector<uint8_t> out;
+		size_t outPos{ 0 };
+		bool closed{ false };
+
+		Subscriber(LocalSocket &&s, size_t capacity)
+			:socket(std::move(s)), sent(sharedStatePorts, PublishedState{}), queue(capacity), behind(sharedStatePorts, false) {
+			out.resize(8);
+			out.resize(encodeDeltaHeader(out.data()));
+		}
+
+		// Returns true if the oldest state had to be dropped
+		bool enqueue(uchar port, const Item &item) {
+			bool dropped = false;
+			if (count == queue.size()) {
+				behind[queue[head].port] = true;
+				head = (head + 1) % queue.size();
+				--count;
+				dropped = true;
+			}
+			queue[(head + count) % queue.size()] = { port, item };
+			++count;
+			return dropped;
+		}
+
+		// Queues the current state of ports that lost states, returns false
+		// if there were none
+		bool resend(const std::vector<Item> &current) {
+			bool any = false;
+			for (size_t port = 0; port < behind.size(); ++port) {
+				if (!behind[port]) continue;
+				behind[port] = false;
+				enqueue(static_cast<uchar>(port), current[port]);
+				any = true;
+			}
+			return any;
+		}
+
+		bool pending() const {
+			return outPos < out.size() || count > 0;
+		}
+	};
+
+	DeltaServer::DeltaServer(const std::string &path, size_t queueCapacity)
+		:listener(LocalSocket::listen(path)), path(path), queueCapacity(std::max<size_t>(queueCapacity, 1)), current(sharedStatePorts, Item{ PublishedState{}, 0, false }) {
+		for (size_t i = 0; i < sharedStatePorts; ++i) {
+			inputs.push_back(std::make_unique<Input>());
+		}
+		thread = std::thread([this] { run(); });
+	}
+
+	DeltaServer::~DeltaServer() {
+		stopping = true;
+		thread.join();
+		listener = LocalSocket();
+		removeLocalSocketPath(path);
+	}
+
+	void DeltaServer::publish(uchar port, const PublishedState &state) {
+		if (port >= sharedStatePorts) return;
+		Input &in = *inputs[port];
+		const Item item{ state, ++in.generation, true };
+		in.ring.push(item);
+		in.latest.publish(item);
+		published.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void DeltaServer::setConnected(uchar port, bool connected) {
+		if (port >= sharedStatePorts || connected) return; // Connection shows up with the first state
+		Input &in = *inputs[port];
+		in.disconnectMark.store(in.generation + 1, std::memory_order_release);
+	}
+
+	DeltaServer::Stats DeltaServer::stats() const {
+		Stats s;
+		s.published = published.load(std::memory_order_relaxed);
+		s.inputDropped = 0;
+		for (const auto &in : inputs) {
+			s.inputDropped += in->ring.droppedCount();
+		}
+		s.queueDropped = queueDropped.load(std::memory_order_relaxed);
+		s.messagesSent = messagesSent.load(std::memory_order_relaxed);
+		s.bytesSent = bytesSent.load(std::memory_order_relaxed);
+		s.subscribers = subscriberCount.load(std::memory_order_relaxed);
+		return s;
+	}
+
+	void DeltaServer::run() {
+		std::vector<LocalSocket::PollEntry> entries;
+		std::array<uint8_t, 256> discard;
+		while (!stopping.load(std::memory_order_relaxed)) {
+			drainInputs();
+			for (auto &s : subscribers) {
+				if (!flush(*s)) s->closed = true;
+			}
+			subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+				[](const std::unique_ptr<Subscriber> &s) { return s->closed; }), subscribers.end());
+			subscriberCount.store(subscribers.size(), std::memory_order_relaxed);
+
+			entries.clear();
+			entries.push_back({ &listener, true, false, false, false });
+			for (auto &s : subscribers) {
+				// Reading only notices subscribers that went away, they don't send anything
+				entries.push_back({ &s->socket, true, s->pending(), false, false });
+			}
+			LocalSocket::poll(entries.data(), entries.size(), pollIntervalMs);
+			if (entries[0].readable) {
+				acceptSubscribers();
+			}
+			for (size_t i = 1; i < entries.size(); ++i) {
+				if (entries[i].readable && entries[i].socket->receive(discard.data(), discard.size()) < 0) {
+					subscribers[i - 1]->closed = true;
+				}
+			}
+		}
+	}
+
+	void DeltaServer::acceptSubscribers() {
+		for (LocalSocket s = listener.accept(); s.valid(); s = listener.accept()) {
+			s.setNonBlocking();
+			subscribers.push_back(std::make_unique<Subscriber>(std::move(s), queueCapacity));
+		}
+	}
+
+	// States older than one already queued were left in a full ring. A
+	// disconnect goes after the states before it, or nowhere if a state
+	// after it (the controller reconnected) was already queued.
+	void DeltaServer::drainInputs() {
+		std::array<Item, 64> items;
+		for (size_t port = 0; port < inputs.size(); ++port) {
+			Input &in = *inputs[port];
+			const uchar p = static_cast<uchar>(port);
+			const size_t n = in.ring.drain(items.data(), items.size());
+			// After the drain and before 'latest', which then holds at least
+			// the state before the mark
+			const uint64_t mark = in.disconnectMark.load(std::memory_order_acquire);
+			if (mark != in.handledMark) {
+				in.handledMark = mark;
+				in.pendingMark = mark;
+			}
+			for (size_t i = 0; i < n; ++i) {
+				forward(p, items[i]);
+			}
+			if (in.latest.update() && in.latest.generation() > 0) {
+				forward(p, in.latest.value());
+			}
+			if (in.pendingMark != 0) {
+				forward(p, { PublishedState{}, 0, false }); // After everything before it
+			}
+		}
+	}
+
+	void DeltaServer::forward(uchar port, const Item &item) {
+		Input &in = *inputs[port];
+		if (item.connected && item.generation <= in.sent) return;
+		if (in.pendingMark != 0 && (!item.connected || item.generation >= in.pendingMark)) {
+			if (in.sent < in.pendingMark) queue(port, { PublishedState{}, 0, false });
+			in.pendingMark = 0;
+		}
+		if (!item.connected) return;
+		in.sent = item.generation;
+		queue(port, item);
+	}
+
+	void DeltaServer::queue(uchar port, const Item &item) {
+		current[port] = item;
+		uint64_t dropped = 0;
+		for (auto &s : subscribers) {
+			if (s->enqueue(port, item)) ++dropped;
+		}
+		if (dropped != 0) {
+			queueDropped.fetch_add(dropped, std::memory_order_relaxed);
+		}
+	}
+
+	// Sends as much as the socket takes without blocking. Returns false if
+	// the subscriber is gone.
+	bool DeltaServer::flush(Subscriber &s) {
+		for (;;) {
+			if (s.outPos < s.out.size()) {
+				const ptrdiff_t n = s.socket.send(s.out.data() + s.outPos, s.out.size() - s.outPos);
+				if (n < 0) return false;
+				if (n == 0) return true;
+				s.outPos += static_cast<size_t>(n);
+				bytesSent.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+				continue;
+			}
+			if (s.count == 0 && !s.resend(current)) return true;
+			const size_t batch = std::min(s.count, encodeBatch);
+			s.out.resize(batch * maxDeltaMessageSize);
+			size_t used = 0;
+			for (size_t i = 0; i < batch; ++i) {
+				const Subscriber::Queued &q = s.queue[s.head];
+				s.head = (s.head + 1) % s.queue.size();
+				PublishedState &base = s.sent[q.port];
+				if (q.item.connected) {
+					used += encodeDelta(q.port, base, q.item.state, s.out.data() + used);
+					base = q.item.state;
+				}
+				else {
+					used += encodeDisconnect(q.port, s.out.data() + used);
+					base = PublishedState{};
+				}
+			}
+			s.count -= batch;
+			s.out.resize(used);
+			s.outPos = 0;
+			messagesSent.fetch_add(batch, std::memory_order_relaxed);
+		}
+	}
+
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ButtonEvents.hpp"
+#include "DeltaCodec.hpp"
+#include "LocalSocket.hpp"
+#include "Mailbox.hpp"
+#include "StateObserver.hpp"
+
+namespace Procon {
+
+	// Streams state changes to any number of local subscribers over a Unix
+	// domain socket, delta encoded (see DeltaCodec.hpp). Reports go from the
+	// polling thread into a lock-free ring per port and are sent from the
+	// server's own thread, so subscribers can't slow down pollInput. If the
+	// server thread falls behind and a ring fills up, states in between are
+	// lost but never a port's newest state or its disconnect. Each
+	// subscriber has a bounded queue; when one falls behind its oldest
+	// states are dropped, its next message is a delta from the last state
+	// it actually got, and ports it lost states of get their current state
+	// again once it has caught up. Throws Procon::SocketError from the
+	// constructor.
+	class DeltaServer : public StateObserver {
+	public:
+		struct Stats {
+			uint64_t published;     // States handed to publish()
+			uint64_t inputDropped;  // Skipped because the server thread fell behind
+			uint64_t queueDropped;  // Dropped from subscriber queues, all subscribers
+			uint64_t messagesSent;  // All subscribers
+			uint64_t bytesSent;
+			size_t subscribers;
+		};
+	private:
+		struct Item {
+			PublishedState state;
+			uint64_t generation; // Counts a port's states from 1
+			bool connected;
+		};
+		// A port's states in order, and the newest one again in case the
+		// ring was full. A disconnect is a mark after the last state before
+		// it, so it can't be dropped.
+		struct Input {
+			EventRing<Item, 64> ring;
+			TripleBuffer<Item> latest;
+			alignas(64) std::atomic<uint64_t> disconnectMark{ 0 }; // Generation of the state before the disconnect + 1, 0 for none
+			uint64_t generation{ 0 };   // Polling thread only
+			// Server thread only
+			alignas(64) uint64_t sent{ 0 };  // Newest generation queued to subscribers
+			uint64_t handledMark{ 0 };       // disconnectMark last seen
+			uint64_t pendingMark{ 0 };       // A disconnect not queued yet, 0 for none
+		};
+		struct Subscriber;
+
+		LocalSocket listener;
+		std::string path;
+		size_t queueCapacity;
+		std::vector<std::unique_ptr<Input>> inputs; // By port
+		std::vector<Item> current; // Last queued by port, server thread only
+		std::vector<std::unique_ptr<Subscriber>> subscribers; // Server thread only
+		std::atomic<bool> stopping{ false };
+		std::atomic<uint64_t> published{ 0 };
+		std::atomic<uint64_t> queueDropped{ 0 };
+		std::atomic<uint64_t> messagesSent{ 0 };
+		std::atomic<uint64_t> bytesSent{ 0 };
+		std::atomic<size_t> subscriberCount{ 0 };
+		std::thread thread;
+
+		void run();
+		void acceptSubscribers();
+		void drainInputs();
+		// Queues a port's state or disconnect to every subscriber, in order
+		// and once
+		void forward(uchar port, const Item &item);
+		void queue(uchar port, const Item &item);
+		bool flush(Subscriber &s);
+	public:
+		// 'queueCapacity' is the most states queued per subscriber
+		DeltaServer(const std::string &path, size_t queueCapacity = 256);
+		~DeltaServer() override;
+		DeltaServer(const DeltaServer&) = delete;
+		DeltaServer& operator=(const DeltaServer&) = delete;
+
+		// Ports past sharedStatePorts are ignored
+		void publish(uchar port, const PublishedState &state) override;
+		void setConnected(uchar port, bool connected) override;
+
+		Stats stats() const;
+	};
+
+};
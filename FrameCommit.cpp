@@ -0,0 +1,82 @@
+#include "FrameCommit.hpp"
+
+#include <cstring>
+
+#include "Trace.hpp"
+
+namespace Procon {
+
+	FrameCommit::FrameCommit(OutputSink &sink) :sink(sink) {
+		stagedSlot.fill(-1);
+		staged.reserve(8);
+	}
+
+	void FrameCommit::plugIn(uchar port) {
+		sink.plugIn(port);
+		hasSent[port] = false;
+	}
+
+	void FrameCommit::unplug(uchar port) {
+		const int16_t slot = stagedSlot[port];
+		if (slot >= 0) {
+			staged.erase(staged.begin() + slot);
+			stagedSlot[port] = -1;
+			for (size_t i = slot; i < staged.size(); ++i) {
+				stagedSlot[staged[i].port] = static_cast<int16_t>(i);
+			}
+		}
+		sink.unplug(port);
+	}
+
+	void FrameCommit::submit(const PadUpdate *updates, size_t count) {
+		for (size_t i = 0; i < count; ++i) {
+			int16_t &slot = stagedSlot[updates[i].port];
+			if (slot >= 0) {
+				staged[slot] = updates[i];
+			}
+			else {
+				slot = static_cast<int16_t>(staged.size());
+				staged.push_back(updates[i]);
+			}
+		}
+	}
+
+	bool FrameCommit::feedback(uchar port, PadFeedback &out) {
+		return sink.feedback(port, out);
+	}
+
+	size_t FrameCommit::capacity() const {
+		return sink.capacity();
+	}
+
+	void FrameCommit::commit() {
+		++counters.frames;
+		// Compact in place, keeping only pads whose state changed
+		size_t dirty = 0;
+		for (const PadUpdate &u : staged) {
+			stagedSlot[u.port] = -1;
+			if (hasSent[u.port] && std::memcmp(&sent[u.port], &u.state, sizeof(XINPUT_GAMEPAD)) == 0) {
+				++counters.unchanged;
+				continue;
+			}
+			staged[dirty++] = u;
+		}
+		staged.resize(dirty);
+		if (dirty == 0) return;
+		TraceScope trace{ "commit", traceNoPort, static_cast<int32_t>(dirty) };
+		// Cleared even if the sink throws, the next frame has fresh states anyway
+		auto clear = make_scoped([this] { staged.clear(); });
+		sink.submit(staged.data(), staged.size());
+		++counters.batches;
+		counters.updates += staged.size();
+		for (const PadUpdate &u : staged) {
+			sent[u.port] = u.state;
+			hasSent[u.port] = true;
+		}
+	}
+
+	const FrameCommit::Stats& FrameCommit::stats() const {
+		return counters;
+	}
+
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "OutputSink.hpp"
+
+namespace Procon {
+
+	// Frame-commit stage in front of another sink. Controllers submit to it as
+	// usual, which only stages their state; commit() then hands every staged
+	// state that differs from the last one sent for its port to the inner sink
+	// in a single batch. Call commit() once per main loop pass.
+	class FrameCommit : public OutputSink {
+	public:
+		struct Stats {
+			uint64_t frames;    // commit() calls
+			uint64_t batches;   // Inner sink submit() calls
+			uint64_t updates;   // Pad states passed to the inner sink
+			uint64_t unchanged; // Staged states dropped as identical to the last sent
+		};
+	private:
+		OutputSink &sink;
+		std::vector<PadUpdate> staged;
+		std::array<int16_t, 256> stagedSlot; // Index into staged by port, -1 if none
+		std::array<XINPUT_GAMEPAD, 256> sent{};
+		std::array<bool, 256> hasSent{};
+		Stats counters{};
+	public:
+		explicit FrameCommit(OutputSink &sink);
+
+		void plugIn(uchar port) override;
+		void unplug(uchar port) override;
+		// Stages, replacing any state already staged for the same port.
+		void submit(const PadUpdate *updates, size_t count) override;
+		bool feedback(uchar port, PadFeedback &out) override;
+		size_t capacity() const override;
+
+		// Throws Procon::OutputError from the inner sink.
+		void commit();
+		const Stats& stats() const;
+	};
+
+};
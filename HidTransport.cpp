@@ -0,0 +1,47 @@
+#include "HidTransport.hpp"
+
+#include "ButtonEvents.hpp"
+#include "Controller.hpp"
+
+namespace Procon {
+
+	void HIDCloser::operator()(hid_device *ptr) {
+		if (ptr != nullptr)
+			hid_close(ptr);
+	}
+
+	HidapiTransport::HidapiTransport(hid_device_info *dev) {
+		if (dev == nullptr)
+			throw ControllerException("Unable to open controller device: dev was nullptr.");
+		if (dev->product_id != Procon_ID)
+			throw ControllerException("Unable to open controller device: product id was not a Switch Pro Controller.");
+		device.reset(hid_open_path(dev->path));
+		if (!device)
+			throw ControllerException("Unable to open controller device: device path could not be opened.");
+	}
+
+	int HidapiTransport::write(const uchar *data, size_t size) {
+		return hid_write(device.get(), data, size);
+	}
+
+	int HidapiTransport::read(uchar *data, size_t size) {
+		const int n = hid_read(device.get(), data, size);
+		lastRead = eventTime();
+		return n;
+	}
+
+	int HidapiTransport::readTimeout(uchar *data, size_t size, uint32_t timeoutUs) {
+		const int n = hid_read_timeout(device.get(), data, size, static_cast<int>(timeoutUs / 1000));
+		lastRead = eventTime();
+		return n;
+	}
+
+	uint32_t HidapiTransport::timeoutGranularityUs() const {
+		return 1000;
+	}
+
+	uint32_t HidapiTransport::readTime() const {
+		return lastRead;
+	}
+
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "Common.hpp"
+#include "hidapi.h"
+
+namespace Procon {
+
+	// Byte pipe to one controller, with hid_write/hid_read semantics. Real
+	// devices go through HidapiTransport, replays and simulated controllers
+	// implement it in memory so the Controller above them is unchanged.
+	class HidTransport {
+	public:
+		virtual ~HidTransport() = default;
+
+		// Returns the bytes written, or -1 on error.
+		virtual int write(const uchar *data, size_t size) = 0;
+		// Waits for the next packet. Returns its size, 0 if none came, or -1
+		// on error.
+		virtual int read(uchar *data, size_t size) = 0;
+		// Like read() but waits at most timeoutUs, 0 only takes a packet
+		// that's already there. Transports whose reads never wait can leave
+		// it to read().
+		virtual int readTimeout(uchar *data, size_t size, uint32_t /*timeoutUs*/) {
+			return read(data, size);
+		}
+		// readTimeout() rounds timeouts down to a multiple of this, so a
+		// shorter one doesn't wait at all
+		virtual uint32_t timeoutGranularityUs() const {
+			return 1;
+		}
+		// When the last read packet arrived, in eventTime() units
+		virtual uint32_t readTime() const = 0;
+	};
+
+	struct HIDCloser {
+		void operator()(hid_device *ptr);
+	};
+
+	// A Pro Controller opened through hidapi.
+	// Throws Procon::ControllerException from the constructor.
+	class HidapiTransport : public HidTransport {
+		std::unique_ptr<hid_device, HIDCloser> device;
+		uint32_t lastRead{ 0 };
+	public:
+		explicit HidapiTransport(hid_device_info *dev);
+
+		int write(const uchar *data, size_t size) override;
+		int read(uchar *data, size_t size) override;
+		// Rounded down to whole milliseconds, what hidapi takes, so it never
+		// waits longer than asked
+		int readTimeout(uchar *data, size_t size, uint32_t timeoutUs) override;
+		uint32_t timeoutGranularityUs() const override;
+		uint32_t readTime() const override;
+	};
+
+};
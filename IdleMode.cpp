@@ -0,0 +1,61 @@
+#include "IdleMode.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace Procon {
+
+	void IdleMode::configure(clock::duration quiet, clock::duration pollPeriod) {
+		this->quiet = quiet;
+		this->pollPeriod = pollPeriod;
+		isIdle = false;
+		hasReference = false;
+	}
+	bool IdleMode::enabled() const {
+		return quiet > clock::duration::zero();
+	}
+
+	void IdleMode::report(const XINPUT_GAMEPAD &state) {
+		if (!enabled()) return;
+		const clock::time_point now = clock::now();
+		lastReport = now;
+		if (!hasReference || differs(state, reference)) {
+			hasReference = true;
+			reference = state;
+			lastChange = now;
+			if (isIdle) {
+				isIdle = false;
+				++counters.wakes;
+			}
+		}
+		else if (!isIdle && now - lastChange >= quiet) {
+			isIdle = true;
+			++counters.sleeps;
+		}
+	}
+
+	bool IdleMode::idle() const {
+		return isIdle;
+	}
+
+	IdleMode::clock::time_point IdleMode::next(clock::time_point now) const {
+		if (!isIdle) return now;
+		return std::max(now, lastReport + pollPeriod);
+	}
+
+	IdleMode::Stats IdleMode::stats() const {
+		Stats s = counters;
+		s.idle = isIdle;
+		return s;
+	}
+
+	bool IdleMode::differs(const XINPUT_GAMEPAD &a, const XINPUT_GAMEPAD &b) {
+		const auto moved = [](int16_t x, int16_t y) {
+			return std::abs(static_cast<int32_t>(x) - static_cast<int32_t>(y)) > stickNoise;
+		};
+		return a.wButtons != b.wButtons || a.bLeftTrigger != b.bLeftTrigger || a.bRightTrigger != b.bRightTrigger
+			|| moved(a.sThumbLX, b.sThumbLX) || moved(a.sThumbLY, b.sThumbLY)
+			|| moved(a.sThumbRX, b.sThumbRX) || moved(a.sThumbRY, b.sThumbRY);
+	}
+
+};
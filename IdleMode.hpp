@@ -0,0 +1,52 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#include "XInputGamepad.hpp"
+
+namespace Procon {
+
+	// Tells when nobody is using a controller. It goes idle once its output
+	// hasn't changed for a quiet period, and wakes at the first report
+	// that changes it. Stick moves smaller than stickNoise don't count, so
+	// a resting stick's jitter doesn't keep it awake. An idle controller
+	// is polled every pollPeriod instead of as fast as it answers, and
+	// reads block instead of spinning.
+	// One thread at a time, like the Controller.
+	class IdleMode {
+	public:
+		using clock = std::chrono::steady_clock;
+
+		struct Stats {
+			uint64_t sleeps;  // Times it went idle
+			uint64_t wakes;   // Times a report woke it
+			bool idle;
+		};
+
+		static constexpr int32_t stickNoise{ 512 }; // Of 32767
+
+		// Never goes idle with a 'quiet' of 0
+		void configure(clock::duration quiet, clock::duration pollPeriod);
+		bool enabled() const;
+		// 'state' was just sent out
+		void report(const XINPUT_GAMEPAD &state);
+		bool idle() const;
+		// When to poll next: 'now' while active, a poll period after the last
+		// report while idle
+		clock::time_point next(clock::time_point now) const;
+		Stats stats() const;
+
+	private:
+		clock::duration quiet{ 0 };
+		clock::duration pollPeriod{ 0 };
+		bool isIdle{ false };
+		bool hasReference{ false };
+		XINPUT_GAMEPAD reference{};   // The output at the last change
+		clock::time_point lastChange{};
+		clock::time_point lastReport{};
+		Stats counters{};
+
+		static bool differs(const XINPUT_GAMEPAD &a, const XINPUT_GAMEPAD &b);
+	};
+
+};
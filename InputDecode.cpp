@@ -0,0 +1,130 @@
+#include "InputDecode.hpp"
+
+#include <algorithm>
+#ifdef _DEBUG
+#include <iostream>
+#endif
+#include <limits>
+
+namespace {
+	using namespace Procon;
+
+	void updateCalibrationRangeStick(const StickPoint &input, StickRange &cal) {
+		using std::max;
+		using std::min;
+
+		cal.x.max = max(cal.x.max, input.x);
+		cal.x.min = min(cal.x.min, input.x);
+		cal.y.max = max(cal.y.max, input.y);
+		cal.y.min = min(cal.y.min, input.y);
+		
+	}
+
+	const ButtonBit shareBit = buttonBit(Button::Share);
+
+	// Overrides calibrated stick axes with full deflection for buttons mapped to stick directions
+	void applyStickDirections(uchar directions, XINPUT_GAMEPAD &pad) {
+		if (directions == 0) return;
+		constexpr short smax = std::numeric_limits<short>::max();
+		constexpr short smin = std::numeric_limits<short>::min();
+		auto axis = [directions](uchar positive, uchar negative, short current) -> short {
+			const bool pos = (directions & positive) != 0;
+			const bool neg = (directions & negative) != 0;
+			if (pos == neg) return pos ? 0 : current;
+			return pos ? smax : smin;
+		};
+		pad.sThumbLX = axis(LStickRightBit, LStickLeftBit, pad.sThumbLX);
+		pad.sThumbLY = axis(LStickUpBit, LStickDownBit, pad.sThumbLY);
+		pad.sThumbRX = axis(RStickRightBit, RStickLeftBit, pad.sThumbRX);
+		pad.sThumbRY = axis(RStickUpBit, RStickDownBit, pad.sThumbRY);
+	}
+
+#ifdef _DEBUG
+	void printButtons(uchar c, ButtonSource src) {
+		for (int i = 0; i < 8; ++i) {
+			if ((c & (1 << i)) != 0 && buttonAt(src, i) != Button::None) {
+				std::cout << buttonName(buttonAt(src, i)) << ' ';
+			}
+		}
+	}
+#endif //#ifdef _DEBUG
+
+}; //namespace
+
+namespace Procon {
+
+	void SetDefaultCalibration(CalibrationData &dat) {
+		constexpr uchar ucmin = std::numeric_limits<uchar>::min();
+		constexpr uchar ucmax = std::numeric_limits<uchar>::max();
+		dat.leftCenter.x = ucmax / 2;
+		dat.leftCenter.y = ucmax / 2;
+		dat.rightCenter = dat.leftCenter;
+		dat.left.x.min = dat.leftCenter.x;
+		dat.left.x.max = dat.leftCenter.x;
+		dat.left.y = dat.left.x;
+		dat.right = dat.left;
+	}
+
+	void zeroPadState(ExpandedPadState &state) {
+		state.xinState = { 0 };
+		state.leftStick = { 0 };
+		state.rightStick = { 0 };
+		state.sharePressed = false;
+	}
+
+	void calibrateToRange(const StickPoint &stick, const StickRange &range, const StickPoint &center, short &outx, short &outy) {
+		constexpr short smax = std::numeric_limits<short>::max();
+		constexpr short smin = std::numeric_limits<short>::min();
+		
+		outx = static_cast<short>(
+			smax * std::clamp(
+				(static_cast<double>(stick.x) - center.x) / static_cast<double>(range.x.max - range.x.min) * 2.0,
+				-1.0,
+				1.0
+			)
+			
+		);
+		outy = static_cast<short>(
+			smax *std::clamp(
+				(static_cast<double>(stick.y) - center.y) / static_cast<double>(range.y.max - range.y.min) * 2.0,
+				-1.0,
+				1.0
+			)
+		);
+
+	}
+
+	void updateCalibrationRange(const ExpandedPadState &state, CalibrationData &cal) {
+		updateCalibrationRangeStick(state.leftStick, cal.left);
+		updateCalibrationRangeStick(state.rightStick, cal.right);
+	}
+
+	void mapInputToState(const InputPacket &p, const Profile &profile, CalibrationData &cal, StickFilter &filter, MacroPlayer &macros, ExpandedPadState &state) {
+		state.leftStick.x = ((p.sticks[1] & 0x0F) << 4) | ((p.sticks[0] & 0xF0) >> 4);
+		state.leftStick.y = p.sticks[2];
+		state.rightStick.x = ((p.sticks[4] & 0x0F) << 4) | ((p.sticks[3] & 0xF0) >> 4);
+		state.rightStick.y = p.sticks[5];
+
+		filter.apply(profile.stickFilter, state.leftStick, state.rightStick);
+		
+		updateCalibrationRange(state, cal);
+
+		// Sets state.xinState's sticks
+		calibrateToRange(state.leftStick, cal.left, cal.leftCenter, state.xinState.sThumbLX, state.xinState.sThumbLY);
+		calibrateToRange(state.rightStick, cal.right, cal.rightCenter, state.xinState.sThumbRX, state.xinState.sThumbRY);
+
+#ifdef _DEBUG
+		printButtons(p.leftButtons, ButtonSource::Left);
+		printButtons(p.rightButtons, ButtonSource::Right);
+		printButtons(p.middleButtons, ButtonSource::Middle);
+#endif
+		MappedButtons mapped = profile.buttons.lookup(p.leftButtons, p.rightButtons, p.middleButtons);
+		macros.apply(profile.macros, packButtons(p.leftButtons, p.rightButtons, p.middleButtons), mapped);
+		state.xinState.wButtons = mapped.wButtons;
+		state.xinState.bLeftTrigger = mapped.leftTrigger;
+		state.xinState.bRightTrigger = mapped.rightTrigger;
+		applyStickDirections(mapped.stickDirections, state.xinState);
+		state.sharePressed = (p.middleButtons & shareBit.mask) != 0;
+	}
+
+};
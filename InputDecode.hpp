@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+
+#include "Common.hpp"
+#include "Macros.hpp"
+#include "Profile.hpp"
+#include "StickFilter.hpp"
+#include "XInputGamepad.hpp"
+
+namespace Procon {
+
+	struct AxisRange {
+		uchar min;
+		uchar max;
+	};
+	struct StickRange {
+		AxisRange x;
+		AxisRange y;
+	};
+	struct CalibrationData {
+		StickRange left;
+		StickRange right;
+		StickPoint leftCenter;
+		StickPoint rightCenter;
+	};
+	void SetDefaultCalibration(CalibrationData &dat);
+	struct ExpandedPadState {
+		XINPUT_GAMEPAD xinState;
+		StickPoint leftStick;
+		StickPoint rightStick;
+		bool sharePressed;
+	};
+	void zeroPadState(ExpandedPadState &state);
+
+	// Input report as read from the device, 0x30 or the reply to 0x1f
+	struct InputPacket {
+		uint8_t header[8];
+		uint8_t unknown[2];
+		uint8_t reportId;
+		uint8_t timer;
+		uint8_t battery;
+		uint8_t rightButtons;
+		uint8_t middleButtons;
+		uint8_t leftButtons;
+		uint8_t sticks[6];
+		uint8_t vibrator;
+		uint8_t imu[36]; // Three samples of accel x/y/z then gyro x/y/z, int16 little endian, oldest first
+	};
+
+	// stick is current stick location, range is min/max of stick, center is center point of stick
+	void calibrateToRange(const StickPoint &stick, const StickRange &range, const StickPoint &center, short &outx, short &outy);
+	// Widens cal's ranges to take in state's sticks
+	void updateCalibrationRange(const ExpandedPadState &state, CalibrationData &cal);
+	// Decodes p's sticks and buttons into state through the profile's filter, button map and macros
+	void mapInputToState(const InputPacket &p, const Profile &profile, CalibrationData &cal, StickFilter &filter, MacroPlayer &macros, ExpandedPadState &state);
+
+};
@@ -0,0 +1,50 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Procon {
+
+	uint64_t LatencyHistogram::bucketStart(size_t b) {
+		if (b < subBuckets) return b;
+		const int bit = static_cast<int>(b / subBuckets) + subBits - 1;
+		return (subBuckets + b % subBuckets) << (bit - subBits);
+	}
+
+	uint64_t LatencyHistogram::bucketWidth(size_t b) {
+		if (b < subBuckets) return 1;
+		const int bit = static_cast<int>(b / subBuckets) + subBits - 1;
+		return uint64_t{ 1 } << (bit - subBits);
+	}
+
+	LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+		Snapshot s;
+		s.count = 0;
+		for (size_t b = 0; b < bucketCount; ++b) {
+			s.counts[b] = counts[b].load(std::memory_order_relaxed);
+			s.count += s.counts[b];
+		}
+		s.sumNs = sum.load(std::memory_order_relaxed);
+		s.maxNs = largest.load(std::memory_order_relaxed);
+		return s;
+	}
+
+	double LatencyHistogram::Snapshot::percentile(double p) const {
+		if (count == 0) return 0;
+		const uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(std::clamp(p, 0.0, 1.0) * count)), 1);
+		uint64_t seen = 0;
+		for (size_t b = 0; b < bucketCount; ++b) {
+			seen += counts[b];
+			if (seen >= rank) {
+				const double mid = bucketStart(b) + (bucketWidth(b) - 1) / 2.0;
+				return std::min(mid, static_cast<double>(maxNs));
+			}
+		}
+		return static_cast<double>(maxNs);
+	}
+
+	double LatencyHistogram::Snapshot::meanNs() const {
+		return count > 0 ? static_cast<double>(sumNs) / count : 0.0;
+	}
+
+};
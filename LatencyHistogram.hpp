@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Common.hpp"
+
+namespace Procon {
+
+	// Log-bucketed latency histogram in the style of HdrHistogram. Values in
+	// nanoseconds go in 16 linear buckets per power of two, so a bucket is at
+	// most 1/16 of its values wide, from exact below 16 ns up to about 2 min.
+	// record() is a few integer ops and relaxed stores, no locks or atomic
+	// read-modify-writes. One writer thread, snapshot() from any thread.
+	class LatencyHistogram {
+	public:
+		static constexpr int subBits{ 4 };
+		static constexpr uint64_t subBuckets{ 1 << subBits };
+		static constexpr int topBit{ 36 }; // Values with higher bits set go in the last bucket
+		static constexpr size_t bucketCount{ (topBit - subBits + 2) * subBuckets };
+
+		// A copy of the counts at one point
+		struct Snapshot {
+			std::array<uint64_t, bucketCount> counts;
+			uint64_t count;
+			uint64_t sumNs;
+			uint64_t maxNs;
+
+			// Nanoseconds at or below which 'p' (0 to 1) of the values fall,
+			// the middle of their bucket. 0 if nothing was recorded.
+			double percentile(double p) const;
+			double meanNs() const;
+		};
+
+		static size_t bucketOf(uint64_t ns) {
+			if (ns < subBuckets) return static_cast<size_t>(ns);
+			const int bit = highestSetBit(ns);
+			if (bit > topBit) return bucketCount - 1;
+			return static_cast<size_t>((bit - subBits + 1) * subBuckets + ((ns >> (bit - subBits)) & (subBuckets - 1)));
+		}
+		// Smallest value in bucket 'b', and how many values it holds
+		static uint64_t bucketStart(size_t b);
+		static uint64_t bucketWidth(size_t b);
+
+		void record(uint64_t ns) {
+			add(counts[bucketOf(ns)], 1);
+			add(sum, ns);
+			if (ns > largest.load(std::memory_order_relaxed)) largest.store(ns, std::memory_order_relaxed);
+		}
+		Snapshot snapshot() const;
+
+	private:
+		std::array<std::atomic<uint64_t>, bucketCount> counts{};
+		std::atomic<uint64_t> sum{ 0 };
+		std::atomic<uint64_t> largest{ 0 };
+
+		// Single writer, so a plain load and store instead of fetch_add
+		static void add(std::atomic<uint64_t> &a, uint64_t v) {
+			a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+		}
+	};
+
+};
@@ -0,0 +1,56 @@
+#include "LatencyMonitor.hpp"
+
+#include <fstream>
+#include <iomanip>
+
+namespace Procon {
+
+	const char* pollStageName(PollStage stage) {
+		switch (stage) {
+		case PollStage::HidWrite: return "hid_write";
+		case PollStage::HidRead: return "hid_read";
+		case PollStage::Decode: return "decode";
+		case PollStage::Output: return "output";
+		}
+		return "unknown";
+	}
+
+	StageHistograms& LatencyMonitor::controller(uchar port) {
+		if (!owned[port]) {
+			owned[port] = std::make_unique<StageHistograms>();
+			ports[port].store(owned[port].get(), std::memory_order_release);
+		}
+		return *owned[port];
+	}
+
+	void LatencyMonitor::report(std::ostream &out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+		out << std::fixed << std::setprecision(2);
+		out << std::left << std::setw(6) << "port" << std::setw(11) << "stage" << std::right
+			<< std::setw(12) << "count" << std::setw(10) << "mean_us" << std::setw(10) << "p50_us"
+			<< std::setw(10) << "p90_us" << std::setw(10) << "p99_us" << std::setw(10) << "p99.9_us"
+			<< std::setw(10) << "max_us" << '\n';
+		for (size_t port = 0; port < ports.size(); ++port) {
+			const StageHistograms *h = ports[port].load(std::memory_order_acquire);
+			if (h == nullptr) continue;
+			for (size_t stage = 0; stage < pollStageCount; ++stage) {
+				const LatencyHistogram::Snapshot s = h->stages[stage].snapshot();
+				out << std::left << std::setw(6) << port << std::setw(11) << pollStageName(static_cast<PollStage>(stage)) << std::right
+					<< std::setw(12) << s.count << std::setw(10) << s.meanNs() / 1000 << std::setw(10) << s.percentile(0.5) / 1000
+					<< std::setw(10) << s.percentile(0.9) / 1000 << std::setw(10) << s.percentile(0.99) / 1000
+					<< std::setw(10) << s.percentile(0.999) / 1000 << std::setw(10) << s.maxNs / 1000.0 << '\n';
+			}
+		}
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+	bool LatencyMonitor::dump(const std::string &path) const {
+		std::ofstream file{ path, std::ios::trunc };
+		if (!file) return false;
+		report(file);
+		return static_cast<bool>(file.flush());
+	}
+
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "Common.hpp"
+#include "LatencyHistogram.hpp"
+
+namespace Procon {
+
+	// Where the time of a poll goes, see Controller::timeTo
+	enum class PollStage : uint8_t {
+		HidWrite, // Sending a command
+		HidRead,  // Waiting for its reply
+		Decode,   // Reply to pad state: mapping, filters, turbo, combos
+		Output,   // Handing the state to the OutputSink
+	};
+	constexpr size_t pollStageCount{ 4 };
+	const char* pollStageName(PollStage stage);
+
+	// One controller's histograms, written by its polling thread
+	struct StageHistograms {
+		std::array<LatencyHistogram, pollStageCount> stages;
+
+		void record(PollStage stage, uint64_t ns) {
+			stages[static_cast<size_t>(stage)].record(ns);
+		}
+	};
+
+	// Per-stage latency histograms of every controller. Controllers record
+	// into their port's StageHistograms; report() and dump() take snapshots
+	// from any thread without stopping them.
+	class LatencyMonitor {
+		std::array<std::unique_ptr<StageHistograms>, 256> owned;
+		std::array<std::atomic<StageHistograms*>, 256> ports{};
+	public:
+		LatencyMonitor() = default;
+		LatencyMonitor(const LatencyMonitor&) = delete;
+		LatencyMonitor& operator=(const LatencyMonitor&) = delete;
+
+		// Creates the histograms on first use, from the thread that sets up
+		// controllers
+		StageHistograms& controller(uchar port);
+
+		// A table of count, mean, percentiles and max by port and stage, in µs
+		void report(std::ostream &out) const;
+		// Writes report() to 'path', replacing it. Returns false if it can't.
+		bool dump(const std::string &path) const;
+	};
+
+};
@@ -0,0 +1,224 @@
+#include "LocalSocket.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <WinSock2.h>
+#include <Windows.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	constexpr intptr_t invalidHandle{ -1 };
+
+#ifdef _WIN32
+	using NativeSocket = SOCKET;
+	using PollFd = WSAPOLLFD;
+
+	void ensureWinsock() {
+		static const bool started = [] {
+			WSADATA data;
+			if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+				throw Procon::SocketError("Unable to start Winsock");
+			}
+			return true;
+		}();
+		(void)started;
+	}
+	int lastError() {
+		return WSAGetLastError();
+	}
+	bool wouldBlock() {
+		return WSAGetLastError() == WSAEWOULDBLOCK;
+	}
+	void closeNative(NativeSocket s) {
+		closesocket(s);
+	}
+	int pollNative(PollFd *fds, size_t count, int timeoutMs) {
+		return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+	}
+	void removeFile(const std::string &path) {
+		DeleteFileA(path.c_str());
+	}
+	constexpr int sendFlags{ 0 };
+#else
+	using NativeSocket = int;
+	using PollFd = pollfd;
+
+	void ensureWinsock() {
+	}
+	int lastError() {
+		return errno;
+	}
+	bool wouldBlock() {
+		return errno == EAGAIN || errno == EWOULDBLOCK;
+	}
+	void closeNative(NativeSocket s) {
+		close(s);
+	}
+	int pollNative(PollFd *fds, size_t count, int timeoutMs) {
+		int ready;
+		do {
+			ready = ::poll(fds, static_cast<nfds_t>(count), timeoutMs);
+		} while (ready < 0 && errno == EINTR);
+		return ready;
+	}
+	void removeFile(const std::string &path) {
+		unlink(path.c_str());
+	}
+	constexpr int sendFlags{ MSG_NOSIGNAL };
+#endif
+
+	NativeSocket native(intptr_t handle) {
+		return static_cast<NativeSocket>(handle);
+	}
+
+	sockaddr_un makeAddress(const std::string &path) {
+		sockaddr_un addr{};
+		addr.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(addr.sun_path)) {
+			throw Procon::SocketError("Socket path is too long: " + path);
+		}
+		std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+		return addr;
+	}
+
+	NativeSocket openSocket() {
+		ensureWinsock();
+		const NativeSocket s = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (native(invalidHandle) == s) {
+			throw Procon::SocketError("Unable to create socket, error " + std::to_string(lastError()));
+		}
+		return s;
+	}
+
+}; // namespace
+
+namespace Procon {
+
+	SocketError::SocketError(const std::string &what) : std::runtime_error(what) {}
+	SocketError::SocketError(const char *what) : std::runtime_error(what) {}
+
+	LocalSocket::LocalSocket() :handle(invalidHandle) {
+	}
+	LocalSocket::LocalSocket(intptr_t handle) :handle(handle) {
+	}
+	LocalSocket::LocalSocket(LocalSocket &&other) :handle(other.handle) {
+		other.handle = invalidHandle;
+	}
+	LocalSocket& LocalSocket::operator=(LocalSocket &&other) {
+		if (this != &other) {
+			if (valid()) closeNative(native(handle));
+			handle = other.handle;
+			other.handle = invalidHandle;
+		}
+		return *this;
+	}
+	LocalSocket::~LocalSocket() {
+		if (valid()) closeNative(native(handle));
+	}
+
+	LocalSocket LocalSocket::listen(const std::string &path) {
+		const sockaddr_un addr = makeAddress(path);
+		LocalSocket s{ static_cast<intptr_t>(openSocket()) };
+		removeFile(path);
+		if (bind(native(s.handle), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+			throw SocketError("Unable to bind " + path + ", error " + std::to_string(lastError()));
+		}
+		if (::listen(native(s.handle), SOMAXCONN) != 0) {
+			throw SocketError("Unable to listen on " + path + ", error " + std::to_string(lastError()));
+		}
+		s.setNonBlocking();
+		return s;
+	}
+
+	LocalSocket LocalSocket::connect(const std::string &path) {
+		const sockaddr_un addr = makeAddress(path);
+		LocalSocket s{ static_cast<intptr_t>(openSocket()) };
+		if (::connect(native(s.handle), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+			throw SocketError("Unable to connect to " + path + ", error " + std::to_string(lastError()));
+		}
+		return s;
+	}
+
+	bool LocalSocket::valid() const {
+		return handle != invalidHandle;
+	}
+
+	void LocalSocket::setNonBlocking() {
+#ifdef _WIN32
+		u_long on = 1;
+		ioctlsocket(native(handle), FIONBIO, &on);
+#else
+		fcntl(handle, F_SETFL, fcntl(handle, F_GETFL) | O_NONBLOCK);
+#endif
+	}
+
+	LocalSocket LocalSocket::accept() {
+		const NativeSocket s = ::accept(native(handle), nullptr, nullptr);
+		if (native(invalidHandle) == s) {
+			return LocalSocket();
+		}
+		return LocalSocket(static_cast<intptr_t>(s));
+	}
+
+	ptrdiff_t LocalSocket::send(const void *data, size_t size) {
+		const auto sent = ::send(native(handle), static_cast<const char*>(data), static_cast<int>(size), sendFlags);
+		if (sent < 0) {
+			return wouldBlock() ? 0 : -1;
+		}
+		return static_cast<ptrdiff_t>(sent);
+	}
+
+	ptrdiff_t LocalSocket::receive(void *data, size_t size) {
+		const auto received = ::recv(native(handle), static_cast<char*>(data), static_cast<int>(size), 0);
+		if (received < 0) {
+			return wouldBlock() ? 0 : -1;
+		}
+		return received == 0 ? -1 : static_cast<ptrdiff_t>(received);
+	}
+
+	int LocalSocket::poll(PollEntry *entries, size_t count, int timeoutMs) {
+		std::vector<PollFd> fds(count);
+		for (size_t i = 0; i < count; ++i) {
+			fds[i].fd = native(entries[i].socket->handle);
+			fds[i].events = static_cast<short>((entries[i].wantRead ? POLLIN : 0) | (entries[i].wantWrite ? POLLOUT : 0));
+			fds[i].revents = 0;
+		}
+		const int ready = pollNative(fds.data(), count, timeoutMs);
+		for (size_t i = 0; i < count; ++i) {
+			entries[i].readable = (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+			entries[i].writable = (fds[i].revents & POLLOUT) != 0;
+		}
+		return ready < 0 ? 0 : ready;
+	}
+
+	std::string defaultLocalSocketPath(const std::string &name) {
+#ifdef _WIN32
+		char temp[MAX_PATH + 1];
+		const DWORD length = GetTempPathA(MAX_PATH + 1, temp);
+		return std::string(temp, length) + name;
+#else
+		const char *runtime = std::getenv("XDG_RUNTIME_DIR");
+		return std::string(runtime != nullptr && runtime[0] != '\0' ? runtime : "/tmp") + '/' + name;
+#endif
+	}
+
+	void removeLocalSocketPath(const std::string &path) {
+		removeFile(path);
+	}
+
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace Procon {
+
+	class SocketError : public std::runtime_error {
+	public:
+		explicit SocketError(const std::string &what);
+		explicit SocketError(const char *what);
+	};
+
+	// RAII Unix domain stream socket. Winsock AF_UNIX on Windows (Windows 10
+	// 1803 and later), BSD sockets elsewhere. Move only.
+	class LocalSocket {
+		intptr_t handle;
+
+		explicit LocalSocket(intptr_t handle);
+	public:
+		LocalSocket();
+		LocalSocket(const LocalSocket&) = delete;
+		LocalSocket& operator=(const LocalSocket&) = delete;
+		LocalSocket(LocalSocket &&other);
+		LocalSocket& operator=(LocalSocket &&other);
+		~LocalSocket();
+
+		// Replaces any stale socket file at 'path'. Non-blocking.
+		// Throws Procon::SocketError.
+		static LocalSocket listen(const std::string &path);
+		// Blocking. Throws Procon::SocketError.
+		static LocalSocket connect(const std::string &path);
+
+		bool valid() const;
+		void setNonBlocking();
+		// Invalid socket if nobody is waiting
+		LocalSocket accept();
+		// Bytes sent or received, 0 if it would block, -1 if the peer is gone
+		// or on error. receive() also returns -1 on an orderly close.
+		ptrdiff_t send(const void *data, size_t size);
+		ptrdiff_t receive(void *data, size_t size);
+
+		struct PollEntry {
+			LocalSocket *socket;
+			bool wantRead;
+			bool wantWrite;
+			bool readable; // Also set on close and errors, receive() tells which
+			bool writable;
+		};
+		// Waits up to 'timeoutMs' (-1 forever) for any entry to be ready.
+		// Returns the number of ready entries.
+		static int poll(PollEntry *entries, size_t count, int timeoutMs);
+	};
+
+	// 'name' in the user's runtime directory (temp directory on Windows)
+	std::string defaultLocalSocketPath(const std::string &name);
+	// Removes the file a listening socket left at 'path'
+	void removeLocalSocketPath(const std::string &path);
+
+};
@@ -0,0 +1,146 @@
+#include "Macros.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "Config.hpp"
+
+namespace {
+	using namespace Procon;
+
+	const std::string turboConfigPrefix{ "iTurbo" };
+	const std::string macroConfigPrefix{ "sMacro" };
+	constexpr TimerWheel::Tick maxStepMs{ 60000 };
+
+	MappedButtons combine(const MappedButtons &a, const MappedButtons &b) {
+		return {
+			static_cast<uint16_t>(a.wButtons | b.wButtons),
+			static_cast<uchar>(a.leftTrigger | b.leftTrigger),
+			static_cast<uchar>(a.rightTrigger | b.rightTrigger),
+			static_cast<uchar>(a.stickDirections | b.stickDirections)
+		};
+	}
+
+	MacroStep parseStep(const std::string &key, const std::string &text) {
+		const size_t colon = text.find(':');
+		if (colon == std::string::npos) {
+			throw ConfigError(key + " step " + text + " is missing :<ms>");
+		}
+		MacroStep step{ {}, 0 };
+		std::stringstream targets{ text.substr(0, colon) };
+		std::string name;
+		while (std::getline(targets, name, '+')) {
+			std::optional<MapTarget> target = mapTargetFromName(name);
+			if (!target) {
+				throw ConfigError(key + " has unknown mapping target " + name);
+			}
+			step.output = combine(step.output, targetOutput(*target));
+		}
+		const std::string ms = text.substr(colon + 1);
+		if (ms.empty() || ms.find_first_not_of("0123456789") != std::string::npos || ms.size() > 5
+			|| std::stoul(ms) == 0 || std::stoul(ms) > maxStepMs) {
+			throw ConfigError(key + " step " + text + " must last 1 to " + std::to_string(maxStepMs) + " ms");
+		}
+		step.duration = std::stoul(ms);
+		return step;
+	}
+
+}; // namespace
+
+namespace Procon {
+
+	MacroBindings macroBindingsFromConfig(const std::string &profile) {
+		MacroBindings b;
+		for (size_t i = static_cast<size_t>(MapTarget::DPadUp); i <= static_cast<size_t>(MapTarget::RT); ++i) {
+			const MapTarget target = static_cast<MapTarget>(i);
+			const std::string key = turboConfigPrefix + mapTargetName(target);
+			std::optional<int32_t> cycle = Config::get<int32_t>(key, profile);
+			if (!cycle) continue;
+			if (*cycle < 2) {
+				throw ConfigError(key + " must be at least 2 (ms)");
+			}
+			const uint32_t bit = outputBits(targetOutput(target));
+			b.turboHalfPeriod[lowestSetBit(bit)] = static_cast<TimerWheel::Tick>(*cycle / 2);
+			b.turboMask |= bit;
+		}
+		for (size_t i = 1; i < buttonCount; ++i) {
+			const Button button = static_cast<Button>(i);
+			const std::string key = macroConfigPrefix + buttonName(button);
+			std::optional<std::string> text = Config::get<std::string>(key, profile);
+			if (!text) continue;
+			const uint32_t bit = packedButtonBit(button);
+			std::vector<MacroStep> &steps = b.macros[lowestSetBit(bit)];
+			std::stringstream s{ *text };
+			std::string step;
+			while (std::getline(s, step, ',')) {
+				steps.push_back(parseStep(key, step));
+			}
+			if (!steps.empty()) {
+				b.macroTriggers |= bit;
+			}
+		}
+		return b;
+	}
+
+	void MacroPlayer::TurboTimer::onExpire(TimerWheel &wheel, TimerWheel::Tick) {
+		owner->turboReleased ^= 1u << bit;
+		wheel.schedule(*this, owner->bindings->turboHalfPeriod[bit]);
+	}
+
+	void MacroPlayer::StepTimer::onExpire(TimerWheel &, TimerWheel::Tick) {
+		owner->startStep(owner->step + 1);
+	}
+
+	MacroPlayer::MacroPlayer(TimerWheel &wheel) :wheel(wheel) {
+		for (uint32_t i = 0; i < turboTimers.size(); ++i) {
+			turboTimers[i].owner = this;
+			turboTimers[i].bit = i;
+		}
+		stepTimer.owner = this;
+	}
+
+	void MacroPlayer::startStep(size_t index) {
+		if (macro == nullptr || index >= macro->size()) {
+			macro = nullptr;
+			overlay = {};
+			wheel.cancel(stepTimer);
+			return;
+		}
+		step = index;
+		overlay = (*macro)[index].output;
+		wheel.schedule(stepTimer, (*macro)[index].duration);
+	}
+
+	void MacroPlayer::apply(const MacroBindings &bindings, uint32_t buttons, MappedButtons &out) {
+		this->bindings = &bindings;
+		const uint32_t pressed = buttons & ~lastButtons;
+		lastButtons = buttons;
+		// A trigger restarts its macro, and replaces any other running one
+		for (uint32_t t = pressed & bindings.macroTriggers; t != 0; t &= t - 1) {
+			macro = &bindings.macros[lowestSetBit(t)];
+			startStep(0);
+		}
+
+		// Turbo starts pressed, then toggles every half period while held
+		const uint32_t held = outputBits(out) & bindings.turboMask;
+		for (uint32_t changed = held ^ lastHeld; changed != 0; changed &= changed - 1) {
+			const int bit = lowestSetBit(changed);
+			if ((held & (1u << bit)) != 0) {
+				wheel.schedule(turboTimers[bit], bindings.turboHalfPeriod[bit]);
+			}
+			else {
+				wheel.cancel(turboTimers[bit]);
+				turboReleased &= ~(1u << bit);
+			}
+		}
+		lastHeld = held;
+
+		if (turboReleased != 0) {
+			out.wButtons &= static_cast<uint16_t>(~turboReleased);
+			if ((turboReleased & leftTriggerBit) != 0) out.leftTrigger = 0;
+			if ((turboReleased & rightTriggerBit) != 0) out.rightTrigger = 0;
+		}
+		out = combine(out, overlay);
+	}
+
+};
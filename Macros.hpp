@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ButtonMap.hpp"
+#include "TimerWheel.hpp"
+
+namespace Procon {
+
+	struct MacroStep {
+		MappedButtons output;
+		TimerWheel::Tick duration;
+	};
+
+	// Turbo and macro settings, parsed once from Config.
+	struct MacroBindings {
+		// Half of the press/release cycle per output bit, 0 for no turbo
+		std::array<TimerWheel::Tick, outputBitCount> turboHalfPeriod{};
+		uint32_t turboMask{ 0 };
+		// Indexed by bit in a packButtons mask
+		std::array<std::vector<MacroStep>, 24> macros;
+		uint32_t macroTriggers{ 0 };
+	};
+	// Reads iTurbo<Target> = <cycle ms> and sMacro<Button> = <steps> from Config
+	// for 'profile' (see Config::get).
+	// Steps are comma separated <Target>[+<Target>...]:<ms>, 1 to 60000 ms,
+	// e.g. A:50,None:50,A+B:100
+	// Throws Procon::ConfigError on malformed entries.
+	MacroBindings macroBindingsFromConfig(const std::string &profile = "");
+
+	// Per-controller turbo and macro playback, driven by a TimerWheel that can
+	// be shared by any number of controllers.
+	// Only buttons that changed since the last report are looked at, the rest
+	// of the work happens in timer callbacks, so the cost doesn't grow with the
+	// number of bindings or running macros.
+	class MacroPlayer {
+		struct TurboTimer : TimerWheel::Timer {
+			MacroPlayer *owner{ nullptr };
+			uint32_t bit{ 0 };
+			void onExpire(TimerWheel &wheel, TimerWheel::Tick now) override;
+		};
+		struct StepTimer : TimerWheel::Timer {
+			MacroPlayer *owner{ nullptr };
+			void onExpire(TimerWheel &wheel, TimerWheel::Tick now) override;
+		};
+
+		const MacroBindings *bindings{ nullptr };
+		TimerWheel &wheel;
+		std::array<TurboTimer, outputBitCount> turboTimers;
+		StepTimer stepTimer;
+		uint32_t turboReleased{ 0 }; // Output bits turbo currently holds released
+		uint32_t lastHeld{ 0 };
+		uint32_t lastButtons{ 0 };
+		const std::vector<MacroStep> *macro{ nullptr };
+		size_t step{ 0 };
+		MappedButtons overlay{};
+
+		void startStep(size_t index);
+	public:
+		explicit MacroPlayer(TimerWheel &wheel);
+		MacroPlayer(const MacroPlayer&) = delete;
+		MacroPlayer& operator=(const MacroPlayer&) = delete;
+
+		// buttons is the report's packButtons mask, out the mapped output to modify.
+		// 'bindings' may change between calls but must outlive the MacroPlayer.
+		void apply(const MacroBindings &bindings, uint32_t buttons, MappedButtons &out);
+	};
+
+};
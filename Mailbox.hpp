@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "InputDecode.hpp"
+
+namespace Procon {
+
+	// Single producer, single consumer mailbox holding only the newest
+	// value, wait-free on both sides. A triple buffer: the producer fills
+	// its own slot and swaps it with the shared one, the consumer swaps
+	// its slot with the shared one when that holds something newer. Nobody
+	// waits, nothing is queued, and a value is copied once going in and
+	// not at all coming out. Each value carries a generation counting
+	// publishes from 1, so the consumer can tell a new value from the one
+	// it already has and how many it skipped.
+	template<class T>
+	class TripleBuffer {
+		struct alignas(64) Slot {
+			T value{};
+			uint64_t generation{ 0 };
+		};
+		static constexpr uint8_t indexMask{ 0x3 };
+		static constexpr uint8_t fresh{ 0x4 }; // The shared slot hasn't been taken
+
+		std::array<Slot, 3> slots;
+		alignas(64) std::atomic<uint8_t> shared{ 1 };
+		alignas(64) uint8_t back{ 0 };   // Producer only
+		uint64_t published{ 0 };         // Producer only
+		alignas(64) uint8_t front{ 2 };  // Consumer only
+	public:
+		// Producer side
+		void publish(const T &value) {
+			Slot &s = slots[back];
+			s.value = value;
+			s.generation = ++published;
+			back = shared.exchange(static_cast<uint8_t>(back | fresh), std::memory_order_acq_rel) & indexMask;
+		}
+
+		// Consumer side. Moves to the newest value if one was published since
+		// the last call, returns whether it did.
+		bool update() {
+			if ((shared.load(std::memory_order_relaxed) & fresh) == 0) return false;
+			front = shared.exchange(front, std::memory_order_acq_rel) & indexMask;
+			return true;
+		}
+		// Consumer side. The value update() last moved to, valid until the
+		// next update(). Value-initialized with generation 0 before then.
+		const T& value() const {
+			return slots[front].value;
+		}
+		uint64_t generation() const {
+			return slots[front].generation;
+		}
+	};
+
+	// The newest decoded state of a controller, from its polling thread to
+	// one consumer such as an output or overlay thread, see
+	// Controller::mailTo
+	using PadMailbox = TripleBuffer<ExpandedPadState>;
+
+};
@@ -0,0 +1,78 @@
+#include "OutputSink.hpp"
+
+namespace Procon {
+
+	bool OutputSink::feedback(uchar, PadFeedback &) {
+		return false;
+	}
+	size_t OutputSink::capacity() const {
+		return 256;
+	}
+
+	OutputError::OutputError(const std::string &what) : runtime_error(what) {}
+	OutputError::OutputError(const char *what) : runtime_error(what) {}
+
+	LockedSink::LockedSink(OutputSink &sink) :sink(sink) {
+	}
+	void LockedSink::plugIn(uchar port) {
+		std::lock_guard<std::mutex> l{ lock };
+		sink.plugIn(port);
+	}
+	void LockedSink::unplug(uchar port) {
+		std::lock_guard<std::mutex> l{ lock };
+		sink.unplug(port);
+	}
+	void LockedSink::submit(const PadUpdate *updates, size_t count) {
+		std::lock_guard<std::mutex> l{ lock };
+		sink.submit(updates, count);
+	}
+	bool LockedSink::feedback(uchar port, PadFeedback &out) {
+		std::lock_guard<std::mutex> l{ lock };
+		return sink.feedback(port, out);
+	}
+	size_t LockedSink::capacity() const {
+		return sink.capacity();
+	}
+	std::mutex& LockedSink::mutex() {
+		return lock;
+	}
+
+	void NullSink::plugIn(uchar) {
+	}
+	void NullSink::unplug(uchar) {
+	}
+	void NullSink::submit(const PadUpdate *, size_t count) {
+		++batches;
+		updates += count;
+	}
+	size_t NullSink::batchCount() const {
+		return batches;
+	}
+	size_t NullSink::updateCount() const {
+		return updates;
+	}
+
+	void RecordingSink::plugIn(uchar port) {
+		recorded.push_back({ Kind::PlugIn, 0, { port, {} } });
+	}
+	void RecordingSink::unplug(uchar port) {
+		recorded.push_back({ Kind::Unplug, 0, { port, {} } });
+	}
+	void RecordingSink::submit(const PadUpdate *updates, size_t count) {
+		for (size_t i = 0; i < count; ++i) {
+			recorded.push_back({ Kind::State, batches, updates[i] });
+		}
+		++batches;
+	}
+	const std::vector<RecordingSink::Record>& RecordingSink::records() const {
+		return recorded;
+	}
+	size_t RecordingSink::batchCount() const {
+		return batches;
+	}
+	void RecordingSink::clear() {
+		recorded.clear();
+		batches = 0;
+	}
+
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Common.hpp"
+#include "XInputGamepad.hpp"
+
+namespace Procon {
+
+	struct PadUpdate {
+		uchar port;
+		XINPUT_GAMEPAD state;
+	};
+
+	// Rumble and LED the host asked a virtual pad for
+	struct PadFeedback {
+		bool vibrate;
+		uchar largeMotor;
+		uchar smallMotor;
+		uchar led;
+	};
+
+	// Where mapped pad states go, one virtual pad per port.
+	// States are submitted in batches so a backend can send several pads
+	// with one system call. Not thread-safe, call from one thread at a time.
+	class OutputSink {
+	public:
+		virtual ~OutputSink() = default;
+
+		// Throws Procon::OutputError if the pad can't be created.
+		virtual void plugIn(uchar port) = 0;
+		virtual void unplug(uchar port) = 0;
+		// At most one update per port. Throws Procon::OutputError.
+		virtual void submit(const PadUpdate *updates, size_t count) = 0;
+		// Returns false if the backend has no feedback for 'port'.
+		virtual bool feedback(uchar port, PadFeedback &out);
+		// How many pads the backend can present, ports 0 to capacity() - 1.
+		// Every port a uchar can name unless the backend says otherwise.
+		virtual size_t capacity() const;
+	};
+
+	// Serializes every call to another sink, so controllers polled on
+	// several threads can share it. Hold mutex() to call the inner sink
+	// directly, such as to commit a FrameCommit.
+	class LockedSink : public OutputSink {
+		OutputSink &sink;
+		std::mutex lock;
+	public:
+		explicit LockedSink(OutputSink &sink);
+
+		void plugIn(uchar port) override;
+		void unplug(uchar port) override;
+		void submit(const PadUpdate *updates, size_t count) override;
+		bool feedback(uchar port, PadFeedback &out) override;
+		size_t capacity() const override;
+
+		std::mutex& mutex();
+	};
+
+	class OutputError : public std::runtime_error {
+	public:
+		explicit OutputError(const std::string &what);
+		explicit OutputError(const char *what);
+	};
+
+	// Discards everything, for timing the decode pipeline on its own.
+	class NullSink : public OutputSink {
+		size_t batches{ 0 };
+		size_t updates{ 0 };
+	public:
+		void plugIn(uchar port) override;
+		void unplug(uchar port) override;
+		void submit(const PadUpdate *updates, size_t count) override;
+
+		size_t batchCount() const;
+		size_t updateCount() const;
+	};
+
+	// Keeps every call in order, for checking output in tests and tools.
+	class RecordingSink : public OutputSink {
+	public:
+		enum class Kind { PlugIn, Unplug, State };
+		struct Record {
+			Kind kind;
+			size_t batch; // Index of the submit() call for State records
+			PadUpdate update; // Only the port is set for PlugIn and Unplug
+		};
+	private:
+		std::vector<Record> recorded;
+		size_t batches{ 0 };
+	public:
+		void plugIn(uchar port) override;
+		void unplug(uchar port) override;
+		void submit(const PadUpdate *updates, size_t count) override;
+
+		const std::vector<Record>& records() const;
+		size_t batchCount() const;
+		void clear();
+	};
+
+};
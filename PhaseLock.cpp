@@ -0,0 +1,132 @@
+#include "PhaseLock.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	using clock = std::chrono::steady_clock;
+
+	double microsBetween(clock::time_point from, clock::time_point to) {
+		return std::chrono::duration<double, std::micro>(to - from).count();
+	}
+
+	clock::duration micros(double us) {
+		return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::micro>(us));
+	}
+}; // namespace
+
+namespace Procon {
+
+	void PhaseLock::restart(clock::time_point sent, uchar timer) {
+		started = true;
+		samples = 0;
+		anchored = false;
+		anchoredOnEdge = false;
+		lastTimer = timer;
+		lastSent = sent;
+		periodUs = 0;
+		retrying = false;
+	}
+
+	void PhaseLock::reanchor(clock::time_point at) {
+		anchor = at;
+		anchorSamples = samples;
+		anchored = true;
+	}
+
+	void PhaseLock::reply(clock::time_point sent, uchar timer) {
+		++counters.replies;
+		if (!started) {
+			restart(sent, timer);
+			return;
+		}
+		// Too far apart to tell how often the timer wrapped in between
+		const double sinceLast = microsBetween(lastSent, sent);
+		if (sinceLast > (periodUs > 0 ? 200 * periodUs : 100000.0)) {
+			restart(sent, timer);
+			return;
+		}
+		const uchar step = static_cast<uchar>(timer - lastTimer);
+		lastTimer = timer;
+		lastSent = sent;
+		samples += step;
+		if (step == 0) {
+			++counters.repeated;
+		}
+		else {
+			++counters.fresh;
+		}
+
+		if (retrying) {
+			// Not on time, tells nothing about the phase
+			retrying = false;
+			return;
+		}
+		if (periodUs == 0) {
+			// Polling back to back, the first reply with a new sample is
+			// within a round trip of when it was taken
+			if (step == 0) return;
+			if (!anchored) {
+				reanchor(sent);
+			}
+			else if (samples - anchorSamples >= learnSamples) {
+				periodUs = microsBetween(anchor, sent) / (samples - anchorSamples);
+				edge = sent;
+				lastFresh = sent;
+				stepUs = periodUs / 16;
+				freshRun = 0;
+			}
+			return;
+		}
+
+		// Fewer samples than periods went by since the request before: this
+		// one was early, a sample is taken just after it
+		if (step < std::lround(sinceLast / periodUs)) {
+			// Timed from one request this close to a sample to the next
+			if (!anchoredOnEdge) {
+				anchoredOnEdge = true;
+				reanchor(sent);
+			}
+			else if (samples - anchorSamples >= learnSamples) {
+				periodUs = microsBetween(anchor, sent) / (samples - anchorSamples);
+			}
+			// Back to a little after the last request that got a new sample,
+			// closing in slower from now on. The sample missed is about to
+			// be taken, ask again at once.
+			stepUs = std::max(stepUs / 2, periodUs / 1024);
+			edge = lastFresh + micros(backOff * stepUs);
+			freshRun = 0;
+			retrying = true;
+		}
+		else {
+			lastFresh = sent;
+			edge -= micros(stepUs);
+			// Lost the edge, search faster
+			if (++freshRun >= learnSamples) {
+				stepUs = std::min(stepUs * 2, periodUs / 16);
+				freshRun = 0;
+			}
+		}
+		// Kept within a period of the requests so a better period doesn't move it
+		const double behind = microsBetween(edge, sent);
+		if (behind > periodUs) edge += micros(std::floor(behind / periodUs) * periodUs);
+	}
+
+	PhaseLock::clock::time_point PhaseLock::next(clock::time_point now) const {
+		if (periodUs == 0 || retrying) return now;
+		// Once per sample, late rather than not at all when the time has
+		// just passed
+		const double slackUs = periodUs / 4;
+		const double last = std::floor(microsBetween(edge, lastSent) / periodUs + 0.5);
+		const double due = std::ceil((microsBetween(edge, now) - slackUs) / periodUs);
+		return std::max(edge + micros(std::max(last + 1, due) * periodUs), now);
+	}
+
+	PhaseLock::Stats PhaseLock::stats() const {
+		Stats s = counters;
+		s.periodUs = periodUs;
+		s.locked = periodUs > 0;
+		return s;
+	}
+
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#include "Common.hpp"
+
+namespace Procon {
+
+	// Times getInput requests to reach the controller just after it takes a
+	// new input sample, instead of anywhere in the sample period, so a reply
+	// carries input that's about as fresh as it gets. The sample period is
+	// learned from the timer byte of the replies over the time they were
+	// asked for. The phase is found by moving requests a little earlier
+	// after every reply with a new sample, and back after one that repeats
+	// the last sample, which is then asked for again at once: requests
+	// settle just after the sample is taken, with one in about 10 asked
+	// twice. Asks about once per sample, never more often than polling back
+	// to back.
+	class PhaseLock {
+	public:
+		using clock = std::chrono::steady_clock;
+
+		struct Stats {
+			uint64_t replies;
+			uint64_t fresh;     // Carried a new sample
+			uint64_t repeated;  // Carried the same sample as the reply before
+			double periodUs;    // 0 until learned
+			bool locked;
+		};
+
+		static constexpr uint64_t learnSamples{ 32 }; // Polls back to back until this many samples went by
+		static constexpr double backOff{ 7 };         // Steps after the last new sample to move to after an early request
+
+		// The request sent at 'sent' was answered with 'timer'
+		void reply(clock::time_point sent, uchar timer);
+		// When to send the next request: 'now' until the period is learned
+		// or after an early request, otherwise the next time the locked
+		// phase comes round, or 'now' if it has just passed
+		clock::time_point next(clock::time_point now) const;
+		Stats stats() const;
+
+	private:
+		bool started{ false };
+		uint64_t samples{ 0 };            // Counted from the timer since the restart
+		bool anchored{ false };
+		bool anchoredOnEdge{ false };     // The anchor was just before a sample
+		clock::time_point anchor{};       // The period is timed from this request
+		uint64_t anchorSamples{ 0 };      // 'samples' at the anchor
+		uchar lastTimer{ 0 };
+		clock::time_point lastSent{};
+		double periodUs{ 0 };
+		clock::time_point edge{};         // A recent time requests were due, they're due every period from it
+		double stepUs{ 0 };               // Move earlier after a new sample, halves after an early request
+		clock::time_point lastFresh{};    // The last request that got a new sample
+		uint64_t freshRun{ 0 };           // Requests with new samples since the last early one
+		bool retrying{ false };           // Asking again right after an early request
+		Stats counters{};
+
+		void restart(clock::time_point sent, uchar timer);
+		void reanchor(clock::time_point at);
+	};
+
+};
@@ -0,0 +1,80 @@
+#include "PollLoop.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace Procon {
+
+	PollLoop::PollLoop(FrameCommit *frame, std::mutex *frameLock) :frame(frame), frameLock(frameLock) {
+	}
+
+	void PollLoop::add(PollSlot &s) {
+		slots.push_back(&s);
+	}
+	void PollLoop::remove(PollSlot &s) {
+		slots.erase(std::remove(slots.begin(), slots.end(), &s), slots.end());
+	}
+	const std::vector<PollSlot*>& PollLoop::members() const {
+		return slots;
+	}
+	size_t PollLoop::size() const {
+		return slots.size();
+	}
+	uint64_t PollLoop::load() const {
+		uint64_t sum = 0;
+		for (const PollSlot *s : slots) {
+			sum += s->costNs;
+		}
+		return sum;
+	}
+
+	bool PollLoop::pass() {
+		using clock = std::chrono::steady_clock;
+		const TimerWheel::Tick now = TimerWheel::clockNow();
+		bool anyConnected{ false };
+		// One clock read per controller, each poll ends where the next starts
+		clock::time_point last = clock::now();
+		for (PollSlot *s : slots) {
+			s->wheel.advance(now);
+			if (!s->controller->pollDue(last)) { // Not timed, skipping is free
+				anyConnected = anyConnected || s->controller->connected();
+				continue;
+			}
+			s->controller->pollInput();
+			anyConnected = anyConnected || s->controller->connected();
+			const clock::time_point t = clock::now();
+			const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t - last).count();
+			last = t;
+			// Moving average over about 8 polls
+			s->costNs = static_cast<uint64_t>(static_cast<int64_t>(s->costNs) + (ns - static_cast<int64_t>(s->costNs)) / 8);
+		}
+		if (frame != nullptr) {
+			if (frameLock != nullptr) {
+				std::lock_guard<std::mutex> l{ *frameLock };
+				frame->commit();
+			}
+			else {
+				frame->commit();
+			}
+		}
+		return anyConnected;
+	}
+
+	bool PollLoop::idle() const {
+		for (const PollSlot *s : slots) {
+			if (s->controller->connected() && !s->controller->idle()) return false;
+		}
+		return !slots.empty();
+	}
+
+	std::chrono::steady_clock::time_point PollLoop::nextDue(std::chrono::steady_clock::time_point now) const {
+		std::chrono::steady_clock::time_point due = std::chrono::steady_clock::time_point::max();
+		for (const PollSlot *s : slots) {
+			if (!s->controller->connected()) continue;
+			due = std::min(due, s->controller->nextPoll(now));
+			if (due <= now) return now;
+		}
+		return slots.empty() ? now : due;
+	}
+
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Controller.hpp"
+#include "FrameCommit.hpp"
+#include "TimerWheel.hpp"
+
+namespace Procon {
+
+	// A controller and the timer wheel its turbo and macros run on. Every
+	// controller has its own wheel so it can be moved between polling threads.
+	struct PollSlot {
+		TimerWheel wheel{ TimerWheel::clockNow() };
+		std::unique_ptr<Controller> controller; // Destroyed before the wheel
+		uint64_t costNs{ 0 }; // Smoothed pollInput time, kept by the loop polling it
+	};
+
+	// One pass of the driver's input loop: advance each controller's timer
+	// wheel and poll it if it's due, then commit the frame if output is
+	// batched.
+	// Shared by main and the load benchmarks so they measure the same code.
+	class PollLoop {
+		FrameCommit *frame;
+		std::mutex *frameLock;
+		std::vector<PollSlot*> slots;
+	public:
+		// 'frame' may be nullptr, it's committed holding 'frameLock' if that's
+		// set. Both must outlive the loop.
+		explicit PollLoop(FrameCommit *frame, std::mutex *frameLock = nullptr);
+
+		// 's' must outlive the loop, or be removed first
+		void add(PollSlot &s);
+		void remove(PollSlot &s);
+		const std::vector<PollSlot*>& members() const;
+		size_t size() const;
+		// Sum of the members' costNs, about how long a pass takes
+		uint64_t load() const;
+
+		// Returns false once every controller is disconnected.
+		// Throws Procon::ControllerException and Procon::OutputError.
+		bool pass();
+		// Every connected controller is idle, so nothing needs polling on time
+		bool idle() const;
+		// When the next pass has a controller to poll, 'now' if it already has,
+		// time_point::max() if none is connected
+		std::chrono::steady_clock::time_point nextDue(std::chrono::steady_clock::time_point now) const;
+	};
+
+};
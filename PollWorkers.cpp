@@ -0,0 +1,184 @@
+#include "PollWorkers.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+#include "Trace.hpp"
+
+namespace Procon {
+
+	size_t PollWorkers::defaultThreads(size_t controllers) {
+		const size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		return std::max<size_t>(std::min(controllers, cores), 1);
+	}
+
+	PollWorkers::PollWorkers(size_t threads, FrameCommit *frame, std::mutex *frameLock) {
+		for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+			workers.push_back(std::make_unique<Worker>(frame, frameLock));
+		}
+	}
+
+	PollWorkers::~PollWorkers() {
+		stop();
+	}
+
+	void PollWorkers::add(PollSlot &s) {
+		Worker *target = workers.front().get();
+		for (const auto &w : workers) {
+			if (w->size.load(std::memory_order_relaxed) < target->size.load(std::memory_order_relaxed)) {
+				target = w.get();
+			}
+		}
+		target->claimed.store(true, std::memory_order_release);
+		std::lock_guard<std::mutex> l{ target->lock };
+		target->claimed.store(false, std::memory_order_relaxed);
+		target->loop.add(s);
+		target->size.store(target->loop.size(), std::memory_order_relaxed);
+		target->connected.store(true, std::memory_order_relaxed);
+	}
+
+	void PollWorkers::tune(const ThreadTuning &t) {
+		tuning = t;
+	}
+
+	void PollWorkers::start() {
+		stopping = false;
+		for (size_t i = 0; i < workers.size(); ++i) {
+			if (!workers[i]->thread.joinable()) {
+				Worker &worker = *workers[i];
+				worker.thread = std::thread([this, &worker, i] { run(worker, i); });
+			}
+		}
+	}
+
+	void PollWorkers::stop() {
+		stopping = true;
+		for (const auto &w : workers) {
+			if (w->thread.joinable()) w->thread.join();
+		}
+	}
+
+	void PollWorkers::run(Worker &w, size_t index) {
+		if (Tracer *t = Tracer::active()) {
+			t->nameThread("poll " + std::to_string(index));
+		}
+		try {
+			tuning.apply(index);
+			while (!stopping.load(std::memory_order_relaxed)) {
+				if (w.claimed.load(std::memory_order_acquire)) { // Let rebalance() or add() in
+					std::this_thread::yield();
+					continue;
+				}
+				bool empty;
+				bool anyConnected{ false };
+				std::chrono::steady_clock::time_point due;
+				bool idle{ false };
+				{
+					std::lock_guard<std::mutex> l{ w.lock };
+					empty = w.loop.size() == 0;
+					if (!empty) {
+						anyConnected = w.loop.pass();
+						w.load.store(w.loop.load(), std::memory_order_relaxed);
+						w.passes.store(w.passes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+						due = w.loop.nextDue(std::chrono::steady_clock::now());
+						idle = w.loop.idle();
+					}
+				}
+				w.connected.store(anyConnected, std::memory_order_relaxed);
+				if (empty || due == std::chrono::steady_clock::time_point::max()) {
+					// Nothing to poll until a controller is added or reconnected
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+				else if (due - std::chrono::steady_clock::now() > 2 * sleepEarly) {
+					// Nothing due for a while, sleep lags so wake up early and yield the
+					// rest, unless being late doesn't matter
+					std::this_thread::sleep_until(idle ? due : due - sleepEarly);
+				}
+				else {
+					std::this_thread::yield(); // sleep_for causes big lag and not yielding eats way more processor
+				}
+			}
+		}
+		catch (...) {
+			w.connected.store(false, std::memory_order_relaxed);
+			std::lock_guard<std::mutex> l{ errorLock };
+			if (!error) error = std::current_exception();
+		}
+	}
+
+	bool PollWorkers::connected() const {
+		for (const auto &w : workers) {
+			if (w->connected.load(std::memory_order_relaxed)) return true;
+		}
+		return false;
+	}
+
+	void PollWorkers::check() {
+		std::lock_guard<std::mutex> l{ errorLock };
+		if (error) std::rethrow_exception(error);
+	}
+
+	bool PollWorkers::rebalance(double ratio) {
+		if (workers.size() < 2) return false;
+		Worker *hot = nullptr;
+		Worker *cold = nullptr;
+		for (const auto &w : workers) {
+			const uint64_t load = w->load.load(std::memory_order_relaxed);
+			if (hot == nullptr || load > hot->load.load(std::memory_order_relaxed)) hot = w.get();
+			if (cold == nullptr || load < cold->load.load(std::memory_order_relaxed)) cold = w.get();
+		}
+		if (hot == cold || hot->size.load(std::memory_order_relaxed) < 2
+			|| hot->load.load(std::memory_order_relaxed) <= ratio * cold->load.load(std::memory_order_relaxed)) {
+			return false;
+		}
+
+		hot->claimed.store(true, std::memory_order_release);
+		cold->claimed.store(true, std::memory_order_release);
+		std::scoped_lock l{ hot->lock, cold->lock };
+		hot->claimed.store(false, std::memory_order_relaxed);
+		cold->claimed.store(false, std::memory_order_relaxed);
+
+		// Neither is polling now, so the costs are current. Pick the
+		// controller that brings the two passes closest to equal.
+		const int64_t hotLoad = static_cast<int64_t>(hot->loop.load());
+		const int64_t coldLoad = static_cast<int64_t>(cold->loop.load());
+		PollSlot *best = nullptr;
+		int64_t bestSpread = hotLoad - coldLoad;
+		for (PollSlot *s : hot->loop.members()) {
+			const int64_t spread = std::llabs(hotLoad - coldLoad - 2 * static_cast<int64_t>(s->costNs));
+			if (spread < bestSpread) {
+				best = s;
+				bestSpread = spread;
+			}
+		}
+		if (best == nullptr) return false;
+		hot->loop.remove(*best);
+		cold->loop.add(*best);
+		hot->size.store(hot->loop.size(), std::memory_order_relaxed);
+		cold->size.store(cold->loop.size(), std::memory_order_relaxed);
+		hot->load.store(hot->loop.load(), std::memory_order_relaxed);
+		cold->load.store(cold->loop.load(), std::memory_order_relaxed);
+		cold->connected.store(true, std::memory_order_relaxed);
+		moves.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	size_t PollWorkers::threads() const {
+		return workers.size();
+	}
+
+	PollWorkers::Stats PollWorkers::stats() const {
+		Stats s;
+		s.passes = 0;
+		s.moves = moves.load(std::memory_order_relaxed);
+		for (const auto &w : workers) {
+			s.passes += w->passes.load(std::memory_order_relaxed);
+			s.sizes.push_back(w->size.load(std::memory_order_relaxed));
+			s.loadsNs.push_back(w->load.load(std::memory_order_relaxed));
+		}
+		return s;
+	}
+
+};
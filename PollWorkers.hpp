@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FrameCommit.hpp"
+#include "PollLoop.hpp"
+#include "ThreadTuning.hpp"
+
+namespace Procon {
+
+	// Polls controllers on a pool of threads. Each thread owns a shard of the
+	// controllers and runs a PollLoop over it, so a slow read only holds up
+	// the controllers in its shard. rebalance() moves a controller from the
+	// shard with the longest passes to the one with the shortest when that
+	// evens them out, such as when a controller gets slow to answer.
+	// Controllers on different threads submit to the same sink, which must
+	// be a LockedSink or otherwise thread-safe.
+	class PollWorkers {
+	public:
+		struct Stats {
+			uint64_t passes;                // PollLoop passes, all threads
+			uint64_t moves;                 // Controllers moved by rebalance()
+			std::vector<size_t> sizes;      // Controllers by thread
+			std::vector<uint64_t> loadsNs;  // Pass time by thread, see PollLoop::load
+		};
+	private:
+		struct Worker {
+			std::mutex lock; // Held for a whole pass and to change the shard
+			std::atomic<bool> claimed{ false }; // Someone is waiting for 'lock'
+			PollLoop loop;
+			std::atomic<size_t> size{ 0 };
+			std::atomic<uint64_t> load{ 0 };
+			std::atomic<bool> connected{ true };
+			std::atomic<uint64_t> passes{ 0 };
+			std::thread thread;
+
+			Worker(FrameCommit *frame, std::mutex *frameLock) :loop(frame, frameLock) {
+			}
+		};
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::atomic<bool> stopping{ false };
+		std::mutex errorLock;
+		std::exception_ptr error;
+		std::atomic<uint64_t> moves{ 0 };
+		ThreadTuning tuning;
+
+		void run(Worker &w, size_t index);
+	public:
+		// A thread with nothing due until later, because its controllers are
+		// phase locked or idle, sleeps until this long before, then yields.
+		// One with only idle controllers sleeps until it's due.
+		static constexpr std::chrono::milliseconds sleepEarly{ 1 };
+
+		// One per core, but no more than there are controllers
+		static size_t defaultThreads(size_t controllers);
+
+		// 'frame' may be nullptr, it's committed holding 'frameLock' after each
+		// pass of each thread. Both must outlive the pool.
+		PollWorkers(size_t threads, FrameCommit *frame, std::mutex *frameLock);
+		~PollWorkers();
+		PollWorkers(const PollWorkers&) = delete;
+		PollWorkers& operator=(const PollWorkers&) = delete;
+
+		// To the thread with the fewest controllers. 's' must outlive the pool.
+		void add(PollSlot &s);
+		// Pins and prioritizes the threads started from now on
+		void tune(const ThreadTuning &t);
+		void start();
+		// Waits for every thread to finish its pass
+		void stop();
+
+		// False once every controller is disconnected or a thread failed
+		bool connected() const;
+		// Rethrows the first exception a thread stopped with,
+		// Procon::ControllerException, Procon::OutputError or
+		// Procon::ThreadTuningError
+		void check();
+		// Moves one controller if the busiest thread's passes take over
+		// 'ratio' times as long as the idlest's. Returns whether it did.
+		// Call every so often from one thread.
+		bool rebalance(double ratio = 1.5);
+
+		size_t threads() const;
+		Stats stats() const;
+	};
+
+};
@@ -0,0 +1,56 @@
+#include "Profile.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+#include "Config.hpp"
+
+namespace {
+	const std::string defaultProfileName{ "Default" };
+	const std::string profilesConfigName{ "sProfiles" };
+};
+
+namespace Procon {
+
+	Profile::Profile(const std::string &scope)
+		:name(scope.empty() ? defaultProfileName : scope),
+		buttons(buttonTargetsFromConfig(scope)),
+		stickFilter(stickFilterParamsFromConfig(scope)),
+		macros(macroBindingsFromConfig(scope)) {
+	}
+
+	ProfileSet ProfileSet::fromConfig() {
+		ProfileSet set;
+		set.profiles.push_back(std::make_unique<const Profile>(""));
+		std::stringstream names{ Config::get<std::string>(profilesConfigName).value_or("") };
+		std::string name;
+		while (std::getline(names, name, ',')) {
+			if (name.empty()) continue;
+			if (name == defaultProfileName) {
+				throw ConfigError(profilesConfigName + " can't redefine the " + defaultProfileName + " profile");
+			}
+			set.profiles.push_back(std::make_unique<const Profile>(name));
+		}
+		return set;
+	}
+
+	size_t ProfileSet::size() const {
+		return profiles.size();
+	}
+
+	const Profile& ProfileSet::operator[](size_t index) const {
+		return *profiles.at(index);
+	}
+
+	const Profile& ProfileSet::defaultProfile() const {
+		return *profiles.front();
+	}
+
+	size_t ProfileSet::indexOf(const Profile &p) const {
+		for (size_t i = 0; i < profiles.size(); ++i) {
+			if (profiles[i].get() == &p) return i;
+		}
+		throw std::out_of_range("Profile " + p.name + " isn't in this set");
+	}
+
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ButtonMap.hpp"
+#include "Macros.hpp"
+#include "StickFilter.hpp"
+
+namespace Procon {
+
+	// Everything a controller needs to map a report, compiled once at load.
+	// Immutable after construction, so it can be shared between controllers
+	// and threads and switched to with a single pointer store.
+	struct Profile {
+		std::string name;
+		ButtonMap buttons;
+		StickFilterTable stickFilter;
+		MacroBindings macros;
+
+		// Settings are read from 'name@scope' config entries where present,
+		// the unscoped entries otherwise. An empty scope is the default profile.
+		explicit Profile(const std::string &scope);
+	};
+
+	// The default profile followed by the ones named in sProfiles, in order.
+	// Profiles never move once loaded, so Profile pointers stay valid for the
+	// lifetime of the ProfileSet.
+	class ProfileSet {
+		std::vector<std::unique_ptr<const Profile>> profiles;
+	public:
+		// Throws Procon::ConfigError on invalid settings.
+		static ProfileSet fromConfig();
+
+		size_t size() const;
+		const Profile& operator[](size_t index) const;
+		const Profile& defaultProfile() const;
+		// Position of 'p', which must belong to this set.
+		size_t indexOf(const Profile &p) const;
+	};
+
+};
@@ -0,0 +1,174 @@
+#include "Replay.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <thread>
+
+#include "ButtonEvents.hpp"
+
+namespace {
+	constexpr Procon::uchar getInput{ 0x1f };
+
+	bool isInputRequest(const Procon::uchar *data, size_t size) {
+		return size > 8 && data[0] == 0x80 && data[8] == getInput;
+	}
+}; // namespace
+
+namespace Procon {
+
+	void ReplayTransport::add(const CaptureEntry &command, const CaptureEntry &reply) {
+		exchanges.push_back({ command, reply });
+		if (nextReport == exchanges.size() - 1 && reply.record->kind != CaptureKind::Report) {
+			nextReport = exchanges.size();
+		}
+	}
+
+	bool ReplayTransport::finished() const {
+		return nextReport >= exchanges.size();
+	}
+	uint64_t ReplayTransport::nextTime() const {
+		return finished() ? std::numeric_limits<uint64_t>::max() : exchanges[nextReport].reply.record->time;
+	}
+	uint64_t ReplayTransport::reportCount() const {
+		return reports;
+	}
+	uint64_t ReplayTransport::mismatchCount() const {
+		return mismatches;
+	}
+	uint64_t ReplayTransport::skippedCount() const {
+		return skipped;
+	}
+
+	int ReplayTransport::write(const uchar *data, size_t size) {
+		if (isInputRequest(data, size) && position < nextReport) {
+			skipped += nextReport - position;
+			position = nextReport;
+		}
+		if (position >= exchanges.size()) return -1;
+		const CaptureEntry &command = exchanges[position].command;
+		if (command.record != nullptr && (command.record->size != size || std::memcmp(command.data, data, size) != 0)) {
+			++mismatches;
+		}
+		return static_cast<int>(size);
+	}
+
+	int ReplayTransport::read(uchar *data, size_t size) {
+		if (position >= exchanges.size()) return -1;
+		const CaptureEntry &reply = exchanges[position++].reply;
+		const size_t n = std::min<size_t>(size, reply.record->size);
+		std::memcpy(data, reply.data, n);
+		lastRead = static_cast<uint32_t>(reply.record->time / 1000);
+		if (reply.record->kind == CaptureKind::Report) ++reports;
+		if (nextReport < position) {
+			nextReport = position;
+			while (nextReport < exchanges.size() && exchanges[nextReport].reply.record->kind != CaptureKind::Report) {
+				++nextReport;
+			}
+		}
+		return static_cast<int>(n);
+	}
+
+	uint32_t ReplayTransport::readTime() const {
+		return lastRead;
+	}
+
+	Replay::Replay(const CaptureReader &capture, const ProfileSet &profiles, const ComboAutomaton &combos, OutputSink &sink)
+		:capture(capture), profiles(profiles), combos(combos), sink(sink) {
+	}
+
+	Replay::Stats Replay::run(bool realTime) {
+		using namespace std::chrono;
+
+		// Pair every reply with the command before it on the same port
+		std::array<std::unique_ptr<ReplayTransport>, capturePorts> owned;
+		std::array<CaptureEntry, capturePorts> commands{};
+		// Streamed reports come without a getInput, a port mostly recorded
+		// that way is replayed with bStreamReports
+		std::array<uint64_t, capturePorts> polled{};
+		std::array<uint64_t, capturePorts> streamed{};
+		for (const CaptureEntry e : capture) {
+			const uchar port = e.record->port;
+			if (port >= capturePorts) continue;
+			if (!owned[port]) owned[port] = std::make_unique<ReplayTransport>();
+			if (e.record->kind == CaptureKind::Command) {
+				commands[port] = e;
+			}
+			else {
+				if (e.record->kind == CaptureKind::Report) {
+					++(commands[port].record == nullptr ? streamed : polled)[port];
+				}
+				owned[port]->add(commands[port], e);
+				commands[port] = CaptureEntry{ nullptr, nullptr };
+			}
+		}
+
+		TimerWheel wheel{ 0 };
+		std::vector<ReplayTransport*> transports;
+		std::vector<std::unique_ptr<Controller>> cs;
+		for (size_t port = 0; port < owned.size(); ++port) {
+			if (!owned[port]) continue;
+			transports.push_back(owned[port].get());
+			cs.push_back(std::make_unique<Controller>(static_cast<uchar>(port), wheel, profiles, combos, sink));
+			if (streamed[port] > polled[port]) {
+				ReadSettings reading;
+				reading.mode = ReportMode::Stream;
+				cs.back()->setReadSettings(reading);
+			}
+			cs.back()->openDevice(std::move(owned[port]));
+		}
+
+		Stats stats{};
+		stats.controllers = cs.size();
+		uint64_t first = std::numeric_limits<uint64_t>::max();
+		for (const ReplayTransport *t : transports) {
+			first = std::min(first, t->nextTime());
+		}
+		std::vector<bool> centered(cs.size(), false);
+		std::array<ButtonEvent, 16> events;
+		const auto wallStart = steady_clock::now();
+		const std::clock_t cpuStart = std::clock();
+		for (;;) {
+			// Oldest pending report first, the order they were recorded in
+			size_t next = cs.size();
+			for (size_t i = 0; i < cs.size(); ++i) {
+				if (cs[i]->connected() && !transports[i]->finished()
+					&& (next == cs.size() || transports[i]->nextTime() < transports[next]->nextTime())) {
+					next = i;
+				}
+			}
+			if (next == cs.size()) break;
+			const uint64_t time = transports[next]->nextTime();
+			if (realTime) {
+				std::this_thread::sleep_until(wallStart + nanoseconds(time - first));
+			}
+			wheel.advance(time / 1'000'000);
+			cs[next]->pollInput();
+			++stats.exchanges;
+			// Same as the driver's centering loop, the first Share press sets the centers
+			size_t count;
+			while (!centered[next] && (count = cs[next]->drainEvents(events.data(), events.size())) > 0) {
+				for (size_t e = 0; e < count; ++e) {
+					if (events[e].button == Button::Share && events[e].down) {
+						const ExpandedPadState &state = cs[next]->getState();
+						cs[next]->setCalibrationCenter(state.leftStick, state.rightStick);
+						centered[next] = true;
+						break;
+					}
+				}
+			}
+		}
+		stats.seconds = duration<double>(steady_clock::now() - wallStart).count();
+		stats.cpuSeconds = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+		for (const ReplayTransport *t : transports) {
+			stats.reports += t->reportCount();
+			stats.mismatches += t->mismatchCount();
+			stats.skipped += t->skippedCount();
+		}
+		return stats;
+	}
+
+};
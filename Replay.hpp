@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "CaptureReader.hpp"
+#include "Combos.hpp"
+#include "Common.hpp"
+#include "Controller.hpp"
+#include "HidTransport.hpp"
+#include "OutputSink.hpp"
+#include "Profile.hpp"
+#include "TimerWheel.hpp"
+
+namespace Procon {
+
+	// Plays one port of a capture back to a Controller: every write gets the
+	// reply that was recorded for it, stamped with its recorded time. A
+	// getInput skips ahead to the next recorded report, past rumble and LED
+	// exchanges the replaying Controller doesn't repeat.
+	// Writes that differ from the recorded command are counted, a replay
+	// that stays at 0 took exactly the same path as the original session.
+	class ReplayTransport : public HidTransport {
+		struct Exchange {
+			CaptureEntry command; // record is nullptr if it was dropped
+			CaptureEntry reply;
+		};
+		std::vector<Exchange> exchanges;
+		size_t position{ 0 };
+		size_t nextReport{ 0 }; // First report at or after position, or the end
+		uint32_t lastRead{ 0 };
+		uint64_t reports{ 0 };
+		uint64_t mismatches{ 0 };
+		uint64_t skipped{ 0 };
+	public:
+		// Entries must stay valid, they point into the mapped capture
+		void add(const CaptureEntry &command, const CaptureEntry &reply);
+
+		// No reports left
+		bool finished() const;
+		// Recorded time of the next report, ns since the capture started
+		uint64_t nextTime() const;
+		uint64_t reportCount() const;
+		uint64_t mismatchCount() const;
+		uint64_t skippedCount() const;
+
+		// -1 once every recorded exchange was played
+		int write(const uchar *data, size_t size) override;
+		int read(uchar *data, size_t size) override;
+		uint32_t readTime() const override;
+	};
+
+	// Feeds a capture through the real decode pipeline (mapping,
+	// calibration, stick filter, turbo, macros, combos) into 'sink', one
+	// Controller per captured port, in the order the reports were recorded.
+	// Ports whose reports came without getInput requests are read as
+	// streamed (bStreamReports), the others polled.
+	// Time comes from the capture rather than the clock, so the same capture
+	// and config always give the same output.
+	// Throws Procon::ControllerException if a port's handshake is missing.
+	class Replay {
+		const CaptureReader &capture;
+		const ProfileSet &profiles;
+		const ComboAutomaton &combos;
+		OutputSink &sink;
+	public:
+		struct Stats {
+			uint64_t exchanges;
+			uint64_t reports;     // Input reports decoded
+			uint64_t mismatches;  // Writes that differ from the capture
+			uint64_t skipped;     // Recorded exchanges the replay didn't make
+			size_t controllers;
+			double seconds;       // Wall time, not counting the handshakes
+			double cpuSeconds;    // Process CPU time over the same span
+		};
+
+		// All must outlive the Replay
+		Replay(const CaptureReader &capture, const ProfileSet &profiles, const ComboAutomaton &combos, OutputSink &sink);
+
+		// 'realTime' sleeps to reproduce the recorded timing, otherwise runs
+		// as fast as it can.
+		Stats run(bool realTime);
+	};
+
+};
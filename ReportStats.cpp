@@ -0,0 +1,98 @@
+#include "ReportStats.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Procon {
+
+	void ReportStats::add(uint32_t time, uchar timer, bool afterPause) {
+		advance(time);
+		++current.reports;
+		++totals.reports;
+		if (totals.reports > 1 && !afterPause) {
+			const uchar step = static_cast<uchar>(timer - lastTimer);
+			if (step == 0) {
+				++current.repeated;
+				++totals.repeated;
+			}
+			else {
+				current.lost += step - 1u;
+				totals.lost += step - 1u;
+			}
+			const uint64_t interval = time - lastTime;
+			++current.intervals;
+			current.intervalSum += interval;
+			current.intervalSquares += interval * interval;
+		}
+		lastTime = time;
+		lastTimer = timer;
+	}
+
+	void ReportStats::advance(uint32_t time) {
+		if (!started) {
+			started = true;
+			bucketStart = time;
+			return;
+		}
+		const uint32_t elapsed = time - bucketStart;
+		if (elapsed < bucketUs) return;
+		const uint32_t steps = elapsed / bucketUs;
+		// Past a whole window every bucket is empty anyway
+		for (uint32_t i = 0; i < std::min<uint32_t>(steps, bucketCount + 1); ++i) {
+			rotate();
+		}
+		bucketStart += steps * bucketUs;
+		publish();
+	}
+
+	void ReportStats::rotate() {
+		Bucket &out = ring[oldest];
+		if (filled == bucketCount) {
+			window.reports -= out.reports;
+			window.lost -= out.lost;
+			window.repeated -= out.repeated;
+			window.intervals -= out.intervals;
+			window.intervalSum -= out.intervalSum;
+			window.intervalSquares -= out.intervalSquares;
+		}
+		else {
+			++filled;
+		}
+		out = current;
+		window.reports += out.reports;
+		window.lost += out.lost;
+		window.repeated += out.repeated;
+		window.intervals += out.intervals;
+		window.intervalSum += out.intervalSum;
+		window.intervalSquares += out.intervalSquares;
+		oldest = (oldest + 1) % bucketCount;
+		current = {};
+	}
+
+	void ReportStats::publish() {
+		Summary s{};
+		s.windowSeconds = filled * (bucketUs / 1e6);
+		s.reports = window.reports;
+		s.rateHz = s.windowSeconds > 0 ? window.reports / s.windowSeconds : 0.0;
+		if (window.intervals > 0) {
+			const double n = static_cast<double>(window.intervals);
+			s.meanIntervalUs = window.intervalSum / n;
+			s.jitterUs = std::sqrt(std::max(window.intervalSquares / n - s.meanIntervalUs * s.meanIntervalUs, 0.0));
+		}
+		s.lost = window.lost;
+		s.repeated = window.repeated;
+		const uint64_t samples = window.reports - window.repeated + window.lost;
+		s.lostPercent = samples > 0 ? 100.0 * window.lost / samples : 0.0;
+		s.totalReports = totals.reports;
+		s.totalLost = totals.lost;
+		s.totalRepeated = totals.repeated;
+		std::lock_guard<std::mutex> l{ lock };
+		published = s;
+	}
+
+	ReportStats::Summary ReportStats::summary() const {
+		std::lock_guard<std::mutex> l{ lock };
+		return published;
+	}
+
+};
@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+#include "Common.hpp"
+
+namespace Procon {
+
+	// Report rate, arrival jitter, and lost and repeated input samples of one
+	// controller over the last second. Samples are counted by the timer byte
+	// of each report, which goes up by one per sample the controller takes:
+	// a bigger step means samples no report carried, no step means the same
+	// sample was read twice. O(1) per report, the window is a ring of
+	// buckets with running totals.
+	// add() and advance() from the polling thread, summary() from any.
+	class ReportStats {
+	public:
+		struct Summary {
+			double windowSeconds;  // Time summarized, less than a second at first
+			uint64_t reports;
+			double rateHz;
+			double meanIntervalUs;
+			double jitterUs;       // Standard deviation of the intervals between reports
+			uint64_t lost;         // Samples the timer skipped over
+			uint64_t repeated;     // Reports with the same timer as the one before
+			double lostPercent;    // Of the samples the controller took
+			// Since the controller connected
+			uint64_t totalReports;
+			uint64_t totalLost;
+			uint64_t totalRepeated;
+		};
+
+		static constexpr size_t bucketCount{ 10 };
+		static constexpr uint32_t bucketUs{ 100000 };
+
+		// A report that arrived at 'time' (eventTime units) with 'timer'.
+		// 'afterPause' if it was asked for after deliberately not asking for a
+		// while, so the samples since the last report weren't lost and the
+		// interval isn't a report interval.
+		void add(uint32_t time, uchar timer, bool afterPause = false);
+		// Moves the window up to 'time' without a report, so a controller
+		// that stops reporting shows up as such
+		void advance(uint32_t time);
+		// As of the last full bucket, up to 100 ms old
+		Summary summary() const;
+
+	private:
+		struct Bucket {
+			uint64_t reports;
+			uint64_t lost;
+			uint64_t repeated;
+			uint64_t intervals;
+			uint64_t intervalSum;   // Microseconds
+			uint64_t intervalSquares;
+		};
+
+		std::array<Bucket, bucketCount> ring{};
+		size_t oldest{ 0 };
+		size_t filled{ 0 };
+		Bucket current{};
+		Bucket window{}; // Sum of the ring
+		uint32_t bucketStart{ 0 };
+		uint32_t lastTime{ 0 };
+		uchar lastTimer{ 0 };
+		bool started{ false };
+		Bucket totals{};
+
+		mutable std::mutex lock; // Guards 'published'
+		Summary published{};
+
+		void rotate();
+		void publish();
+	};
+
+};
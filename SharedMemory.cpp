@@ -0,0 +1,196 @@
+#include "SharedMemory.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Procon {
+
+	SharedMemoryError::SharedMemoryError(const std::string &what) : std::runtime_error(what) {}
+	SharedMemoryError::SharedMemoryError(const char *what) : std::runtime_error(what) {}
+
+#ifdef _WIN32
+
+	namespace {
+		// Region names and paths are taken as ASCII
+		std::wstring wide(const std::string &s) {
+			return std::wstring(s.begin(), s.end());
+		}
+	};
+
+	struct SharedMemory::SharedMemoryImpl {
+		HANDLE mapping{ nullptr };
+		void *base{ nullptr };
+		size_t length{ 0 };
+
+		~SharedMemoryImpl() {
+			if (base != nullptr) UnmapViewOfFile(base);
+			if (mapping != nullptr) CloseHandle(mapping);
+		}
+	};
+
+	SharedMemory SharedMemory::create(const std::string &name, size_t size) {
+		SharedMemory m;
+		const std::string path = "Local\\" + name;
+		const unsigned long long size64 = size;
+		m.impl->mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xffffffff), wide(path).c_str());
+		if (m.impl->mapping == nullptr) {
+			throw SharedMemoryError("Unable to create shared memory " + path + ", error " + std::to_string(GetLastError()));
+		}
+		m.impl->base = MapViewOfFile(m.impl->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (m.impl->base == nullptr) {
+			throw SharedMemoryError("Unable to map shared memory " + path + ", error " + std::to_string(GetLastError()));
+		}
+		m.impl->length = size;
+		return m;
+	}
+
+	SharedMemory SharedMemory::open(const std::string &name) {
+		SharedMemory m;
+		const std::string path = "Local\\" + name;
+		m.impl->mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, wide(path).c_str());
+		if (m.impl->mapping == nullptr) {
+			throw SharedMemoryError("Unable to open shared memory " + path + ", error " + std::to_string(GetLastError()));
+		}
+		m.impl->base = MapViewOfFile(m.impl->mapping, FILE_MAP_READ, 0, 0, 0);
+		if (m.impl->base == nullptr) {
+			throw SharedMemoryError("Unable to map shared memory " + path + ", error " + std::to_string(GetLastError()));
+		}
+		MEMORY_BASIC_INFORMATION info;
+		VirtualQuery(m.impl->base, &info, sizeof(info));
+		m.impl->length = info.RegionSize;
+		return m;
+	}
+
+	SharedMemory SharedMemory::mapFile(const std::string &path) {
+		SharedMemory m;
+		const HANDLE file = CreateFileW(wide(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw SharedMemoryError("Unable to open " + path + ", error " + std::to_string(GetLastError()));
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			throw SharedMemoryError(path + " is empty");
+		}
+		m.impl->mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file); // The mapping keeps the file open
+		if (m.impl->mapping == nullptr) {
+			throw SharedMemoryError("Unable to map " + path + ", error " + std::to_string(GetLastError()));
+		}
+		m.impl->base = MapViewOfFile(m.impl->mapping, FILE_MAP_READ, 0, 0, 0);
+		if (m.impl->base == nullptr) {
+			throw SharedMemoryError("Unable to map " + path + ", error " + std::to_string(GetLastError()));
+		}
+		m.impl->length = static_cast<size_t>(size.QuadPart);
+		return m;
+	}
+
+#else
+
+	struct SharedMemory::SharedMemoryImpl {
+		std::string unlinkName; // Set for the creator
+		void *base{ nullptr };
+		size_t length{ 0 };
+
+		~SharedMemoryImpl() {
+			if (base != nullptr) munmap(base, length);
+			if (!unlinkName.empty()) shm_unlink(unlinkName.c_str());
+		}
+	};
+
+	SharedMemory SharedMemory::create(const std::string &name, size_t size) {
+		SharedMemory m;
+		const std::string path = "/" + name;
+		const int fd = shm_open(path.c_str(), O_CREAT | O_RDWR, 0644);
+		if (fd < 0) {
+			throw SharedMemoryError("Unable to create shared memory " + path + ": " + std::strerror(errno));
+		}
+		m.impl->unlinkName = path;
+		if (ftruncate(fd, static_cast<off_t>(size)) < 0) {
+			close(fd);
+			throw SharedMemoryError("Unable to size shared memory " + path + ": " + std::strerror(errno));
+		}
+		void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED) {
+			throw SharedMemoryError("Unable to map shared memory " + path + ": " + std::strerror(errno));
+		}
+		m.impl->base = base;
+		m.impl->length = size;
+		return m;
+	}
+
+	SharedMemory SharedMemory::open(const std::string &name) {
+		SharedMemory m;
+		const std::string path = "/" + name;
+		const int fd = shm_open(path.c_str(), O_RDONLY, 0);
+		if (fd < 0) {
+			throw SharedMemoryError("Unable to open shared memory " + path + ": " + std::strerror(errno));
+		}
+		struct stat st;
+		if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+			close(fd);
+			throw SharedMemoryError("Shared memory " + path + " is empty");
+		}
+		void *base = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED) {
+			throw SharedMemoryError("Unable to map shared memory " + path + ": " + std::strerror(errno));
+		}
+		m.impl->base = base;
+		m.impl->length = static_cast<size_t>(st.st_size);
+		return m;
+	}
+
+	SharedMemory SharedMemory::mapFile(const std::string &path) {
+		SharedMemory m;
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw SharedMemoryError("Unable to open " + path + ": " + std::strerror(errno));
+		}
+		struct stat st;
+		if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+			close(fd);
+			throw SharedMemoryError(path + " is empty");
+		}
+		void *base = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED) {
+			throw SharedMemoryError("Unable to map " + path + ": " + std::strerror(errno));
+		}
+		m.impl->base = base;
+		m.impl->length = static_cast<size_t>(st.st_size);
+		return m;
+	}
+
+#endif
+
+	SharedMemory::SharedMemory() :impl(new SharedMemoryImpl()) {
+	}
+	SharedMemory::~SharedMemory() = default;
+
+	// Defaulted here so unique_ptr sees the complete impl, don't use '= default;' in header
+	SharedMemory::SharedMemory(SharedMemory &&) = default;
+	SharedMemory& SharedMemory::operator=(SharedMemory &&) = default;
+
+	void* SharedMemory::data() const {
+		return impl ? impl->base : nullptr;
+	}
+	size_t SharedMemory::size() const {
+		return impl ? impl->length : 0;
+	}
+
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace Procon {
+
+	class SharedMemoryError : public std::runtime_error {
+	public:
+		explicit SharedMemoryError(const std::string &what);
+		explicit SharedMemoryError(const char *what);
+	};
+
+	// RAII named shared memory mapping, visible to other local processes.
+	// A file mapping in the Local\ namespace on Windows, POSIX shm elsewhere.
+	// Throws Procon::SharedMemoryError from create(), open() and mapFile().
+	class SharedMemory {
+		struct SharedMemoryImpl;
+		std::unique_ptr<SharedMemoryImpl> impl;
+
+		SharedMemory();
+	public:
+		// Creates (or reuses) the region, zero-filled when new, read/write.
+		// The name is removed again when the creator is destroyed, mappings
+		// already opened stay valid.
+		static SharedMemory create(const std::string &name, size_t size);
+		// Maps an existing region read-only, at its full size.
+		static SharedMemory open(const std::string &name);
+		// Maps a whole file read-only. Not named, nothing to remove.
+		static SharedMemory mapFile(const std::string &path);
+
+		// No copying
+		SharedMemory(const SharedMemory&) = delete;
+		SharedMemory& operator=(const SharedMemory&) = delete;
+		// Moving OK
+		SharedMemory(SharedMemory&&);
+		SharedMemory& operator=(SharedMemory&&);
+		~SharedMemory();
+
+		void* data() const;
+		size_t size() const;
+	};
+
+};
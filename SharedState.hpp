@@ -0,0 +1,97 @@
+#pragma once
+// Layout of the shared memory region controller state is published to, see
+// StatePublisher and StateReader. Everything here is shared between the
+// driver and reader processes, so it's plain data and lock-free atomics only.
+// Bump sharedStateVersion on any change.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "Common.hpp"
+#include "XInputGamepad.hpp"
+
+namespace Procon {
+
+	constexpr char sharedStateName[] = "ProconXInputState";
+	constexpr uint32_t sharedStateMagic{ 0x50435853 }; // "SXCP"
+	constexpr uint32_t sharedStateVersion{ 1 };
+	constexpr size_t sharedStatePorts{ 64 };
+	constexpr size_t sharedStateRingSize{ 16 }; // Power of two
+
+	// One decoded report
+	struct PublishedState {
+		uint64_t frame;           // Reports published for this port, starting at 1
+		uint32_t time;            // eventTime() when the report arrived
+		uint32_t buttons;         // packButtons mask, before remapping
+		XINPUT_GAMEPAD xinState;  // As sent to the output sink
+		StickPoint leftStick;     // Raw, after the stick filter
+		StickPoint rightStick;
+		int16_t accel[3];         // Raw IMU, newest of the report's samples
+		int16_t gyro[3];
+		uchar timer;              // The controller's report counter
+		uchar profile;            // Index in the ProfileSet
+	};
+
+	// Seqlock: 'sequence' is odd while the writer is changing 'state'
+	struct alignas(64) StateSlot {
+		std::atomic<uint32_t> sequence;
+		PublishedState state;
+	};
+
+	struct alignas(64) StateRing {
+		std::atomic<uint64_t> published; // Total states written, newest is in slot (published - 1) % size
+		std::atomic<uint32_t> connected;
+		StateSlot slots[sharedStateRingSize];
+	};
+
+	struct alignas(64) SharedStateHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t portCount;
+		uint32_t ringSize;
+		uint32_t stateSize; // sizeof(PublishedState)
+	};
+
+	struct SharedStateRegion {
+		SharedStateHeader header;
+		StateRing rings[sharedStatePorts];
+	};
+
+	static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+		"Shared state needs address-free atomics");
+	static_assert((sharedStateRingSize & (sharedStateRingSize - 1)) == 0, "Ring size must be a power of two");
+
+	// Single writer per ring. Never waits for readers.
+	inline void writeState(StateRing &ring, const PublishedState &state) {
+		const uint64_t n = ring.published.load(std::memory_order_relaxed);
+		StateSlot &slot = ring.slots[n & (sharedStateRingSize - 1)];
+		const uint32_t seq = slot.sequence.load(std::memory_order_relaxed);
+		slot.sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(&slot.state, &state, sizeof(PublishedState));
+		slot.sequence.store(seq + 2, std::memory_order_release);
+		ring.published.store(n + 1, std::memory_order_release);
+	}
+
+	// Copies the state with frame index + 1. Returns false if it was
+	// overwritten or the writer was mid-write; the caller decides whether to
+	// retry.
+	inline bool readStateAt(const StateRing &ring, uint64_t index, PublishedState &out) {
+		const StateSlot &slot = ring.slots[index & (sharedStateRingSize - 1)];
+		const uint32_t before = slot.sequence.load(std::memory_order_acquire);
+		if ((before & 1) != 0) return false;
+		std::memcpy(&out, &slot.state, sizeof(PublishedState));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != before) return false;
+		return out.frame == index + 1;
+	}
+
+	// Copies the newest state. Returns false if there is none yet or the read
+	// raced the writer.
+	inline bool readLatestState(const StateRing &ring, PublishedState &out) {
+		const uint64_t n = ring.published.load(std::memory_order_acquire);
+		return n != 0 && readStateAt(ring, n - 1, out);
+	}
+
+};
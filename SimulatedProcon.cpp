@@ -0,0 +1,359 @@
+#include "SimulatedProcon.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "ButtonEvents.hpp"
+
+namespace {
+	using Procon::uchar;
+
+	// USB commands, the second byte after 0x80
+	constexpr uchar usbStatus{ 0x01 };
+	constexpr uchar usbHandshake{ 0x02 };
+	constexpr uchar usbBaudrate{ 0x03 };
+	constexpr uchar usbHidOnly{ 0x04 };
+	constexpr uchar usbDisconnect{ 0x05 };
+	constexpr uchar usbWrapped{ 0x92 };
+
+	// Output reports inside a wrapped command, at byte 8
+	constexpr uchar outRumbleSubcommand{ 0x01 };
+	constexpr uchar outRumble{ 0x10 };
+	constexpr uchar outGetInput{ 0x1f };
+
+	// Subcommands
+	constexpr uchar subDeviceInfo{ 0x02 };
+	constexpr uchar subReportMode{ 0x03 };
+	constexpr uchar subSpiRead{ 0x10 };
+	constexpr uchar subLights{ 0x30 };
+	constexpr uchar subImu{ 0x40 };
+	constexpr uchar subVibration{ 0x48 };
+
+	constexpr uchar fullReport{ 0x30 };
+	constexpr uchar subcommandReport{ 0x21 };
+	constexpr uchar batteryFull{ 0x91 }; // Full, charging, USB powered
+	constexpr size_t wrapperSize{ 10 };  // Reply header before the report, as InputPacket expects
+	constexpr size_t reportStateSize{ 13 }; // Report id through the vibrator byte
+
+	// 12-bit stick pair as stored in reports and the SPI calibration
+	void packStick(uint16_t x, uint16_t y, uchar *out) {
+		out[0] = static_cast<uchar>(x & 0xFF);
+		out[1] = static_cast<uchar>((x >> 8) | ((y & 0x0F) << 4));
+		out[2] = static_cast<uchar>(y >> 4);
+	}
+
+	// Factory data the driver or tools may read, everything else reads as erased
+	uchar spiByte(uint32_t address) {
+		static const std::array<uchar, 24> imuCalibration{
+			0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x40, 0x00, 0x40,
+			0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3B, 0x34, 0x3B, 0x34, 0x3B, 0x34 };
+		static const std::array<uchar, 18> stickCalibration = [] {
+			std::array<uchar, 18> c{};
+			packStick(0x600, 0x600, c.data());     // Left: max above center
+			packStick(0x800, 0x800, c.data() + 3); // center
+			packStick(0x600, 0x600, c.data() + 6); // min below center
+			packStick(0x800, 0x800, c.data() + 9); // Right: center
+			packStick(0x600, 0x600, c.data() + 12); // min below center
+			packStick(0x600, 0x600, c.data() + 15); // max above center
+			return c;
+		}();
+		static const std::array<uchar, 6> colors{ 0x32, 0x32, 0x32, 0xFF, 0xFF, 0xFF };
+
+		if (address == 0x6012) return 0x03; // Pro Controller
+		if (address >= 0x6020 && address < 0x6020 + imuCalibration.size()) return imuCalibration[address - 0x6020];
+		if (address >= 0x603D && address < 0x603D + stickCalibration.size()) return stickCalibration[address - 0x603D];
+		if (address >= 0x6050 && address < 0x6050 + colors.size()) return colors[address - 0x6050];
+		return 0xFF;
+	}
+}; // namespace
+
+namespace Procon {
+
+	SimulatedProcon::SimulatedProcon(const SimulatedProconSettings &settings)
+		:settings(settings), rng(settings.seed) {
+		setInput({ 0, { 128, 128 }, { 128, 128 } });
+	}
+
+	void SimulatedProcon::setInput(const SimulatedInput &in) {
+		const uint64_t packed = (in.buttons & 0xFFFFFF)
+			| (static_cast<uint64_t>(in.left.x) << 24) | (static_cast<uint64_t>(in.left.y) << 32)
+			| (static_cast<uint64_t>(in.right.x) << 40) | (static_cast<uint64_t>(in.right.y) << 48);
+		packedInput.store(packed, std::memory_order_relaxed);
+	}
+
+	SimulatedInput SimulatedProcon::input() const {
+		const uint64_t packed = packedInput.load(std::memory_order_relaxed);
+		SimulatedInput in;
+		in.buttons = static_cast<uint32_t>(packed & 0xFFFFFF);
+		in.left = { static_cast<uchar>(packed >> 24), static_cast<uchar>(packed >> 32) };
+		in.right = { static_cast<uchar>(packed >> 40), static_cast<uchar>(packed >> 48) };
+		return in;
+	}
+
+	SimulatedProcon::Stats SimulatedProcon::stats() const {
+		return counters;
+	}
+	uchar SimulatedProcon::playerLights() const {
+		return lights;
+	}
+	bool SimulatedProcon::imuEnabled() const {
+		return imu;
+	}
+	bool SimulatedProcon::vibrationEnabled() const {
+		return vibration;
+	}
+	const std::array<uchar, 8>& SimulatedProcon::lastRumble() const {
+		return rumble;
+	}
+
+	// Input samples taken since the controller was created
+	int64_t SimulatedProcon::sample(clock::time_point t) const {
+		const auto us = std::chrono::duration_cast<std::chrono::microseconds>(t - start).count();
+		return us / std::max<uint32_t>(settings.reportPeriodUs, 1);
+	}
+	SimulatedProcon::clock::time_point SimulatedProcon::sampleStart(clock::time_point t) const {
+		return start + std::chrono::microseconds(sample(t) * std::max<uint32_t>(settings.reportPeriodUs, 1));
+	}
+	uchar SimulatedProcon::timer(clock::time_point t) const {
+		return static_cast<uchar>(sample(t));
+	}
+	// Counts samples skipped or repeated by full reports
+	void SimulatedProcon::noteSample(clock::time_point t) {
+		const int64_t s = sample(t);
+		if (lastSample >= 0 && s > lastSample + 1) counters.missed += static_cast<uint64_t>(s - lastSample - 1);
+		if (s == lastSample) ++counters.repeated;
+		lastSample = std::max(lastSample, s);
+	}
+
+	// Report id, timer, battery, buttons, sticks and vibrator byte, then the
+	// IMU for full reports. Inputs are as of the last sample before 't'.
+	void SimulatedProcon::fillReport(uchar *out, uchar reportId, clock::time_point t) const {
+		const SimulatedInput in = input();
+		out[0] = reportId;
+		out[1] = timer(t);
+		out[2] = batteryFull;
+		out[3] = static_cast<uchar>(in.buttons >> 8);  // Right
+		out[4] = static_cast<uchar>(in.buttons >> 16); // Middle
+		out[5] = static_cast<uchar>(in.buttons);       // Left
+		packStick(static_cast<uint16_t>(in.left.x << 4 | 0x8), static_cast<uint16_t>(in.left.y << 4 | 0x8), out + 6);
+		packStick(static_cast<uint16_t>(in.right.x << 4 | 0x8), static_cast<uint16_t>(in.right.y << 4 | 0x8), out + 9);
+		out[12] = 0x0C; // Vibrator input report
+		if (reportId != fullReport) return;
+		std::memset(out + reportStateSize, 0, 36);
+		if (imu) {
+			// At rest, flat on a table: 1 g on z, three samples
+			for (int sample = 0; sample < 3; ++sample) {
+				uchar *s = out + reportStateSize + sample * 12;
+				s[4] = 0x00;
+				s[5] = 0x10;
+			}
+		}
+	}
+
+	// Fills 'out' with the 0x21 report body after the input state, returns its size
+	size_t SimulatedProcon::subcommandReply(const uchar *data, size_t size, uchar *out) {
+		// data: counter, 8 rumble bytes, subcommand, arguments
+		const uchar id = data[9];
+		const uchar *args = data + 10;
+		const size_t argCount = size - 10;
+		out[1] = id;
+		switch (id) {
+		case subDeviceInfo:
+			out[0] = 0x82;
+			out[2] = 0x03; // Firmware 3.72
+			out[3] = 0x48;
+			out[4] = 0x03; // Pro Controller
+			out[5] = 0x02;
+			std::copy(mac.begin(), mac.end(), out + 6);
+			out[12] = 0x01;
+			out[13] = 0x01; // Colors from SPI
+			return 14;
+		case subSpiRead: {
+			if (argCount < 5) {
+				out[0] = 0x00; // NACK
+				return 2;
+			}
+			const uint32_t address = args[0] | args[1] << 8 | args[2] << 16 | static_cast<uint32_t>(args[3]) << 24;
+			const size_t length = std::min<size_t>(args[4], 0x1D);
+			out[0] = 0x90;
+			std::memcpy(out + 2, args, 5);
+			for (size_t i = 0; i < length; ++i) {
+				out[7 + i] = spiByte(address + static_cast<uint32_t>(i));
+			}
+			return 7 + length;
+		}
+		case subReportMode:
+			streaming = argCount > 0 && args[0] == fullReport;
+			nextStream = clock::now();
+			break;
+		case subLights:
+			lights = argCount > 0 ? args[0] : 0;
+			break;
+		case subImu:
+			imu = argCount > 0 && args[0] != 0;
+			break;
+		case subVibration:
+			vibration = argCount > 0 && args[0] != 0;
+			break;
+		default:
+			break;
+		}
+		out[0] = 0x80; // ACK
+		return 2;
+	}
+
+	void SimulatedProcon::queue(const Packet &p) {
+		const auto at = std::upper_bound(pending.begin(), pending.end(), p.due,
+			[](clock::time_point due, const Packet &q) { return due < q.due; });
+		pending.insert(at, p);
+		if (pending.size() > queueLimit) {
+			pending.pop_front();
+			++counters.overflowed;
+		}
+	}
+
+	// Queues a reply after the latency, unless it's lost
+	void SimulatedProcon::reply(const uchar *bytes, size_t size, clock::time_point sent) {
+		if (settings.lossRate > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(rng) < settings.lossRate) {
+			++counters.lost;
+			return;
+		}
+		uint32_t delay = settings.latencyUs;
+		if (settings.jitterUs > 0) {
+			delay += std::uniform_int_distribution<uint32_t>(0, settings.jitterUs)(rng);
+		}
+		Packet p;
+		p.due = sent + std::chrono::microseconds(delay);
+		p.sampled = sampleStart(sent);
+		p.bytes.fill(0);
+		std::memcpy(p.bytes.data(), bytes, std::min(size, packetSize));
+		p.size = packetSize;
+		queue(p);
+	}
+
+	// Queues the streamed reports sampled up to 't'
+	void SimulatedProcon::streamUntil(clock::time_point t) {
+		const auto period = std::chrono::microseconds(std::max<uint32_t>(settings.reportPeriodUs, 1));
+		while (streaming && nextStream <= t) {
+			Packet p;
+			p.due = nextStream;
+			p.sampled = sampleStart(nextStream);
+			p.bytes.fill(0);
+			fillReport(p.bytes.data(), fullReport, nextStream);
+			noteSample(nextStream);
+			p.size = packetSize;
+			queue(p);
+			nextStream += period;
+		}
+	}
+
+	int SimulatedProcon::write(const uchar *data, size_t size) {
+		if (size < 2 || data[0] != 0x80) return static_cast<int>(size); // Ignored, like unknown reports
+		++counters.commands;
+		const clock::time_point now = clock::now();
+		std::array<uchar, packetSize> out{};
+		switch (data[1]) {
+		case usbStatus:
+			out[0] = 0x81;
+			out[1] = usbStatus;
+			out[3] = 0x03; // Pro Controller
+			std::reverse_copy(mac.begin(), mac.end(), out.begin() + 4);
+			reply(out.data(), 10, now);
+			break;
+		case usbHandshake:
+		case usbBaudrate:
+			out[0] = 0x81;
+			out[1] = data[1];
+			reply(out.data(), 2, now);
+			break;
+		case usbHidOnly:
+			break; // No reply
+		case usbDisconnect:
+			streaming = false;
+			break;
+		case usbWrapped: {
+			if (size < 9) break;
+			out[0] = 0x81;
+			out[1] = usbWrapped;
+			out[3] = 0x31;
+			uchar *report = out.data() + wrapperSize;
+			switch (data[8]) {
+			case outGetInput:
+				fillReport(report, fullReport, now);
+				noteSample(now);
+				reply(out.data(), wrapperSize + reportStateSize + 36, now);
+				break;
+			case outRumbleSubcommand:
+				if (size < 9 + 10) break;
+				std::copy(data + 10, data + 18, rumble.begin());
+				fillReport(report, subcommandReport, now);
+				reply(out.data(), wrapperSize + reportStateSize + subcommandReply(data + 9, size - 9, report + reportStateSize), now);
+				break;
+			case outRumble:
+				if (size < 9 + 9) break;
+				std::copy(data + 10, data + 18, rumble.begin());
+				fillReport(report, fullReport, now);
+				noteSample(now);
+				reply(out.data(), wrapperSize + reportStateSize + 36, now);
+				break;
+			default:
+				break;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+		return static_cast<int>(size);
+	}
+
+	// Waits for the next packet, like a blocking hid_read, but gives up
+	// after readTimeoutUs when none is coming
+	int SimulatedProcon::read(uchar *data, size_t size) {
+		return readTimeout(data, size, settings.readTimeoutUs);
+	}
+
+	int SimulatedProcon::readTimeout(uchar *data, size_t size, uint32_t timeoutUs) {
+		timeoutUs -= timeoutUs % std::max<uint32_t>(settings.timeoutGranularityUs, 1);
+		const clock::time_point now = clock::now();
+		streamUntil(now);
+		clock::time_point due = now + std::chrono::microseconds(timeoutUs);
+		if (!pending.empty()) due = std::min(due, pending.front().due);
+		if (streaming) due = std::min(due, nextStream);
+		if (due > now) std::this_thread::sleep_until(due);
+		streamUntil(due);
+		lastRead = eventTime();
+		if (pending.empty() || pending.front().due > due) {
+			if (timeoutUs > 0) ++counters.timeouts;
+			return 0;
+		}
+		const Packet p = pending.front();
+		pending.pop_front();
+		arrival = p.due;
+		sampled = p.sampled;
+		if (p.bytes[0] == fullReport || (p.bytes[0] == 0x81 && p.bytes[1] == usbWrapped && p.bytes[wrapperSize] == fullReport)) {
+			++counters.reports;
+		}
+		const size_t n = std::min(size, p.size);
+		std::memcpy(data, p.bytes.data(), n);
+		return static_cast<int>(n);
+	}
+
+	uint32_t SimulatedProcon::timeoutGranularityUs() const {
+		return std::max<uint32_t>(settings.timeoutGranularityUs, 1);
+	}
+
+	uint32_t SimulatedProcon::readTime() const {
+		return lastRead;
+	}
+
+	std::chrono::steady_clock::time_point SimulatedProcon::lastArrival() const {
+		return arrival;
+	}
+
+	std::chrono::steady_clock::time_point SimulatedProcon::lastSampleTime() const {
+		return sampled;
+	}
+
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <random>
+
+#include "Common.hpp"
+#include "HidTransport.hpp"
+
+namespace Procon {
+
+	struct SimulatedProconSettings {
+		uint32_t reportPeriodUs{ 8000 };  // How often the controller samples its inputs, 125 Hz like USB
+		uint32_t latencyUs{ 0 };          // From a write to its reply being readable
+		uint32_t jitterUs{ 0 };           // Extra latency, uniform from 0 to this
+		double lossRate{ 0.0 };           // Chance a reply never arrives
+		uint32_t readTimeoutUs{ 10000 };  // How long a read waits when nothing is coming
+		uint32_t timeoutGranularityUs{ 1 }; // readTimeout() rounds down to this, 1000 like hidapi
+		uint32_t seed{ 1 };
+	};
+
+	// What the simulated player is holding
+	struct SimulatedInput {
+		uint32_t buttons;  // packButtons mask
+		StickPoint left;   // 8 bit, as the driver decodes them
+		StickPoint right;
+	};
+
+	// A Pro Controller on USB, in memory. Speaks the protocol the driver
+	// uses: the 0x80 0x01-0x05 commands, 0x80 0x92 wrapped 0x01 subcommands
+	// with 0x21 replies (SPI flash reads, device info, LEDs, IMU and
+	// vibration enables), 0x10 rumble, 0x1f polling, and 0x30 reports
+	// streamed every reportPeriodUs once subcommand 0x03 asks for them.
+	// Replies are delayed, jittered and lost per the settings, so the whole
+	// Controller stack can be run and timed without a device.
+	// write() and read() from one thread, setInput() from any.
+	class SimulatedProcon : public HidTransport {
+	public:
+		struct Stats {
+			uint64_t commands;    // Writes
+			uint64_t reports;     // Input reports read, polled or streamed
+			uint64_t lost;        // Replies dropped by lossRate
+			uint64_t overflowed;  // Packets dropped because nobody read them
+			uint64_t timeouts;    // Reads that waited and got nothing
+			uint64_t missed;      // Input samples no report carried, the host polled too slowly
+			uint64_t repeated;    // Reports carrying the same sample as the one before
+		};
+
+		explicit SimulatedProcon(const SimulatedProconSettings &settings = {});
+
+		void setInput(const SimulatedInput &in);
+		SimulatedInput input() const;
+
+		Stats stats() const;
+		uchar playerLights() const;
+		bool imuEnabled() const;
+		bool vibrationEnabled() const;
+		// Rumble data of the last 0x01 or 0x10 command, both motors
+		const std::array<uchar, 8>& lastRumble() const;
+
+		int write(const uchar *data, size_t size) override;
+		int read(uchar *data, size_t size) override;
+		int readTimeout(uchar *data, size_t size, uint32_t timeoutUs) override;
+		uint32_t timeoutGranularityUs() const override;
+		uint32_t readTime() const override;
+		// When the last packet read became readable, to time what happens
+		// to it from there
+		std::chrono::steady_clock::time_point lastArrival() const;
+		// When the input in the last packet read was sampled
+		std::chrono::steady_clock::time_point lastSampleTime() const;
+
+	private:
+		using clock = std::chrono::steady_clock;
+		static constexpr size_t packetSize{ 64 };
+		static constexpr size_t queueLimit{ 32 }; // Like the OS HID input buffer
+
+		struct Packet {
+			clock::time_point due;
+			clock::time_point sampled;
+			std::array<uchar, packetSize> bytes;
+			size_t size;
+		};
+
+		SimulatedProconSettings settings;
+		std::atomic<uint64_t> packedInput{ 0 };
+		std::deque<Packet> pending; // By due time
+		clock::time_point start{ clock::now() };
+		clock::time_point nextStream{};
+		bool streaming{ false };
+		bool imu{ false };
+		bool vibration{ false };
+		uchar lights{ 0 };
+		std::array<uchar, 8> rumble{};
+		std::array<uchar, 6> mac{ 0x00, 0x00, 0x5E, 0x00, 0x53, 0x01 };
+		std::mt19937 rng;
+		uint32_t lastRead{ 0 };
+		clock::time_point arrival{};
+		clock::time_point sampled{};
+		int64_t lastSample{ -1 };
+		Stats counters{};
+
+		int64_t sample(clock::time_point t) const;
+		clock::time_point sampleStart(clock::time_point t) const;
+		uchar timer(clock::time_point t) const;
+		void noteSample(clock::time_point t);
+		void fillReport(uchar *out, uchar reportId, clock::time_point t) const;
+		size_t subcommandReply(const uchar *data, size_t size, uchar *out);
+		void queue(const Packet &p);
+		void reply(const uchar *bytes, size_t size, clock::time_point sent);
+		void streamUntil(clock::time_point t);
+	};
+
+};
@@ -0,0 +1,19 @@
+#pragma once
+#include "Common.hpp"
+#include "SharedState.hpp"
+
+namespace Procon {
+
+	// Something a Controller hands every decoded report to, see
+	// Controller::addObserver. Called on the controller's polling thread,
+	// so implementations must return quickly and never block.
+	class StateObserver {
+	public:
+		virtual ~StateObserver() = default;
+
+		// state.frame counts the controller's reports, starting at 1
+		virtual void publish(uchar port, const PublishedState &state) = 0;
+		virtual void setConnected(uchar port, bool connected) = 0;
+	};
+
+};
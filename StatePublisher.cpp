@@ -0,0 +1,36 @@
+#include "StatePublisher.hpp"
+
+#include <new>
+
+namespace Procon {
+
+	StatePublisher::StatePublisher(const std::string &name)
+		:memory(SharedMemory::create(name, sizeof(SharedStateRegion))),
+		region(new (memory.data()) SharedStateRegion()) {
+		SharedStateHeader &h = region->header;
+		h.version = sharedStateVersion;
+		h.portCount = sharedStatePorts;
+		h.ringSize = sharedStateRingSize;
+		h.stateSize = sizeof(PublishedState);
+		// Readers check the magic first, so it goes in last
+		std::atomic_thread_fence(std::memory_order_release);
+		h.magic = sharedStateMagic;
+	}
+
+	void StatePublisher::publish(uchar port, const PublishedState &state) {
+		if (port >= sharedStatePorts) return;
+		StateRing &ring = region->rings[port];
+		PublishedState s = state;
+		s.frame = ring.published.load(std::memory_order_relaxed) + 1;
+		writeState(ring, s);
+		if (ring.connected.load(std::memory_order_relaxed) == 0) {
+			ring.connected.store(1, std::memory_order_release);
+		}
+	}
+
+	void StatePublisher::setConnected(uchar port, bool connected) {
+		if (port >= sharedStatePorts) return;
+		region->rings[port].connected.store(connected ? 1 : 0, std::memory_order_release);
+	}
+
+};
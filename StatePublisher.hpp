@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+
+#include "Common.hpp"
+#include "SharedMemory.hpp"
+#include "SharedState.hpp"
+#include "StateObserver.hpp"
+
+namespace Procon {
+
+	// Publishes controller state into shared memory for overlays and
+	// telemetry tools (see StateReader). Publishing is a copy into a seqlock
+	// ring, readers never block it. One writer thread per port.
+	// Throws Procon::SharedMemoryError from the constructor.
+	class StatePublisher : public StateObserver {
+		SharedMemory memory;
+		SharedStateRegion *region;
+	public:
+		explicit StatePublisher(const std::string &name = sharedStateName);
+
+		// Ports past sharedStatePorts are ignored. state.frame is replaced by
+		// the count of states published for the port.
+		void publish(uchar port, const PublishedState &state) override;
+		void setConnected(uchar port, bool connected) override;
+	};
+
+};
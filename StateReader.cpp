@@ -0,0 +1,64 @@
+#include "StateReader.hpp"
+
+namespace {
+	// A read only fails when the writer laps the slot being copied, which
+	// takes a whole ring of reports, so a few tries is plenty
+	constexpr int maxTries{ 64 };
+};
+
+namespace Procon {
+
+	StateReader::StateReader(const std::string &name)
+		:memory(SharedMemory::open(name)),
+		region(static_cast<const SharedStateRegion*>(memory.data())) {
+		if (memory.size() < sizeof(SharedStateRegion)) {
+			throw SharedMemoryError("Shared state region is too small");
+		}
+		const SharedStateHeader &h = region->header;
+		if (h.magic != sharedStateMagic) {
+			throw SharedMemoryError("Shared state region isn't initialized");
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (h.version != sharedStateVersion || h.portCount != sharedStatePorts
+			|| h.ringSize != sharedStateRingSize || h.stateSize != sizeof(PublishedState)) {
+			throw SharedMemoryError("Shared state version " + std::to_string(h.version)
+				+ " doesn't match the reader's " + std::to_string(sharedStateVersion));
+		}
+	}
+
+	size_t StateReader::portCount() const {
+		return sharedStatePorts;
+	}
+
+	bool StateReader::connected(uchar port) const {
+		return port < sharedStatePorts && region->rings[port].connected.load(std::memory_order_acquire) != 0;
+	}
+
+	uint64_t StateReader::frames(uchar port) const {
+		return port < sharedStatePorts ? region->rings[port].published.load(std::memory_order_acquire) : 0;
+	}
+
+	bool StateReader::latest(uchar port, PublishedState &out) const {
+		if (port >= sharedStatePorts) return false;
+		const StateRing &ring = region->rings[port];
+		for (int i = 0; i < maxTries; ++i) {
+			if (readLatestState(ring, out)) return true;
+			if (ring.published.load(std::memory_order_acquire) == 0) return false;
+		}
+		return false;
+	}
+
+	size_t StateReader::history(uchar port, PublishedState *out, size_t max) const {
+		if (port >= sharedStatePorts) return 0;
+		const StateRing &ring = region->rings[port];
+		const uint64_t n = ring.published.load(std::memory_order_acquire);
+		size_t count = 0;
+		// Older slots are the ones the writer reaches first, stop at the first lapped one
+		while (count < max && count < n && count < sharedStateRingSize
+			&& readStateAt(ring, n - 1 - count, out[count])) {
+			++count;
+		}
+		return count;
+	}
+
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "Common.hpp"
+#include "SharedMemory.hpp"
+#include "SharedState.hpp"
+
+namespace Procon {
+
+	// Reader library for state published by a running driver. Reads straight
+	// from the mapped region, no system calls after construction, and never
+	// blocks the driver. Any number of readers in any number of processes.
+	// Throws Procon::SharedMemoryError from the constructor if no driver is
+	// publishing or its layout version differs.
+	class StateReader {
+		SharedMemory memory;
+		const SharedStateRegion *region;
+	public:
+		explicit StateReader(const std::string &name = sharedStateName);
+
+		size_t portCount() const;
+		bool connected(uchar port) const;
+		// States published so far, for cheap change polling
+		uint64_t frames(uchar port) const;
+		// Newest state. Returns false if none was published yet.
+		bool latest(uchar port, PublishedState &out) const;
+		// Up to 'max' of the newest states, newest first. Returns the count.
+		size_t history(uchar port, PublishedState *out, size_t max) const;
+	};
+
+};
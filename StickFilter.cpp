@@ -0,0 +1,153 @@
+#include "StickFilter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "Config.hpp"
+
+#if !defined(PROCON_STICKFILTER_NO_SSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PROCON_STICKFILTER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	using Procon::StickPoint;
+	using Procon::uchar;
+
+	constexpr int fracBits{ 7 };  // Stick values are Q7
+	constexpr int alphaBits{ 15 }; // Alphas are Q15
+	constexpr int32_t alphaRound{ 1 << (alphaBits - 1) };
+	constexpr double pi{ 3.14159265358979323846 };
+
+	// Smoothing factor of an exponential filter with cutoff fc sampled at rate, as Q15
+	uint16_t alphaQ15(double fc, double rate) {
+		const double r = 2.0 * pi * fc / rate;
+		const double alpha = r / (1.0 + r);
+		return static_cast<uint16_t>(std::clamp(std::lround(alpha * 32767.0), 1L, 32767L));
+	}
+
+	float positiveOr(const std::string &name, float value) {
+		if (!(value > 0.0f)) {
+			throw Procon::ConfigError(name + " must be greater than 0");
+		}
+		return value;
+	}
+
+#ifdef PROCON_STICKFILTER_SSE2
+	// (a * b + 2^14) >> 15 per lane, a must fit in int16, b in [0, 32767]
+	// The high halves of b are zero so madd gives the full signed product.
+	inline __m128i mulQ15(__m128i a, __m128i b) {
+		const __m128i prod = _mm_madd_epi16(a, b);
+		return _mm_srai_epi32(_mm_add_epi32(prod, _mm_set1_epi32(alphaRound)), alphaBits);
+	}
+
+	// Saturate each int32 lane to the int16 range, keeping it sign-extended in 32 bits
+	inline __m128i saturate16(__m128i v) {
+		const __m128i packed = _mm_packs_epi32(v, v);
+		return _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+	}
+
+	inline __m128i abs32(__m128i v) {
+		const __m128i sign = _mm_srai_epi32(v, 31);
+		return _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+	}
+#else
+	inline int32_t mulQ15(int32_t a, int32_t b) {
+		return (a * b + alphaRound) >> alphaBits;
+	}
+
+	inline int32_t saturate16(int32_t v) {
+		return std::clamp(v, -32768, 32767);
+	}
+#endif
+
+}; // namespace
+
+namespace Procon {
+
+	StickFilterParams stickFilterParamsFromConfig(const std::string &profile) {
+		StickFilterParams p;
+		p.enabled = Config::get<bool>("bStickFilter", profile).value_or(false);
+		p.minCutoff = positiveOr("fFilterMinCutoff", Config::get<float>("fFilterMinCutoff", profile).value_or(1.0f));
+		p.beta = std::max(Config::get<float>("fFilterBeta", profile).value_or(0.1f), 0.0f);
+		p.dCutoff = positiveOr("fFilterDCutoff", Config::get<float>("fFilterDCutoff", profile).value_or(5.0f));
+		p.rateHz = positiveOr("iFilterRateHz", static_cast<float>(Config::get<int32_t>("iFilterRateHz", profile).value_or(125)));
+		return p;
+	}
+
+	StickFilterTable::StickFilterTable(const StickFilterParams &params) :enabled(params.enabled) {
+		for (size_t i = 0; i < alphaBySpeed.size(); ++i) {
+			const double countsPerSecond = static_cast<double>(i) * params.rateHz;
+			alphaBySpeed[i] = alphaQ15(params.minCutoff + params.beta * countsPerSecond, params.rateHz);
+		}
+		speedAlpha = alphaQ15(params.dCutoff, params.rateHz);
+	}
+
+	bool StickFilterTable::isEnabled() const {
+		return enabled;
+	}
+
+	void StickFilter::reset() {
+		primed = false;
+	}
+
+	void StickFilter::apply(const StickFilterTable &table, StickPoint &left, StickPoint &right) {
+		if (!table.enabled) {
+			primed = false; // Starts over from the stick if a profile turns it back on
+			return;
+		}
+
+		if (!primed) {
+			value = { left.x << fracBits, left.y << fracBits, right.x << fracBits, right.y << fracBits };
+			speed.fill(0);
+			primed = true;
+			return;
+		}
+
+		alignas(16) std::array<int32_t, 4> alpha;
+
+#ifdef PROCON_STICKFILTER_SSE2
+		const __m128i x = _mm_slli_epi32(_mm_setr_epi32(left.x, left.y, right.x, right.y), fracBits);
+		__m128i y = _mm_load_si128(reinterpret_cast<const __m128i*>(value.data()));
+		__m128i s = _mm_load_si128(reinterpret_cast<const __m128i*>(speed.data()));
+
+		// Low-passed speed, in Q7 counts per sample
+		const __m128i dx = _mm_sub_epi32(x, y);
+		s = _mm_add_epi32(s, mulQ15(saturate16(_mm_sub_epi32(dx, s)), _mm_set1_epi32(table.speedAlpha)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(speed.data()), s);
+
+		alignas(16) std::array<int32_t, 4> index;
+		_mm_store_si128(reinterpret_cast<__m128i*>(index.data()), _mm_srli_epi32(abs32(s), fracBits));
+		for (size_t i = 0; i < 4; ++i) {
+			alpha[i] = table.alphaBySpeed[std::min(index[i], 255)];
+		}
+
+		y = _mm_add_epi32(y, mulQ15(dx, _mm_load_si128(reinterpret_cast<const __m128i*>(alpha.data()))));
+		_mm_store_si128(reinterpret_cast<__m128i*>(value.data()), y);
+
+		const __m128i rounded = _mm_srai_epi32(_mm_add_epi32(y, _mm_set1_epi32(1 << (fracBits - 1))), fracBits);
+		const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(rounded, rounded), _mm_setzero_si128());
+		const uint32_t out = static_cast<uint32_t>(_mm_cvtsi128_si32(bytes));
+		left.x = static_cast<uchar>(out);
+		left.y = static_cast<uchar>(out >> 8);
+		right.x = static_cast<uchar>(out >> 16);
+		right.y = static_cast<uchar>(out >> 24);
+#else
+		const std::array<int32_t, 4> x{ left.x << fracBits, left.y << fracBits, right.x << fracBits, right.y << fracBits };
+		std::array<uchar, 4> out;
+		for (size_t i = 0; i < 4; ++i) {
+			const int32_t dx = x[i] - value[i];
+			speed[i] += mulQ15(saturate16(dx - speed[i]), table.speedAlpha);
+			alpha[i] = table.alphaBySpeed[std::min(std::abs(speed[i]) >> fracBits, 255)];
+			value[i] += mulQ15(dx, alpha[i]);
+			out[i] = static_cast<uchar>(std::clamp((value[i] + (1 << (fracBits - 1))) >> fracBits, 0, 255));
+		}
+		left.x = out[0];
+		left.y = out[1];
+		right.x = out[2];
+		right.y = out[3];
+#endif
+	}
+
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "Common.hpp"
+
+namespace Procon {
+
+	struct StickFilterParams {
+		bool enabled;
+		float minCutoff; // Hz, cutoff when the stick is at rest
+		float beta;      // Hz of extra cutoff per raw count/second of stick speed
+		float dCutoff;   // Hz, cutoff of the speed estimate
+		float rateHz;    // Nominal report rate the filter is tuned for
+	};
+	// Reads bStickFilter, fFilterMinCutoff, fFilterBeta, fFilterDCutoff and
+	// iFilterRateHz from Config for 'profile' (see Config::get), using defaults
+	// for anything missing. Throws Procon::ConfigError on invalid values.
+	StickFilterParams stickFilterParamsFromConfig(const std::string &profile = "");
+
+	// Filter coefficients compiled from StickFilterParams. The cutoff for each
+	// speed is precomputed, so filtering has no division or floating point.
+	class StickFilterTable {
+		friend class StickFilter;
+		std::array<uint16_t, 256> alphaBySpeed; // Q15, indexed by raw counts per sample
+		uint16_t speedAlpha;
+		bool enabled;
+	public:
+		explicit StickFilterTable(const StickFilterParams &params);
+		bool isEnabled() const;
+	};
+
+	// 1-Euro adaptive low-pass filter over the four raw stick axes
+	// (left x, left y, right x, right y), holding one controller's history.
+	// All four axes are filtered at once as one 4-lane fixed-point vector,
+	// using SSE2 where available and identical scalar math otherwise.
+	// Values are Q7 (raw << 7), alphas are Q15.
+	class StickFilter {
+		alignas(16) std::array<int32_t, 4> value{};
+		alignas(16) std::array<int32_t, 4> speed{};
+		bool primed{ false };
+	public:
+		// Forget filter history, next sample passes through unfiltered.
+		void reset();
+		// Filters the sticks in place. Only forgets the history if the table
+		// is disabled, so turning it back on starts from the stick.
+		void apply(const StickFilterTable &table, StickPoint &left, StickPoint &right);
+	};
+
+};
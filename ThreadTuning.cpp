@@ -0,0 +1,128 @@
+#include "ThreadTuning.hpp"
+
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Config.hpp"
+
+namespace Procon {
+
+	ThreadTuningError::ThreadTuningError(const std::string &what) : std::runtime_error(what) {}
+	ThreadTuningError::ThreadTuningError(const char *what) : std::runtime_error(what) {}
+
+	ThreadPriority parseThreadPriority(const std::string &name) {
+		if (name == "normal") return ThreadPriority::Normal;
+		if (name == "above") return ThreadPriority::AboveNormal;
+		if (name == "high") return ThreadPriority::High;
+		if (name == "realtime") return ThreadPriority::Realtime;
+		throw ConfigError("Thread priority must be normal, above, high or realtime, not " + name);
+	}
+
+	const char* threadPriorityName(ThreadPriority p) {
+		switch (p) {
+		case ThreadPriority::AboveNormal: return "above";
+		case ThreadPriority::High: return "high";
+		case ThreadPriority::Realtime: return "realtime";
+		default: return "normal";
+		}
+	}
+
+	ThreadTuning ThreadTuning::fromConfig() {
+		ThreadTuning t;
+		const unsigned available = std::thread::hardware_concurrency(); // 0 if unknown
+		std::stringstream cores{ Config::get<std::string>("sPollThreadCores").value_or("") };
+		std::string core;
+		while (std::getline(cores, core, ',')) {
+			if (core.empty()) continue;
+			if (core.find_first_not_of("0123456789") != std::string::npos || core.size() > 4) {
+				throw ConfigError("sPollThreadCores must be core numbers separated by commas, not " + core);
+			}
+			const uint32_t n = static_cast<uint32_t>(std::stoul(core));
+			if (available > 0 && n >= available) {
+				throw ConfigError("sPollThreadCores has core " + core + ", there are only " + std::to_string(available));
+			}
+			t.cores.push_back(n);
+		}
+		t.priority = parseThreadPriority(Config::get<std::string>("sPollThreadPriority").value_or("normal"));
+		return t;
+	}
+
+	bool ThreadTuning::isDefault() const {
+		return cores.empty() && priority == ThreadPriority::Normal;
+	}
+
+#ifdef _WIN32
+
+	void ThreadTuning::apply(size_t index) const {
+		const HANDLE self = GetCurrentThread();
+		if (!cores.empty()) {
+			const uint32_t core = cores[index % cores.size()];
+			if (core >= sizeof(DWORD_PTR) * 8) {
+				throw ThreadTuningError("Can't pin a thread to core " + std::to_string(core) + ", only the first " + std::to_string(sizeof(DWORD_PTR) * 8) + " cores");
+			}
+			if (SetThreadAffinityMask(self, static_cast<DWORD_PTR>(1) << core) == 0) {
+				throw ThreadTuningError("Unable to pin a thread to core " + std::to_string(core) + ", error " + std::to_string(GetLastError()));
+			}
+		}
+		int level = THREAD_PRIORITY_NORMAL;
+		switch (priority) {
+		case ThreadPriority::AboveNormal: level = THREAD_PRIORITY_ABOVE_NORMAL; break;
+		case ThreadPriority::High: level = THREAD_PRIORITY_HIGHEST; break;
+		case ThreadPriority::Realtime: level = THREAD_PRIORITY_TIME_CRITICAL; break;
+		default: return;
+		}
+		if (!SetThreadPriority(self, level)) {
+			throw ThreadTuningError(std::string{ "Unable to set thread priority " } + threadPriorityName(priority) + ", error " + std::to_string(GetLastError()));
+		}
+	}
+
+#else
+
+	void ThreadTuning::apply(size_t index) const {
+		if (!cores.empty()) {
+			const uint32_t core = cores[index % cores.size()];
+			if (core >= CPU_SETSIZE) {
+				throw ThreadTuningError("Can't pin a thread to core " + std::to_string(core));
+			}
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(core, &set);
+			const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+			if (error != 0) {
+				throw ThreadTuningError("Unable to pin a thread to core " + std::to_string(core) + ", " + std::strerror(error));
+			}
+		}
+		if (priority == ThreadPriority::Realtime) {
+			sched_param param{};
+			param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+			const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+			if (error != 0) {
+				throw ThreadTuningError(std::string{ "Unable to make a thread realtime (needs CAP_SYS_NICE), " } + std::strerror(error));
+			}
+		}
+		else if (priority != ThreadPriority::Normal) {
+			// Nice is per thread on Linux
+			const int nice = priority == ThreadPriority::High ? -10 : -5;
+			if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice) != 0) {
+				throw ThreadTuningError(std::string{ "Unable to raise thread priority (needs CAP_SYS_NICE), " } + std::strerror(errno));
+			}
+		}
+	}
+
+#endif
+
+};
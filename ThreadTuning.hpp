@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Common.hpp"
+
+namespace Procon {
+
+	class ThreadTuningError : public std::runtime_error {
+	public:
+		explicit ThreadTuningError(const std::string &what);
+		explicit ThreadTuningError(const char *what);
+	};
+
+	// Above normal and high raise the thread within its normal class
+	// (THREAD_PRIORITY_ABOVE_NORMAL and _HIGHEST on Windows, nice -5 and -10
+	// elsewhere). Realtime is THREAD_PRIORITY_TIME_CRITICAL on Windows and
+	// SCHED_FIFO elsewhere, ahead of every normal thread.
+	enum class ThreadPriority : uchar { Normal, AboveNormal, High, Realtime };
+
+	// Core pinning and scheduling priority for a kind of thread, such as the
+	// polling threads, so a game's own threads can't preempt them.
+	// sPollThreadCores and sPollThreadPriority in config.txt.
+	struct ThreadTuning {
+		std::vector<uint32_t> cores; // Thread n runs only on cores[n % size], empty for any core
+		ThreadPriority priority{ ThreadPriority::Normal };
+
+		// Throws Procon::ConfigError for a bad core list or priority
+		static ThreadTuning fromConfig();
+		// Nothing to apply
+		bool isDefault() const;
+		// Tunes the calling thread as the 'index'-th of its kind. Throws
+		// Procon::ThreadTuningError if the system refuses, such as a raised
+		// priority without the right privilege.
+		void apply(size_t index) const;
+	};
+
+	ThreadPriority parseThreadPriority(const std::string &name);
+	const char* threadPriorityName(ThreadPriority p);
+
+};
@@ -0,0 +1,130 @@
+#include "TimerWheel.hpp"
+
+#include <chrono>
+
+namespace Procon {
+
+	TimerWheel::Timer::~Timer() {
+		if (wheel != nullptr) {
+			wheel->cancel(*this);
+		}
+	}
+
+	bool TimerWheel::Timer::scheduled() const {
+		return wheel != nullptr;
+	}
+
+	TimerWheel::TimerWheel(Tick now) :current(now) {
+		for (Link &l : nearWheel) {
+			l.prev = l.next = &l;
+		}
+		for (Link &l : farWheel) {
+			l.prev = l.next = &l;
+		}
+	}
+
+	TimerWheel::~TimerWheel() {
+		// Detach anything still pending so Timer destructors don't touch us
+		auto detachAll = [](Link &head) {
+			while (head.next != &head) {
+				Timer &t = static_cast<Timer&>(*head.next);
+				unlink(t);
+				t.wheel = nullptr;
+			}
+		};
+		for (Link &head : nearWheel) {
+			detachAll(head);
+		}
+		for (Link &head : farWheel) {
+			detachAll(head);
+		}
+	}
+
+	TimerWheel::Tick TimerWheel::clockNow() {
+		using namespace std::chrono;
+		return static_cast<Tick>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+	}
+
+	void TimerWheel::unlink(Link &l) {
+		l.prev->next = l.next;
+		l.next->prev = l.prev;
+		l.prev = l.next = nullptr;
+	}
+
+	void TimerWheel::pushBack(Link &head, Link &l) {
+		l.prev = head.prev;
+		l.next = &head;
+		head.prev->next = &l;
+		head.prev = &l;
+	}
+
+	void TimerWheel::insert(Timer &t) {
+		const Tick delta = t.expires - current;
+		if (delta < nearSlots) {
+			pushBack(nearWheel[t.expires & (nearSlots - 1)], t);
+		}
+		else {
+			// Far slots hold one near-wheel revolution each. Anything beyond the
+			// far wheel parks in its last slot and is re-inserted on cascade.
+			const Tick revolutions = (t.expires >> nearBits) - (current >> nearBits);
+			const Tick slot = (current >> nearBits) + (revolutions < farSlots ? revolutions : farSlots - 1);
+			pushBack(farWheel[slot & (farSlots - 1)], t);
+		}
+	}
+
+	// Called when the near wheel wraps, moves the next revolution's timers into it
+	void TimerWheel::cascade() {
+		Link &head = farWheel[(current >> nearBits) & (farSlots - 1)];
+		Link pending;
+		pending.prev = pending.next = &pending;
+		if (head.next != &head) {
+			// Splice out first so re-inserting into this slot doesn't loop
+			pending.next = head.next;
+			pending.prev = head.prev;
+			pending.next->prev = &pending;
+			pending.prev->next = &pending;
+			head.prev = head.next = &head;
+		}
+		while (pending.next != &pending) {
+			Timer &t = static_cast<Timer&>(*pending.next);
+			unlink(t);
+			insert(t);
+		}
+	}
+
+	void TimerWheel::schedule(Timer &t, Tick delay) {
+		if (t.wheel != nullptr) {
+			cancel(t);
+		}
+		t.wheel = this;
+		t.expires = current + (delay == 0 ? 1 : delay);
+		insert(t);
+	}
+
+	void TimerWheel::cancel(Timer &t) {
+		if (t.wheel != this) return;
+		unlink(t);
+		t.wheel = nullptr;
+	}
+
+	void TimerWheel::advance(Tick now) {
+		while (current < now) {
+			++current;
+			if ((current & (nearSlots - 1)) == 0) {
+				cascade();
+			}
+			Link &head = nearWheel[current & (nearSlots - 1)];
+			while (head.next != &head) {
+				Timer &t = static_cast<Timer&>(*head.next);
+				unlink(t);
+				t.wheel = nullptr;
+				t.onExpire(*this, current);
+			}
+		}
+	}
+
+	TimerWheel::Tick TimerWheel::now() const {
+		return current;
+	}
+
+};
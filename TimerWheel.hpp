@@ -0,0 +1,68 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Procon {
+
+	// Two-level hierarchical timer wheel with 1ms ticks.
+	// Scheduling, cancelling and firing a timer are O(1), and advancing costs
+	// O(1) per elapsed tick plus the timers that fire, no matter how many are
+	// pending. Not thread safe, advance() from the thread that owns the timers.
+	class TimerWheel {
+	public:
+		using Tick = uint64_t; // Milliseconds
+
+		struct Link {
+			Link *prev{ nullptr };
+			Link *next{ nullptr };
+		};
+
+		// Derive from Timer and implement onExpire. A Timer must outlive its
+		// scheduling, or be cancelled first (the destructor does this).
+		class Timer : private Link {
+			friend class TimerWheel;
+			TimerWheel *wheel{ nullptr };
+			Tick expires{ 0 };
+		public:
+			Timer() = default;
+			Timer(const Timer&) = delete;
+			Timer& operator=(const Timer&) = delete;
+			virtual ~Timer();
+
+			bool scheduled() const;
+		protected:
+			virtual void onExpire(TimerWheel &wheel, Tick now) = 0;
+		};
+
+	private:
+		static constexpr size_t nearBits{ 8 };
+		static constexpr size_t nearSlots{ 1 << nearBits };
+		static constexpr size_t farSlots{ 64 };
+
+		std::array<Link, nearSlots> nearWheel;
+		std::array<Link, farSlots> farWheel;
+		Tick current;
+
+		void insert(Timer &t);
+		static void unlink(Link &l);
+		static void pushBack(Link &head, Link &l);
+		void cascade();
+	public:
+		explicit TimerWheel(Tick now);
+		TimerWheel(const TimerWheel&) = delete;
+		TimerWheel& operator=(const TimerWheel&) = delete;
+		~TimerWheel();
+
+		// Milliseconds on the steady clock, a suitable time base for advance()
+		static Tick clockNow();
+
+		// (Re)schedules t to expire 'delay' ticks from now, at least one tick.
+		void schedule(Timer &t, Tick delay);
+		void cancel(Timer &t);
+		// Fires every timer that expires up to and including 'now'.
+		void advance(Tick now);
+		Tick now() const;
+	};
+
+};
@@ -0,0 +1,138 @@
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace {
+	void writeString(std::ostream &out, const std::string &s) {
+		out << '"';
+		for (char c : s) {
+			if (c == '"' || c == '\\') out << '\\';
+			if (static_cast<unsigned char>(c) >= 0x20) out << c;
+		}
+		out << '"';
+	}
+}; // namespace
+
+namespace Procon {
+
+	std::atomic<Tracer*> Tracer::current{ nullptr };
+	std::atomic<uint64_t> Tracer::generations{ 0 };
+
+	Tracer::Tracer(size_t eventsPerThread) :generation(++generations), eventsPerThread(1) {
+		while (this->eventsPerThread < eventsPerThread) this->eventsPerThread <<= 1;
+	}
+
+	Tracer::~Tracer() {
+		deactivate();
+	}
+
+	void Tracer::activate() {
+		current.store(this, std::memory_order_release);
+	}
+
+	void Tracer::deactivate() {
+		Tracer *self = this;
+		current.compare_exchange_strong(self, nullptr, std::memory_order_acq_rel);
+	}
+
+	// Found through thread_locals after the first time. 'generation' tells
+	// apart tracers that came and went at the same address.
+	Tracer::Ring& Tracer::threadRing() {
+		thread_local uint64_t cachedGeneration{ 0 };
+		thread_local Ring *cached{ nullptr };
+		if (cachedGeneration == generation) return *cached;
+		auto ring = std::make_unique<Ring>();
+		ring->events.resize(eventsPerThread);
+		std::lock_guard<std::mutex> l{ lock };
+		ring->thread = static_cast<uint32_t>(rings.size() + 1);
+		cached = ring.get();
+		cachedGeneration = generation;
+		rings.push_back(std::move(ring));
+		return *cached;
+	}
+
+	void Tracer::record(const char *name, uchar port, int32_t arg, char phase) {
+		const uint64_t time = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		Ring &r = threadRing();
+		const uint64_t h = r.head.load(std::memory_order_relaxed);
+		r.events[h & (r.events.size() - 1)] = { time, name, arg, port, phase };
+		r.head.store(h + 1, std::memory_order_release);
+	}
+
+	void Tracer::begin(const char *name, uchar port, int32_t arg) {
+		record(name, port, arg, 'B');
+	}
+
+	void Tracer::end(const char *name, uchar port, int32_t arg) {
+		record(name, port, arg, 'E');
+	}
+
+	void Tracer::nameThread(const std::string &name) {
+		Ring &r = threadRing();
+		std::lock_guard<std::mutex> l{ lock };
+		r.name = name;
+	}
+
+	void Tracer::write(std::ostream &out) const {
+		std::lock_guard<std::mutex> l{ lock };
+		out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		bool first = true;
+		std::vector<TraceEvent> events;
+		for (const auto &r : rings) {
+			const uint64_t size = r->events.size();
+			const uint64_t head = r->head.load(std::memory_order_acquire);
+			const uint64_t from = head > size ? head - size : 0;
+			events.clear();
+			for (uint64_t i = from; i < head; ++i) {
+				events.push_back(r->events[i & (size - 1)]);
+			}
+			// Drop what the thread overwrote while this was copying, and the
+			// event in the slot it may be writing event 'after' into
+			const uint64_t after = r->head.load(std::memory_order_acquire);
+			if (after >= size && after - size + 1 > from) {
+				const uint64_t overwritten = std::min<uint64_t>(after - size + 1 - from, events.size());
+				events.erase(events.begin(), events.begin() + static_cast<std::ptrdiff_t>(overwritten));
+			}
+
+			if (!r->name.empty()) {
+				out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << r->thread << ",\"args\":{\"name\":";
+				writeString(out, r->name);
+				out << "}}";
+				first = false;
+			}
+			// An end whose begin was overwritten would close whatever is open
+			size_t depth = 0;
+			for (const TraceEvent &e : events) {
+				if (e.phase == 'E') {
+					if (depth == 0) continue;
+					--depth;
+				}
+				else {
+					++depth;
+				}
+				out << (first ? "" : ",") << "\n{\"name\":\"" << e.name << "\",\"ph\":\"" << e.phase
+					<< "\",\"ts\":" << e.time / 1000 << '.' << static_cast<char>('0' + e.time / 100 % 10)
+					<< static_cast<char>('0' + e.time / 10 % 10) << static_cast<char>('0' + e.time % 10)
+					<< ",\"pid\":1,\"tid\":" << r->thread;
+				if (e.port != traceNoPort || e.arg >= 0) {
+					out << ",\"args\":{";
+					if (e.port != traceNoPort) out << "\"port\":" << static_cast<int>(e.port);
+					if (e.arg >= 0) out << (e.port != traceNoPort ? "," : "") << "\"arg\":" << e.arg;
+					out << '}';
+				}
+				out << '}';
+				first = false;
+			}
+		}
+		out << "\n]}\n";
+	}
+
+	bool Tracer::write(const std::string &path) const {
+		std::ofstream file{ path, std::ios::trunc };
+		if (!file) return false;
+		write(file);
+		return static_cast<bool>(file.flush());
+	}
+
+};
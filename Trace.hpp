@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Common.hpp"
+
+namespace Procon {
+
+	constexpr uchar traceNoPort{ 0xFF };
+
+	struct TraceEvent {
+		uint64_t time;    // ns since the tracer started
+		const char *name; // A string literal, never freed
+		int32_t arg;      // Shown with the event, -1 for none
+		uchar port;       // traceNoPort for events of no controller
+		char phase;       // 'B'egin or 'E'nd
+	};
+
+	// Opt-in tracing of begin/end events, exported as Chrome trace-event JSON
+	// (chrome://tracing or ui.perfetto.dev) to see how polls on different
+	// controllers and threads interleave. Each thread records into its own
+	// fixed-size ring, allocated the first time it records, after which
+	// recording takes no locks and allocates nothing. Rings keep the latest
+	// events, the oldest are overwritten.
+	class Tracer {
+		struct Ring {
+			std::vector<TraceEvent> events; // Power of two
+			std::atomic<uint64_t> head{ 0 }; // Events recorded, the writer thread only
+			uint32_t thread;
+			std::string name;
+		};
+
+		static std::atomic<Tracer*> current;
+		static std::atomic<uint64_t> generations;
+		uint64_t generation;
+		size_t eventsPerThread;
+		std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+		mutable std::mutex lock; // Guards 'rings', not the rings' events
+		std::vector<std::unique_ptr<Ring>> rings;
+
+		Ring& threadRing();
+		void record(const char *name, uchar port, int32_t arg, char phase);
+	public:
+		// Rounded up to a power of two
+		explicit Tracer(size_t eventsPerThread = 1 << 16);
+		// Deactivates if active. Controllers tracing into it must be done.
+		~Tracer();
+		Tracer(const Tracer&) = delete;
+		Tracer& operator=(const Tracer&) = delete;
+
+		// TraceScopes record into this tracer from now on
+		void activate();
+		void deactivate();
+		// The active tracer, nullptr if tracing is off
+		static Tracer* active() {
+			return current.load(std::memory_order_acquire);
+		}
+
+		void begin(const char *name, uchar port = traceNoPort, int32_t arg = -1);
+		void end(const char *name, uchar port = traceNoPort, int32_t arg = -1);
+		// Shown for the calling thread in the trace
+		void nameThread(const std::string &name);
+
+		// Every thread's events so far as a JSON object, while recording goes on
+		void write(std::ostream &out) const;
+		// Writes to 'path', replacing it. Returns false if it can't.
+		bool write(const std::string &path) const;
+	};
+
+	// Begin event now and end event when destroyed, if tracing is on.
+	// Costs one atomic load when it's off.
+	class TraceScope {
+		Tracer *tracer;
+		const char *name;
+		uchar port;
+		int32_t arg;
+	public:
+		explicit TraceScope(const char *name, uchar port = traceNoPort, int32_t arg = -1)
+			:tracer(Tracer::active()), name(name), port(port), arg(arg) {
+			if (tracer != nullptr) tracer->begin(name, port, arg);
+		}
+		~TraceScope() {
+			if (tracer != nullptr) tracer->end(name, port, arg);
+		}
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+	};
+
+};
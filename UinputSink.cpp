@@ -0,0 +1,183 @@
+#ifdef __linux__
+#include "UinputSink.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace {
+	using namespace Procon;
+
+	struct KeyBit {
+		uint16_t xinput;
+		uint16_t code;
+	};
+	const std::array<KeyBit, 11> keys{ {
+		{ XINPUT_GAMEPAD_A, BTN_A },
+		{ XINPUT_GAMEPAD_B, BTN_B },
+		{ XINPUT_GAMEPAD_X, BTN_X },
+		{ XINPUT_GAMEPAD_Y, BTN_Y },
+		{ XINPUT_GAMEPAD_LEFT_SHOULDER, BTN_TL },
+		{ XINPUT_GAMEPAD_RIGHT_SHOULDER, BTN_TR },
+		{ XINPUT_GAMEPAD_BACK, BTN_SELECT },
+		{ XINPUT_GAMEPAD_START, BTN_START },
+		{ XINPUT_GAMEPAD_GUIDE, BTN_MODE },
+		{ XINPUT_GAMEPAD_LEFT_THUMB, BTN_THUMBL },
+		{ XINPUT_GAMEPAD_RIGHT_THUMB, BTN_THUMBR },
+	} };
+	// Buttons, sticks, triggers, hat, and the SYN_REPORT
+	constexpr size_t maxEventsPerPad{ 11 + 4 + 2 + 2 + 1 };
+
+	[[noreturn]] void fail(const std::string &what) {
+		throw OutputError("uinput: " + what + ": " + std::strerror(errno));
+	}
+
+	void setAxis(int fd, uint16_t code, int32_t min, int32_t max, int32_t flat) {
+		uinput_abs_setup abs{};
+		abs.code = code;
+		abs.absinfo.minimum = min;
+		abs.absinfo.maximum = max;
+		abs.absinfo.flat = flat;
+		if (ioctl(fd, UI_SET_ABSBIT, code) < 0 || ioctl(fd, UI_ABS_SETUP, &abs) < 0) {
+			fail("setting up axis " + std::to_string(code));
+		}
+	}
+
+	// XInput Y axes point up, evdev ones down
+	int32_t flipY(int16_t y) {
+		return y == -32768 ? 32767 : -y;
+	}
+
+	int32_t hat(uint16_t buttons, uint16_t negative, uint16_t positive) {
+		return ((buttons & positive) != 0 ? 1 : 0) - ((buttons & negative) != 0 ? 1 : 0);
+	}
+
+	void add(input_event *events, size_t &count, uint16_t type, uint16_t code, int32_t value) {
+		input_event &e = events[count++];
+		std::memset(&e, 0, sizeof(e));
+		e.type = type;
+		e.code = code;
+		e.value = value;
+	}
+
+}; // namespace
+
+namespace Procon {
+
+	UinputSink::UinputSink(size_t maxPorts) :pads(maxPorts) {
+	}
+
+	UinputSink::~UinputSink() {
+		for (size_t port = 0; port < pads.size(); ++port) {
+			unplug(static_cast<uchar>(port));
+		}
+	}
+
+	void UinputSink::plugIn(uchar port) {
+		if (port >= pads.size()) {
+			throw OutputError("uinput: port " + std::to_string(port) + " is out of range");
+		}
+		if (pads[port].fd >= 0) return;
+		const int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0) {
+			fail("opening /dev/uinput");
+		}
+		pads[port].fd = fd;
+		pads[port].last = {};
+		try {
+			if (ioctl(fd, UI_SET_EVBIT, EV_KEY) < 0 || ioctl(fd, UI_SET_EVBIT, EV_ABS) < 0) {
+				fail("setting event types");
+			}
+			for (const KeyBit &k : keys) {
+				if (ioctl(fd, UI_SET_KEYBIT, k.code) < 0) {
+					fail("setting up button " + std::to_string(k.code));
+				}
+			}
+			setAxis(fd, ABS_X, -32768, 32767, 128);
+			setAxis(fd, ABS_Y, -32768, 32767, 128);
+			setAxis(fd, ABS_RX, -32768, 32767, 128);
+			setAxis(fd, ABS_RY, -32768, 32767, 128);
+			setAxis(fd, ABS_Z, 0, 255, 0);
+			setAxis(fd, ABS_RZ, 0, 255, 0);
+			setAxis(fd, ABS_HAT0X, -1, 1, 0);
+			setAxis(fd, ABS_HAT0Y, -1, 1, 0);
+
+			uinput_setup setup{};
+			setup.id.bustype = BUS_VIRTUAL;
+			setup.id.vendor = 0x045e; // Microsoft
+			setup.id.product = 0x028e; // Xbox 360 controller
+			setup.id.version = 1;
+			std::snprintf(setup.name, UINPUT_MAX_NAME_SIZE, "ProconXInput pad %d", port + 1);
+			if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+				fail("creating device");
+			}
+		}
+		catch (...) {
+			close(fd);
+			pads[port].fd = -1;
+			throw;
+		}
+	}
+
+	void UinputSink::unplug(uchar port) {
+		if (port >= pads.size() || pads[port].fd < 0) return;
+		ioctl(pads[port].fd, UI_DEV_DESTROY);
+		close(pads[port].fd);
+		pads[port].fd = -1;
+	}
+
+	size_t UinputSink::capacity() const {
+		return pads.size();
+	}
+
+	void UinputSink::submit(const PadUpdate *updates, size_t count) {
+		std::array<input_event, maxEventsPerPad> events;
+		for (size_t i = 0; i < count; ++i) {
+			if (updates[i].port >= pads.size()) continue;
+			Pad &pad = pads[updates[i].port];
+			if (pad.fd < 0) continue;
+			const XINPUT_GAMEPAD &s = updates[i].state;
+			const XINPUT_GAMEPAD &l = pad.last;
+			size_t n = 0;
+
+			const uint16_t changed = s.wButtons ^ l.wButtons;
+			if (changed != 0) {
+				for (const KeyBit &k : keys) {
+					if ((changed & k.xinput) != 0) {
+						add(events.data(), n, EV_KEY, k.code, (s.wButtons & k.xinput) != 0 ? 1 : 0);
+					}
+				}
+				constexpr uint16_t dpadX = XINPUT_GAMEPAD_DPAD_LEFT | XINPUT_GAMEPAD_DPAD_RIGHT;
+				constexpr uint16_t dpadY = XINPUT_GAMEPAD_DPAD_UP | XINPUT_GAMEPAD_DPAD_DOWN;
+				if ((changed & dpadX) != 0) {
+					add(events.data(), n, EV_ABS, ABS_HAT0X, hat(s.wButtons, XINPUT_GAMEPAD_DPAD_LEFT, XINPUT_GAMEPAD_DPAD_RIGHT));
+				}
+				if ((changed & dpadY) != 0) {
+					add(events.data(), n, EV_ABS, ABS_HAT0Y, hat(s.wButtons, XINPUT_GAMEPAD_DPAD_UP, XINPUT_GAMEPAD_DPAD_DOWN));
+				}
+			}
+			if (s.sThumbLX != l.sThumbLX) add(events.data(), n, EV_ABS, ABS_X, s.sThumbLX);
+			if (s.sThumbLY != l.sThumbLY) add(events.data(), n, EV_ABS, ABS_Y, flipY(s.sThumbLY));
+			if (s.sThumbRX != l.sThumbRX) add(events.data(), n, EV_ABS, ABS_RX, s.sThumbRX);
+			if (s.sThumbRY != l.sThumbRY) add(events.data(), n, EV_ABS, ABS_RY, flipY(s.sThumbRY));
+			if (s.bLeftTrigger != l.bLeftTrigger) add(events.data(), n, EV_ABS, ABS_Z, s.bLeftTrigger);
+			if (s.bRightTrigger != l.bRightTrigger) add(events.data(), n, EV_ABS, ABS_RZ, s.bRightTrigger);
+			if (n == 0) continue;
+			add(events.data(), n, EV_SYN, SYN_REPORT, 0);
+
+			const ssize_t bytes = static_cast<ssize_t>(n * sizeof(input_event));
+			if (write(pad.fd, events.data(), bytes) != bytes) {
+				fail("writing pad " + std::to_string(updates[i].port + 1));
+			}
+			pad.last = s;
+		}
+	}
+
+};
+#endif //#ifdef __linux__
@@ -0,0 +1,31 @@
+#pragma once
+#include <array>
+#include <vector>
+
+#include "OutputSink.hpp"
+
+namespace Procon {
+
+	// Virtual gamepads through Linux uinput, one input device per port,
+	// laid out like the kernel's xpad driver so games and SDL see a 360 pad.
+	// Each pad's changes in a batch go out in one write(). Linux only, needs
+	// write access to /dev/uinput. No rumble or LED feedback.
+	class UinputSink : public OutputSink {
+		struct Pad {
+			int fd{ -1 };
+			XINPUT_GAMEPAD last{};
+		};
+		std::vector<Pad> pads;
+	public:
+		explicit UinputSink(size_t maxPorts = 4);
+		~UinputSink() override;
+		UinputSink(const UinputSink&) = delete;
+		UinputSink& operator=(const UinputSink&) = delete;
+
+		void plugIn(uchar port) override;
+		void unplug(uchar port) override;
+		void submit(const PadUpdate *updates, size_t count) override;
+		size_t capacity() const override;
+	};
+
+};
@@ -0,0 +1,55 @@
+#include "XOutputSink.hpp"
+
+#include <string>
+
+#include "XOutput.hpp"
+
+using namespace XOutput;
+
+namespace Procon {
+
+	XOutputSink::XOutputSink() {
+		XOutputInitialize();
+		DWORD unused;
+		if (XOutputGetRealUserIndex(0, &unused) != XOUTPUT_SUCCESS) {
+			throw OutputError("Unable to connect to ScpVBus.");
+		}
+	}
+
+	void XOutputSink::plugIn(uchar port) {
+		if (XOutputPlugIn(port) != ERROR_SUCCESS) {
+			throw OutputError("Unable to plugin XOutput controller.");
+		}
+	}
+
+	void XOutputSink::unplug(uchar port) {
+		XOutputUnPlug(port);
+	}
+
+	// ScpVBus takes one pad per IOCTL, so a batch is still one call per pad
+	void XOutputSink::submit(const PadUpdate *updates, size_t count) {
+		for (size_t i = 0; i < count; ++i) {
+			XINPUT_GAMEPAD state = updates[i].state;
+			DWORD err;
+			if ((err = XOutputSetState(updates[i].port, &state)) != ERROR_SUCCESS) {
+				std::string errMsg{ "XOutput Error: " };
+				errMsg += std::to_string(err);
+				throw OutputError(errMsg);
+			}
+		}
+	}
+
+	size_t XOutputSink::capacity() const {
+		return 4;
+	}
+
+	bool XOutputSink::feedback(uchar port, PadFeedback &out) {
+		uchar vibrate{ 0 };
+		if (XOutputGetState(port, &vibrate, &out.largeMotor, &out.smallMotor, &out.led) != ERROR_SUCCESS) {
+			return false;
+		}
+		out.vibrate = vibrate != 0;
+		return true;
+	}
+
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include "OutputSink.hpp"
+
+namespace Procon {
+
+	// Virtual Xbox 360 pads through ScpVBus (XOutput1_1.dll), ports 0-3.
+	// Windows only.
+	class XOutputSink : public OutputSink {
+	public:
+		// Loads XOutput and checks ScpVBus is installed.
+		// Throws XOutput::XOutputError or Procon::OutputError.
+		XOutputSink();
+
+		void plugIn(uchar port) override;
+		void unplug(uchar port) override;
+		void submit(const PadUpdate *updates, size_t count) override;
+		bool feedback(uchar port, PadFeedback &out) override;
+		size_t capacity() const override;
+	};
+
+};
@@ -1,8 +1,12 @@
 #include <iostream> // cout
+#include <iomanip> // setprecision
 #include <thread> // this_thread::sleep_for, this_thread::yield
 #include <chrono> // milliseconds
 #include <vector>
 #include <array>
+#include <memory>
+#include <optional>
+#include <algorithm> // max, min
 
 #ifndef NOMINMAX
 #define NOMINMAX
@@ -11,11 +15,30 @@
 #include <conio.h> // _kbhit, _getch_nolock
 #include "XOutput.hpp"
 
+#include "Combos.hpp"
 #include "Common.hpp"
 #include "Controller.hpp"
+#include "CaptureFormat.hpp"
+#include "CaptureWriter.hpp"
 #include "Cerberus.hpp"
+#include "DeltaServer.hpp"
 #include "Version.hpp"
 #include "Config.hpp"
+#include "FrameCommit.hpp"
+#include "HidTransport.hpp"
+#include "LatencyMonitor.hpp"
+#include "LocalSocket.hpp"
+#include "OutputSink.hpp"
+#include "PollLoop.hpp"
+#include "PollWorkers.hpp"
+#include "Profile.hpp"
+#include "ReportStats.hpp"
+#include "SharedMemory.hpp"
+#include "StatePublisher.hpp"
+#include "ThreadTuning.hpp"
+#include "TimerWheel.hpp"
+#include "Trace.hpp"
+#include "XOutputSink.hpp"
 
 namespace {
 	bool hasBroke{ false };
@@ -40,10 +63,6 @@ namespace {
 		SetConsoleCtrlHandler(breakHandler, FALSE);
 	}
 
-	constexpr bool SUCCESS(DWORD e) {
-		return e == XOutput::XOUTPUT_SUCCESS;
-	}
-
 	void pause() {
 		while (_kbhit() != 0) _getch(); // Eat any buffered input
 		std::cout << "Press any key to continue..." << std::endl; // Intentional use of endl to flush output buffer
@@ -64,27 +83,54 @@ int main(int, char*[]) {
 
 	cout << ProgramName << ' ' << ProgramVersion << ' ' << Platform << ' ' << BuildType << "\n\n";
 
+	std::optional<ProfileSet> profiles;
+	std::optional<ComboAutomaton> combos;
+	ReadSettings reading;
+	ThreadTuning pollTuning;
 	try {
 		Config::readConfigFile("config.txt");
+		profiles = ProfileSet::fromConfig();
+		combos = ComboAutomaton::fromConfig();
+		reading = ReadSettings::fromConfig();
+		pollTuning = ThreadTuning::fromConfig();
 	}
 	catch (const ConfigError &e) {
 		cout << "Error reading config file: " << e.what() << '\n';
 		return -1;
 	}
 
+	std::optional<Tracer> tracer; // Before everything that traces
+	const std::string tracePath = Config::get<std::string>("sTraceFile").value_or("ProconXInput-trace.json");
+	if (Config::get<bool>("bTrace").value_or(false)) {
+		tracer.emplace(static_cast<size_t>(std::max(Config::get<int32_t>("iTraceEvents").value_or(1 << 16), 1)));
+		tracer->activate();
+		tracer->nameThread("main");
+		cout << "Tracing, press T to save the trace. Saved to " << tracePath << " on exit.\n";
+	}
+	const auto writeTrace = [&] {
+		if (tracer && !tracer->write(tracePath)) {
+			cout << "Unable to write trace to " << tracePath << ".\n";
+		}
+	};
+	auto writeTraceOnExit = make_scoped(writeTrace); // After the controllers are gone, to include disconnects
+
+	std::optional<XOutputSink> sink;
 	try {
-		XOutput::XOutputInitialize();
+		sink.emplace();
 	}
 	catch (XOutput::XOutputError &e) {
 		cout << e.what() << '\n';
 		return -1;
 	}
-
-	DWORD unused;
-	if (!SUCCESS(XOutput::XOutputGetRealUserIndex(0, &unused))) {
-		cout << "Unable to connect to ScpVBus.\n";
+	catch (OutputError &e) {
+		cout << e.what() << '\n';
 		return -1;
 	}
+	std::optional<FrameCommit> frame; // Output of all controllers sent together once per loop pass
+	if (Config::get<bool>("bBatchOutput").value_or(false)) {
+		frame.emplace(*sink);
+	}
+	OutputSink &output = frame ? static_cast<OutputSink&>(*frame) : *sink;
 
 #ifndef NO_CERBERUS
 	Cerberus cerb;
@@ -99,8 +145,53 @@ int main(int, char*[]) {
 	}
 #endif
 	
-	std::vector<Controller> cs;
-	uchar port{ 0 };
+	std::optional<StatePublisher> publisher; // Before the controllers, they use it until destroyed
+	if (Config::get<bool>("bPublishState").value_or(false)) {
+		try {
+			publisher.emplace();
+			cout << "Publishing controller state to shared memory.\n";
+		}
+		catch (SharedMemoryError &e) {
+			cout << "Unable to publish controller state: " << e.what() << '\n';
+		}
+	}
+	std::optional<DeltaServer> deltas;
+	if (Config::get<bool>("bDeltaStream").value_or(false)) {
+		const std::string path = Config::get<std::string>("sDeltaSocket").value_or(defaultLocalSocketPath("proconxinput.sock"));
+		try {
+			deltas.emplace(path, static_cast<size_t>(std::max(Config::get<int32_t>("iDeltaQueue").value_or(256), 1)));
+			cout << "Streaming controller state on " << path << ".\n";
+		}
+		catch (SocketError &e) {
+			cout << "Unable to stream controller state: " << e.what() << '\n';
+		}
+	}
+	std::optional<CaptureWriter> capture;
+	if (Config::get<bool>("bCapture").value_or(false)) {
+		const std::string path = Config::get<std::string>("sCaptureFile").value_or("ProconXInput.pxcap");
+		try {
+			capture.emplace(path);
+			cout << "Capturing raw controller traffic to " << path << ".\n";
+		}
+		catch (CaptureError &e) {
+			cout << "Unable to capture: " << e.what() << '\n';
+		}
+	}
+	std::optional<LatencyMonitor> latency;
+	const std::string latencyPath = Config::get<std::string>("sLatencyFile").value_or("ProconXInput-latency.txt");
+	if (Config::get<bool>("bLatencyStats").value_or(false)) {
+		latency.emplace();
+		cout << "Timing controller polls, press L for latency stats. Saved to " << latencyPath << " on exit.\n";
+	}
+	const auto dumpLatency = [&] {
+		if (latency && !latency->dump(latencyPath)) {
+			cout << "Unable to write latency stats to " << latencyPath << ".\n";
+		}
+	};
+
+	LockedSink shared{ output }; // Controllers on different polling threads
+	const size_t maxPads = std::min<size_t>(shared.capacity(), 256);
+	std::vector<std::unique_ptr<PollSlot>> slots;
 	{
 		constexpr auto id = Procon_ID; // Procon only for now
 		constexpr auto vendorId = NintendoID;
@@ -109,9 +200,22 @@ int main(int, char*[]) {
 		do {
 			if (iter != nullptr) {
 				if (iter->product_id == id) { // Check the id!
+					if (slots.size() == maxPads) {
+						cout << "The output supports " << maxPads << " controllers, ignoring the rest.\n";
+						break;
+					}
 					try {
-						cs.emplace_back(Controller(port++));
-						cs.back().openDevice(iter);
+						const uchar port = static_cast<uchar>(slots.size());
+						auto slot = std::make_unique<PollSlot>();
+						slot->controller = std::make_unique<Controller>(port, slot->wheel, *profiles, *combos, shared);
+						Controller &c = *slot->controller;
+						slots.push_back(std::move(slot));
+						if (capture && port < capturePorts) c.captureTo(&capture->channel(port));
+						if (latency) c.timeTo(&latency->controller(port));
+						c.setReadSettings(reading);
+						c.openDevice(std::make_unique<HidapiTransport>(iter));
+						if (publisher) c.addObserver(&*publisher);
+						if (deltas) c.addObserver(&*deltas);
 					}
 					catch (ControllerException &e) {
 						cout << "Exception connecting to controller: " << e.what() << '\n';
@@ -120,15 +224,15 @@ int main(int, char*[]) {
 				}
 				iter = iter->next;
 			}
-		} while (iter != nullptr && port < 4);
+		} while (iter != nullptr);
 		hid_free_enumeration(devs);
 	}
-	if (cs.size() == 0) {
+	if (slots.size() == 0) {
 		cout << "Unable to find controller.\n";
 		return -1;
 	}
 
-	cout << "\nConnected to " << static_cast<int>(port) << " controller(s). Beginning xInput emulation.\n\n";
+	cout << "\nConnected to " << slots.size() << " controller(s). Beginning xInput emulation.\n\n";
 	
 	cout << "Doing calibration, stick min/maxes will be updated automatically.\n";
 	cout << "Move the sticks some, then let them reset to neutral.\n";
@@ -138,40 +242,91 @@ int main(int, char*[]) {
 	cout << "Press CTRL+C to exit.\n\n";
 	::setBreakHandler();
 
-	std::array<bool, 4> hasCentered;
-	hasCentered.fill(false);
+	std::vector<bool> hasCentered(slots.size(), false);
+	std::array<ButtonEvent, 16> events;
 
 	try {
 		// Testing to set centers, additional comparisons = slower so make it a separate loop
-		size_t countCentered{ 0 };
-		while (!::hasBroke && countCentered < port) {
-			for (size_t i = 0; i < port; ++i) {
-				cs[i].pollInput();
-				if (!hasCentered[i]) {
-					const Procon::ExpandedPadState &state = cs[i].getState();
-					if (state.sharePressed) {
-						cs[i].setCalibrationCenter(state.leftStick, state.rightStick);
-						hasCentered[i] = true;
-						++countCentered;
-						cout << "Set stick centers for controller LED " << i + 1 << '\n';
+		bool allCentered{ false };
+		while (!::hasBroke && !allCentered) {
+			const TimerWheel::Tick now = TimerWheel::clockNow();
+			allCentered = true;
+			for (size_t i = 0; i < slots.size(); ++i) {
+				slots[i]->wheel.advance(now);
+				Controller &c = *slots[i]->controller;
+				c.pollInput();
+				if (!c.connected()) continue; // Disconnected with a combo
+				size_t count;
+				while (!hasCentered[i] && (count = c.drainEvents(events.data(), events.size())) > 0) {
+					for (size_t e = 0; e < count; ++e) {
+						if (events[e].button == Button::Share && events[e].down) {
+							const Procon::ExpandedPadState &state = c.getState();
+							c.setCalibrationCenter(state.leftStick, state.rightStick);
+							hasCentered[i] = true;
+							cout << "Set stick centers for controller LED " << i + 1 << '\n';
+							break;
+						}
 					}
 				}
+				allCentered = allCentered && hasCentered[i];
 			}
+			if (frame) frame->commit();
 			yield();
 		}
-		cout << "\nAll controller stick centers set, entering fast input loop. Enjoy your games!\n";
-		// Centers set, main input loop
+		// Centers set, main input loop on the polling threads
+		const int32_t configuredThreads = Config::get<int32_t>("iPollThreads").value_or(0);
+		const size_t threads = configuredThreads > 0 ? std::min(static_cast<size_t>(configuredThreads), slots.size()) : PollWorkers::defaultThreads(slots.size());
+		PollWorkers workers{ threads, frame ? &*frame : nullptr, &shared.mutex() };
+		for (auto &s : slots) {
+			workers.add(*s);
+		}
+		workers.tune(pollTuning);
+		workers.start();
+		cout << "\nAll controller stick centers set, entering fast input loop on " << workers.threads() << " thread(s). Enjoy your games!\n";
+		const int statsTicks = std::max(Config::get<int32_t>("iReportStatsSeconds").value_or(0), 0) * 100;
+		int ticks{ 0 };
 		while(!::hasBroke){
-			for (size_t i = 0; i < port; ++i) {
-				cs[i].pollInput();
+			workers.check();
+			if (!workers.connected()) {
+				cout << "All controllers disconnected.\n";
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			if (++ticks % 50 == 0) workers.rebalance(); // Every half second
+			if (statsTicks > 0 && ticks % statsTicks == 0) {
+				for (size_t i = 0; i < slots.size(); ++i) {
+					const ReportStats::Summary s = slots[i]->controller->reportStats();
+					cout << std::fixed << std::setprecision(2) << "LED " << i + 1 << ": " << s.rateHz << " Hz, jitter " << s.jitterUs / 1000 << " ms, "
+						<< s.lost << " lost (" << s.lostPercent << "%), " << s.repeated << " repeated\n" << std::defaultfloat;
+				}
+			}
+			if (_kbhit() != 0) {
+				const int key = _getch();
+				if (latency && (key == 'l' || key == 'L')) {
+					cout << '\n';
+					latency->report(cout);
+					dumpLatency();
+				}
+				if (tracer && (key == 't' || key == 'T')) {
+					writeTrace();
+					cout << "Saved trace to " << tracePath << ".\n";
+				}
 			}
-			yield(); // sleep_for causes big lag and not yielding eats way more processor
 		}
+		dumpLatency();
 	}
 	catch (ControllerException &e) {
 		cout << "ControllerException: " << e.what() << '\n';
 		return -1;
 	}
+	catch (OutputError &e) {
+		cout << "OutputError: " << e.what() << '\n';
+		return -1;
+	}
+	catch (ThreadTuningError &e) {
+		cout << "ThreadTuningError: " << e.what() << '\n';
+		return -1;
+	}
 
 	return 0;
 }